@@ -0,0 +1,348 @@
+#include <cpputils/bench/bench.h>
+#include <cpputils/asyncio/coroutine.h>
+#include <cpputils/asyncio/detached_task.h>
+#include <cpputils/asyncio/sharded_runtime.h>
+#include <cpputils/asyncio/priority_executor.h>
+#include <cpputils/asyncio/thread_pool.h>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+using namespace cpputils;
+using namespace cpputils::asyncio;
+
+// The callback_ benchmarks do the same work with std::function continuations, as the baseline the
+// coroutine versions are weighed against. Run with --filter=asyncio or the bench_asyncio target.
+
+static task<void> empty_task()
+{
+	co_return;
+}
+
+static task<void> await_chain(int depth)
+{
+	if (depth > 0)
+		co_await await_chain(depth - 1);
+}
+
+// A lazy task never started, only its frame is allocated and freed
+CPPUTILS_BENCHMARK(asyncio_task_create_destroy)
+{
+	for (auto _ : state)
+	{
+		auto t = empty_task();
+		bench::do_not_optimize(t);
+	}
+}
+
+CPPUTILS_BENCHMARK(asyncio_callback_create_invoke)
+{
+	int calls = 0;
+	for (auto _ : state)
+	{
+		std::function<void()> callback = [&calls]
+		{ calls++; };
+		bench::do_not_optimize(callback);
+		callback();
+	}
+	bench::do_not_optimize(calls);
+}
+
+CPPUTILS_BENCHMARK(asyncio_task_run_sync)
+{
+	for (auto _ : state)
+	{
+		auto t = empty_task();
+		t.run_sync();
+	}
+}
+
+// Round trip of sync_wait() on the calling thread, the event is set before anyone waits on it
+CPPUTILS_BENCHMARK(asyncio_sync_wait)
+{
+	for (auto _ : state)
+		sync_wait(empty_task());
+}
+
+// Every level resumes its caller through final_awaitable's symmetric transfer
+CPPUTILS_BENCHMARK(asyncio_await_chain_1)
+{
+	for (auto _ : state)
+	{
+		auto t = await_chain(1);
+		t.run_sync();
+	}
+}
+
+CPPUTILS_BENCHMARK(asyncio_await_chain_16)
+{
+	for (auto _ : state)
+	{
+		auto t = await_chain(16);
+		t.run_sync();
+	}
+}
+
+CPPUTILS_BENCHMARK(asyncio_await_chain_256)
+{
+	for (auto _ : state)
+	{
+		auto t = await_chain(256);
+		t.run_sync();
+	}
+}
+
+static void callback_chain(int depth, const std::function<void()> &done)
+{
+	if (depth > 0)
+		callback_chain(depth - 1, [&done]
+					   { done(); });
+	else
+		done();
+}
+
+CPPUTILS_BENCHMARK(asyncio_callback_chain_16)
+{
+	int calls = 0;
+	for (auto _ : state)
+		callback_chain(16, [&calls]
+					   { calls++; });
+	bench::do_not_optimize(calls);
+}
+
+CPPUTILS_BENCHMARK(asyncio_callback_chain_256)
+{
+	int calls = 0;
+	for (auto _ : state)
+		callback_chain(256, [&calls]
+					   { calls++; });
+	bench::do_not_optimize(calls);
+}
+
+CPPUTILS_BENCHMARK(asyncio_event_set_await)
+{
+	for (auto _ : state)
+	{
+		async_manual_reset_event event;
+		auto waiter = [](async_manual_reset_event &event) -> task<void>
+		{ co_await event; };
+		auto t = waiter(event);
+		event.set();
+		t.run_sync();
+	}
+}
+
+// An iteration starts that many waiting coroutines on one event and sets it, the time covers all of them
+static asyncio::detail::detached_task event_waiter(async_manual_reset_event &event, size_t &resumed)
+{
+	co_await event;
+	resumed++;
+}
+
+static void event_fan_out(bench::state &state, size_t waiters)
+{
+	size_t resumed = 0;
+	for (auto _ : state)
+	{
+		async_manual_reset_event event;
+		for (size_t i = 0; i < waiters; i++)
+			event_waiter(event, resumed);
+		event.set();
+	}
+	bench::do_not_optimize(resumed);
+}
+
+CPPUTILS_BENCHMARK(asyncio_event_waiters_1)
+{
+	event_fan_out(state, 1);
+}
+
+CPPUTILS_BENCHMARK(asyncio_event_waiters_100)
+{
+	event_fan_out(state, 100);
+}
+
+CPPUTILS_BENCHMARK(asyncio_event_waiters_10k)
+{
+	event_fan_out(state, 10000);
+}
+
+CPPUTILS_BENCHMARK(asyncio_event_waiters_100k)
+{
+	event_fan_out(state, 100000);
+}
+
+// Listener list of a callback based event, the vector keeps its capacity between iterations
+static void callback_fan_out(bench::state &state, size_t waiters)
+{
+	size_t resumed = 0;
+	array_list<std::function<void()>> listeners;
+	listeners.reserve(waiters);
+	for (auto _ : state)
+	{
+		for (size_t i = 0; i < waiters; i++)
+			listeners.emplace_back([&resumed]
+								   { resumed++; });
+		for (auto &listener : listeners)
+			listener();
+		listeners.clear();
+	}
+	bench::do_not_optimize(resumed);
+}
+
+CPPUTILS_BENCHMARK(asyncio_callback_waiters_1)
+{
+	callback_fan_out(state, 1);
+}
+
+CPPUTILS_BENCHMARK(asyncio_callback_waiters_100)
+{
+	callback_fan_out(state, 100);
+}
+
+CPPUTILS_BENCHMARK(asyncio_callback_waiters_10k)
+{
+	callback_fan_out(state, 10000);
+}
+
+CPPUTILS_BENCHMARK(asyncio_callback_waiters_100k)
+{
+	callback_fan_out(state, 100000);
+}
+
+static task<int> ready_value()
+{
+	co_return 1;
+}
+
+CPPUTILS_BENCHMARK(asyncio_then_chain_4)
+{
+	for (auto _ : state)
+	{
+		auto t = ready_value() | transform([](int v)
+										   { return v + 1; }) |
+				 transform([](int v)
+						   { return v * 2; }) |
+				 transform([](int v)
+						   { return v - 1; }) |
+				 transform([](int v)
+						   { return v + 3; });
+		bench::do_not_optimize(t.run_sync());
+	}
+}
+
+// Hands the coroutine to a pool worker and the completion back to the waiting thread
+static task<void> pool_hop(thread_pool &pool)
+{
+	co_await pool.schedule();
+}
+
+CPPUTILS_BENCHMARK(asyncio_thread_pool_hand_off)
+{
+	static thread_pool pool(1);
+	for (auto _ : state)
+		sync_wait(pool_hop(pool));
+}
+
+// The same round trip with a callback queued to a worker thread that signals back when done
+class callback_worker
+{
+public:
+	callback_worker() : m_thread([this]
+								 { run(); })
+	{
+	}
+
+	~callback_worker()
+	{
+		post(nullptr);
+		m_thread.join();
+	}
+
+	// A null callback stops the worker
+	void post(std::function<void()> callback)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_queue.push_back(std::move(callback));
+		}
+		m_condition.notify_one();
+	}
+
+private:
+	void run()
+	{
+		for (;;)
+		{
+			std::function<void()> callback;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this]
+								 { return !m_queue.empty(); });
+				callback = std::move(m_queue.front());
+				m_queue.pop_front();
+			}
+			if (!callback)
+				return;
+			callback();
+		}
+	}
+
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<std::function<void()>> m_queue;
+	std::thread m_thread;
+};
+
+CPPUTILS_BENCHMARK(asyncio_callback_hand_off)
+{
+	static callback_worker worker;
+	for (auto _ : state)
+	{
+		std::mutex mutex;
+		std::condition_variable condition;
+		bool done = false;
+		worker.post([&]
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						done = true;
+						condition.notify_one(); });
+
+		std::unique_lock<std::mutex> lock(mutex);
+		condition.wait(lock, [&done]
+					   { return done; });
+	}
+}
+
+// Hops between two shards, a round trip crosses each ring once
+static task<void> shard_round_trips(sharded_runtime &runtime, bench::state &state)
+{
+	co_await on_shard(runtime, 0);
+	for (auto _ : state)
+	{
+		co_await on_shard(runtime, 1);
+		co_await on_shard(runtime, 0);
+	}
+}
+
+CPPUTILS_BENCHMARK(asyncio_shard_hop_round_trip)
+{
+	static sharded_runtime runtime(2, false);
+	sync_wait(shard_round_trips(runtime, state));
+}
+
+// Requeues itself on a single worker, each iteration goes through the deadline heap once
+static task<void> priority_requeues(priority_executor &executor, bench::state &state)
+{
+	co_await executor.schedule(task_priority::high);
+	for (auto _ : state)
+		co_await executor.schedule(task_priority::high);
+}
+
+CPPUTILS_BENCHMARK(asyncio_priority_requeue)
+{
+	static priority_executor executor(1);
+	sync_wait(priority_requeues(executor, state));
+}
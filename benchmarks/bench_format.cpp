@@ -0,0 +1,32 @@
+#include <cpputils/bench/bench.h>
+
+using namespace cpputils;
+
+CPPUTILS_BENCHMARK(format_to_string_int)
+{
+	int value = 123456;
+	for (auto _ : state)
+	{
+		bench::do_not_optimize(value);
+		string result = to_string(value);
+		bench::do_not_optimize(result);
+	}
+}
+
+CPPUTILS_BENCHMARK(format_cformat)
+{
+	for (auto _ : state)
+	{
+		string result = cformat("%s=%d (%f)", "answer", 42, 4.2);
+		bench::do_not_optimize(result);
+	}
+}
+
+CPPUTILS_BENCHMARK(format_placeholders)
+{
+	for (auto _ : state)
+	{
+		string result = format("Hello, {}! You are \\{{}\\} years old.", "World", 25);
+		bench::do_not_optimize(result);
+	}
+}
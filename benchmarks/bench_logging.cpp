@@ -0,0 +1,31 @@
+#include <cpputils/bench/bench.h>
+
+using namespace cpputils;
+
+// Logger whose handler only counts the records, so the benchmark measures the logging path itself
+static ref<logger> make_counting_logger(uint64_t &records)
+{
+	auto result = make_ref<logger>("bench");
+	result->add_handler(log_handler::from_custom_logger([&records](logger *, const log_record &record)
+														{ records++; bench::do_not_optimize(record); }));
+	return result;
+}
+
+CPPUTILS_BENCHMARK(logging_info)
+{
+	uint64_t records = 0;
+	auto log = make_counting_logger(records);
+	for (auto _ : state)
+		log->info("bench", "request {} took {} ms", 42, 1.5);
+	bench::do_not_optimize(records);
+}
+
+CPPUTILS_BENCHMARK(logging_filtered_debug)
+{
+	uint64_t records = 0;
+	auto log = make_counting_logger(records);
+	log->set_config(log_level::INFO);
+	for (auto _ : state)
+		log->debug("bench", "request {} took {} ms", 42, 1.5);
+	bench::do_not_optimize(records);
+}
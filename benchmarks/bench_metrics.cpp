@@ -0,0 +1,61 @@
+#include <cpputils/bench/bench.h>
+#include <cpputils/core/metrics.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace cpputils;
+
+// Runs body on every core but one until destroyed, the benchmark loop takes the last core
+// The threads start before the timed loop and keep hammering until it is over.
+class contenders
+{
+public:
+	template <typename FUNC>
+	explicit contenders(FUNC body)
+	{
+		const unsigned count = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+		for (unsigned i = 0; i < count; i++)
+		{
+			m_threads.emplace_back([this, body]
+			{
+				while (!m_stop.load(std::memory_order_relaxed))
+					body();
+			});
+		}
+	}
+
+	~contenders()
+	{
+		m_stop.store(true, std::memory_order_relaxed);
+		for (auto &thread : m_threads)
+			thread.join();
+	}
+
+	contenders(const contenders &) = delete;
+	contenders &operator=(const contenders &) = delete;
+
+private:
+	std::atomic<bool> m_stop{false};
+	std::vector<std::thread> m_threads;
+};
+
+CPPUTILS_BENCHMARK(metrics_counter_inc)
+{
+	metrics::counter counter;
+	contenders others([&counter] { counter.inc(); });
+	for (auto _ : state)
+		counter.inc();
+	bench::do_not_optimize(counter.value());
+}
+
+// Baseline, every thread increments the same cache line
+CPPUTILS_BENCHMARK(metrics_atomic_inc)
+{
+	std::atomic<uint64_t> counter{0};
+	contenders others([&counter] { counter.fetch_add(1, std::memory_order_relaxed); });
+	for (auto _ : state)
+		counter.fetch_add(1, std::memory_order_relaxed);
+	bench::do_not_optimize(counter.load(std::memory_order_relaxed));
+}
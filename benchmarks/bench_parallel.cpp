@@ -0,0 +1,56 @@
+#include <cpputils/bench/bench.h>
+#include <cpputils/core/parallel.h>
+#include <random>
+
+using namespace cpputils;
+
+// Every iteration sorts a fresh copy, the copy is part of the measured time
+static const array_list<uint64_t> &random_keys()
+{
+	static const array_list<uint64_t> keys = []
+	{
+		array_list<uint64_t> values(1 << 20);
+		std::mt19937_64 random(42);
+		for (auto &value : values)
+			value = random();
+		return values;
+	}();
+	return keys;
+}
+
+CPPUTILS_BENCHMARK(parallel_std_sort_1m)
+{
+	for (auto _ : state)
+	{
+		auto keys = random_keys();
+		std::sort(keys.begin(), keys.end());
+		bench::do_not_optimize(keys);
+	}
+}
+
+CPPUTILS_BENCHMARK(parallel_sort_1m)
+{
+	for (auto _ : state)
+	{
+		auto keys = random_keys();
+		parallel_sort(keys.begin(), keys.end());
+		bench::do_not_optimize(keys);
+	}
+}
+
+CPPUTILS_BENCHMARK(parallel_radix_sort_1m)
+{
+	for (auto _ : state)
+	{
+		auto keys = random_keys();
+		parallel_radix_sort(keys.begin(), keys.end());
+		bench::do_not_optimize(keys);
+	}
+}
+
+CPPUTILS_BENCHMARK(parallel_reduce_1m)
+{
+	const auto &keys = random_keys();
+	for (auto _ : state)
+		bench::do_not_optimize(parallel_reduce(keys.begin(), keys.end(), uint64_t(0), std::plus<>{}));
+}
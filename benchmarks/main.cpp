@@ -0,0 +1,4 @@
+#include <cpputils/bench/bench.h>
+#include <cpputils/bench/count_allocations.h>
+
+CPPUTILS_BENCHMARK_MAIN()
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		// Pipeable adaptors
+		// The closures below only carry their arguments, each coroutine type provides the operator|
+		// overloads applying them, e.g. generator.h, async_generator.h and coroutine.h for tasks:
+		//
+		//   for (auto &line : read_lines(file) | filter(is_record) | transform(parse) | take(100))
+		namespace detail
+		{
+			template <typename FUNC>
+			struct transform_adaptor
+			{
+				FUNC m_func;
+			};
+
+			template <typename PREDICATE>
+			struct filter_adaptor
+			{
+				PREDICATE m_predicate;
+			};
+
+			struct take_adaptor
+			{
+				size_t m_count;
+			};
+
+			template <typename EXECUTOR>
+			struct on_adaptor
+			{
+				EXECUTOR *m_executor;
+			};
+		}
+
+		// Maps every item through func
+		template <typename FUNC>
+		detail::transform_adaptor<FUNC> transform(FUNC func)
+		{
+			return {std::move(func)};
+		}
+
+		// Keeps the items for which predicate returns true
+		template <typename PREDICATE>
+		detail::filter_adaptor<PREDICATE> filter(PREDICATE predicate)
+		{
+			return {std::move(predicate)};
+		}
+
+		// Stops after count items
+		inline detail::take_adaptor take(size_t count)
+		{
+			return {count};
+		}
+
+		// Runs the pipeline on executor, see coroutine.h
+		template <typename EXECUTOR>
+		detail::on_adaptor<EXECUTOR> on(EXECUTOR &executor)
+		{
+			return {&executor};
+		}
+	}
+}
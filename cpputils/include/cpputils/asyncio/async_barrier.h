@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		/// \brief
+		/// Reusable barrier for a fixed group of coroutines.
+		///
+		/// Each participant co_awaits arrive_and_wait() once per phase. The last one to arrive starts
+		/// the next phase and resumes the others inline, in arrival order, before continuing itself.
+		class async_barrier
+		{
+		public:
+			class arrive_operation
+			{
+			public:
+				explicit arrive_operation(async_barrier &barrier) noexcept : m_barrier(barrier) {}
+
+				bool await_ready() const noexcept { return false; }
+
+				bool await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+
+					// Push before counting the arrival, the last arrival must find everyone on the stack
+					arrive_operation *head = m_barrier.m_waiters.load(std::memory_order_relaxed);
+					do
+					{
+						m_next = head;
+					} while (!m_barrier.m_waiters.compare_exchange_weak(head, this, std::memory_order_release, std::memory_order_relaxed));
+
+					if (!m_barrier.arrive())
+						return true;
+
+					m_barrier.complete_phase(this);
+					return false;
+				}
+
+				void await_resume() const noexcept {}
+
+			private:
+				friend class async_barrier;
+
+				async_barrier &m_barrier;
+				arrive_operation *m_next = nullptr;
+				std::coroutine_handle<> m_awaitingCoroutine;
+			};
+
+			explicit async_barrier(size_t participants) noexcept
+				: m_participants(participants), m_remaining(participants)
+			{
+			}
+
+			async_barrier(const async_barrier &) = delete;
+			async_barrier &operator=(const async_barrier &) = delete;
+
+			// Must be co_await'ed
+			arrive_operation arrive_and_wait() noexcept
+			{
+				return arrive_operation{*this};
+			}
+
+			// Arrives for the current phase and leaves the group for the following ones
+			void arrive_and_drop() noexcept
+			{
+				m_participants.fetch_sub(1, std::memory_order_relaxed);
+				if (arrive())
+					complete_phase(nullptr);
+			}
+
+		private:
+			// True for the last arrival of the phase
+			bool arrive() noexcept
+			{
+				return m_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1;
+			}
+
+			void complete_phase(arrive_operation *last) noexcept
+			{
+				// Nobody arrives for the next phase before being resumed, reset first
+				m_remaining.store(m_participants.load(std::memory_order_relaxed), std::memory_order_relaxed);
+				arrive_operation *waiters = m_waiters.exchange(nullptr, std::memory_order_acq_rel);
+
+				arrive_operation *fifo = nullptr;
+				while (waiters != nullptr)
+				{
+					arrive_operation *next = waiters->m_next;
+					waiters->m_next = fifo;
+					fifo = waiters;
+					waiters = next;
+				}
+
+				while (fifo != nullptr)
+				{
+					// Read m_next before resuming, resuming the waiter may destroy it
+					arrive_operation *next = fifo->m_next;
+					if (fifo != last)
+						fifo->m_awaitingCoroutine.resume();
+					fifo = next;
+				}
+			}
+
+			std::atomic<size_t> m_participants;
+			std::atomic<size_t> m_remaining;
+			std::atomic<arrive_operation *> m_waiters{nullptr};
+		};
+	}
+}
@@ -0,0 +1,352 @@
+#pragma once
+
+#include <cpputils/asyncio/adaptors.h>
+#include <cpputils/asyncio/frame_allocator.h>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+// source: https://github.com/lewissbaker/cppcoro/blob/master/include/cppcoro/async_generator.hpp
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		template <typename T>
+		class async_generator;
+
+		namespace detail
+		{
+			template <typename T>
+			class async_generator_iterator;
+
+			template <typename T>
+			class async_generator_advance_operation;
+
+			template <typename T>
+			class async_generator_increment_operation;
+
+			template <typename T>
+			class async_generator_promise : public frame_allocated
+			{
+			public:
+				using value_type = std::remove_reference_t<T>;
+				using reference_type = std::conditional_t<std::is_reference_v<T>, T, T &>;
+				using pointer_type = value_type *;
+
+				async_generator<T> get_return_object() noexcept;
+
+				std::suspend_always initial_suspend() const noexcept { return {}; }
+
+				// Hands the item to the consumer that asked for it
+				// A consumer still inside its advance operation's await_suspend picks the item up when
+				// resume() returns, only a consumer that suspended meanwhile is resumed from here. Items
+				// produced without waiting thus never nest the consumer and the producer on the stack.
+				struct yield_awaiter
+				{
+					async_generator_promise &m_promise;
+
+					bool await_ready() const noexcept { return false; }
+
+					std::coroutine_handle<> await_suspend(std::coroutine_handle<>) noexcept
+					{
+						state expected = state::consumer_running;
+						if (m_promise.m_state.compare_exchange_strong(expected, state::value_ready, std::memory_order_acq_rel))
+							return std::noop_coroutine();
+
+						m_promise.m_state.store(state::value_ready, std::memory_order_relaxed);
+						return m_promise.m_consumerCoroutine;
+					}
+
+					void await_resume() noexcept {}
+				};
+
+				yield_awaiter final_suspend() noexcept
+				{
+					m_value = nullptr;
+					return yield_awaiter{*this};
+				}
+
+				// Yielded values are referenced, not copied, a temporary lives until the consumer asks for more
+				yield_awaiter yield_value(value_type &value) noexcept
+				{
+					m_value = std::addressof(value);
+					return yield_awaiter{*this};
+				}
+
+				yield_awaiter yield_value(value_type &&value) noexcept
+				{
+					m_value = std::addressof(value);
+					return yield_awaiter{*this};
+				}
+
+				void unhandled_exception() noexcept
+				{
+					m_exception = std::current_exception();
+				}
+
+				void return_void() noexcept {}
+
+				bool finished() const noexcept
+				{
+					return m_value == nullptr;
+				}
+
+				void rethrow_if_exception()
+				{
+					if (m_exception)
+						std::rethrow_exception(m_exception);
+				}
+
+				reference_type value() const noexcept
+				{
+					return static_cast<reference_type>(*m_value);
+				}
+
+			private:
+				friend class async_generator_advance_operation<T>;
+
+				enum class state : uint8_t
+				{
+					value_ready,
+					// The consumer resumed the producer and has not returned from await_suspend yet
+					consumer_running,
+					consumer_suspended
+				};
+
+				std::coroutine_handle<> m_consumerCoroutine;
+				pointer_type m_value = nullptr;
+				std::exception_ptr m_exception;
+				std::atomic<state> m_state{state::value_ready};
+			};
+
+			// Awaiter resuming the producer until its next co_yield or its end
+			template <typename T>
+			class async_generator_advance_operation
+			{
+			protected:
+				using coroutine_handle = std::coroutine_handle<async_generator_promise<T>>;
+
+				explicit async_generator_advance_operation(coroutine_handle producer) noexcept : m_producer(producer) {}
+
+				// Null once the producer ran off its end, after rethrowing what it threw
+				coroutine_handle next_producer() const
+				{
+					if (!m_producer || !m_producer.promise().finished())
+						return m_producer;
+
+					m_producer.promise().rethrow_if_exception();
+					return nullptr;
+				}
+
+			public:
+				bool await_ready() const noexcept
+				{
+					return !m_producer;
+				}
+
+				// Runs the producer inline, the consumer only suspends if it had to wait before its co_yield
+				bool await_suspend(std::coroutine_handle<> consumerCoroutine) noexcept
+				{
+					using state = typename async_generator_promise<T>::state;
+					auto &promise = m_producer.promise();
+					promise.m_consumerCoroutine = consumerCoroutine;
+					promise.m_state.store(state::consumer_running, std::memory_order_relaxed);
+					m_producer.resume();
+
+					state expected = state::consumer_running;
+					return promise.m_state.compare_exchange_strong(expected, state::consumer_suspended, std::memory_order_acq_rel);
+				}
+
+			private:
+				coroutine_handle m_producer;
+			};
+
+			// Result of co_await generator.begin()
+			template <typename T>
+			class async_generator_begin_operation : public async_generator_advance_operation<T>
+			{
+			public:
+				explicit async_generator_begin_operation(typename async_generator_advance_operation<T>::coroutine_handle producer) noexcept
+					: async_generator_advance_operation<T>(producer)
+				{
+				}
+
+				async_generator_iterator<T> await_resume()
+				{
+					return async_generator_iterator<T>{this->next_producer()};
+				}
+			};
+
+			// Result of co_await ++iterator, advances the iterator in place
+			template <typename T>
+			class async_generator_increment_operation : public async_generator_advance_operation<T>
+			{
+			public:
+				explicit async_generator_increment_operation(async_generator_iterator<T> &iterator) noexcept
+					: async_generator_advance_operation<T>(iterator.m_producer), m_iterator(iterator)
+				{
+				}
+
+				async_generator_iterator<T> &await_resume()
+				{
+					m_iterator.m_producer = this->next_producer();
+					return m_iterator;
+				}
+
+			private:
+				async_generator_iterator<T> &m_iterator;
+			};
+
+			template <typename T>
+			class async_generator_iterator
+			{
+				using coroutine_handle = std::coroutine_handle<async_generator_promise<T>>;
+
+			public:
+				using iterator_category = std::input_iterator_tag;
+				using difference_type = std::ptrdiff_t;
+				using value_type = typename async_generator_promise<T>::value_type;
+				using reference = typename async_generator_promise<T>::reference_type;
+				using pointer = typename async_generator_promise<T>::pointer_type;
+
+				async_generator_iterator() noexcept = default;
+
+				explicit async_generator_iterator(coroutine_handle producer) noexcept : m_producer(producer) {}
+
+				// Must be co_await'ed, the iterator equals end() afterwards once the producer is done
+				async_generator_increment_operation<T> operator++() noexcept
+				{
+					return async_generator_increment_operation<T>{*this};
+				}
+
+				reference operator*() const noexcept
+				{
+					return m_producer.promise().value();
+				}
+
+				pointer operator->() const noexcept
+				{
+					return std::addressof(operator*());
+				}
+
+				bool operator==(const async_generator_iterator &other) const noexcept
+				{
+					return m_producer == other.m_producer;
+				}
+
+			private:
+				friend class async_generator_increment_operation<T>;
+
+				coroutine_handle m_producer = nullptr;
+			};
+		}
+
+		/// \brief
+		/// Lazy sequence produced by a coroutine that may co_await between its co_yields.
+		///
+		/// Iterate it from another coroutine, awaiting begin() and every increment:
+		///
+		///   for (auto it = co_await records.begin(); it != records.end(); co_await ++it)
+		///       process(*it);
+		///
+		/// The producer runs on whichever thread resumes it and hands each item back by reference.
+		template <typename T>
+		class [[nodiscard]] async_generator
+		{
+		public:
+			using promise_type = detail::async_generator_promise<T>;
+			using iterator = detail::async_generator_iterator<T>;
+
+			async_generator() noexcept = default;
+
+			async_generator(async_generator &&other) noexcept : m_coroutine(std::exchange(other.m_coroutine, nullptr)) {}
+
+			async_generator(const async_generator &) = delete;
+
+			async_generator &operator=(async_generator other) noexcept
+			{
+				std::swap(m_coroutine, other.m_coroutine);
+				return *this;
+			}
+
+			~async_generator()
+			{
+				if (m_coroutine)
+					m_coroutine.destroy();
+			}
+
+			// Must be co_await'ed, runs the producer to its first co_yield
+			detail::async_generator_begin_operation<T> begin() noexcept
+			{
+				return detail::async_generator_begin_operation<T>{m_coroutine};
+			}
+
+			iterator end() noexcept
+			{
+				return iterator{nullptr};
+			}
+
+		private:
+			friend class detail::async_generator_promise<T>;
+
+			explicit async_generator(std::coroutine_handle<promise_type> coroutine) noexcept : m_coroutine(coroutine) {}
+
+			std::coroutine_handle<promise_type> m_coroutine = nullptr;
+		};
+
+		namespace detail
+		{
+			template <typename T>
+			async_generator<T> async_generator_promise<T>::get_return_object() noexcept
+			{
+				return async_generator<T>{std::coroutine_handle<async_generator_promise<T>>::from_promise(*this)};
+			}
+		}
+
+		// The loops below avoid co_await in a for increment, GCC 12 rejects it inside templates
+
+		template <typename T, typename FUNC>
+		async_generator<std::invoke_result_t<FUNC &, typename async_generator<T>::iterator::reference>> operator|(async_generator<T> source, detail::transform_adaptor<FUNC> adaptor)
+		{
+			auto it = co_await source.begin();
+			while (it != source.end())
+			{
+				co_yield std::invoke(adaptor.m_func, *it);
+				co_await ++it;
+			}
+		}
+
+		template <typename T, typename PREDICATE>
+		async_generator<T> operator|(async_generator<T> source, detail::filter_adaptor<PREDICATE> adaptor)
+		{
+			auto it = co_await source.begin();
+			while (it != source.end())
+			{
+				if (std::invoke(adaptor.m_predicate, std::as_const(*it)))
+					co_yield *it;
+				co_await ++it;
+			}
+		}
+
+		template <typename T>
+		async_generator<T> operator|(async_generator<T> source, detail::take_adaptor adaptor)
+		{
+			size_t taken = 0;
+			auto it = taken < adaptor.m_count ? co_await source.begin() : source.end();
+			while (it != source.end())
+			{
+				co_yield *it;
+				if (++taken == adaptor.m_count)
+					break;
+				co_await ++it;
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cpputils/asyncio/reset_events.h>
+#include <atomic>
+#include <cstddef>
+
+// source: https://github.com/lewissbaker/cppcoro/blob/master/include/cppcoro/async_latch.hpp
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		/// \brief
+		/// Single use countdown, awaiting coroutines resume once it reaches zero.
+		///
+		/// The coroutines are resumed inline by the count_down() call reaching zero.
+		class async_latch
+		{
+		public:
+			explicit async_latch(std::ptrdiff_t initialCount) noexcept
+				: m_count(initialCount), m_event(initialCount <= 0)
+			{
+			}
+
+			async_latch(const async_latch &) = delete;
+			async_latch &operator=(const async_latch &) = delete;
+
+			bool is_ready() const noexcept
+			{
+				return m_event.is_set();
+			}
+
+			void count_down(std::ptrdiff_t n = 1) noexcept
+			{
+				if (m_count.fetch_sub(n, std::memory_order_acq_rel) <= n)
+					m_event.set();
+			}
+
+			auto operator co_await() const noexcept
+			{
+				return m_event.operator co_await();
+			}
+
+		private:
+			std::atomic<std::ptrdiff_t> m_count;
+			async_manual_reset_event m_event;
+		};
+	}
+}
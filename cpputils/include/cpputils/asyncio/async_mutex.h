@@ -0,0 +1,305 @@
+#pragma once
+
+#include <cpputils/asyncio/cancellation.h>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+// source: https://github.com/lewissbaker/cppcoro/blob/master/include/cppcoro/async_mutex.hpp
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		class async_mutex_lock;
+
+		namespace detail
+		{
+			class task_promise_base;
+		}
+
+		/// \brief
+		/// Mutex for coroutines, waiting for it suspends the coroutine instead of blocking the thread.
+		///
+		/// Waiters get the lock in FIFO order. unlock() hands the lock straight to the next waiter and
+		/// resumes it inline, so a coroutine resumes on the thread that released the mutex. A waiting
+		/// task whose cancellation token is cancelled stops waiting and throws operation_cancelled.
+		///
+		///   auto lock = co_await mutex.scoped_lock_async();
+		class async_mutex
+		{
+		public:
+			class lock_operation
+			{
+			public:
+				explicit lock_operation(async_mutex &mutex) noexcept : m_mutex(mutex) {}
+
+				lock_operation(const lock_operation &other) noexcept : m_mutex(other.m_mutex) {}
+
+				// An unlocked mutex is taken without suspending
+				bool await_ready() noexcept { return m_mutex.try_lock(); }
+
+				template <typename PROMISE>
+				bool await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine)
+				{
+					if constexpr (std::is_base_of_v<detail::task_promise_base, PROMISE>)
+					{
+						detail::cancellation_state *cancellation = awaitingCoroutine.promise().cancellation();
+						if (cancellation != nullptr && cancellation->can_be_cancelled())
+							return suspend_cancellable(awaitingCoroutine, detail::cancellation_access::token(cancellation));
+					}
+					return suspend(awaitingCoroutine);
+				}
+
+				void await_resume()
+				{
+					if (m_ticket != nullptr)
+					{
+						// Waits for a callback still running on another thread
+						m_registration.reset();
+						m_ticket->release_ticket();
+						m_ticket = nullptr;
+						if (m_cancelled)
+							throw operation_cancelled{};
+					}
+				}
+
+			protected:
+				friend class async_mutex;
+
+				async_mutex &m_mutex;
+
+			private:
+				static constexpr uint8_t waiting = 0;
+				static constexpr uint8_t granted = 1;
+				static constexpr uint8_t cancelled = 2;
+
+				// Takes the lock or pushes waiter, true if it was pushed
+				bool push(lock_operation *waiter) noexcept
+				{
+					uintptr_t oldState = m_mutex.m_state.load(std::memory_order_acquire);
+					while (true)
+					{
+						if (oldState == not_locked)
+						{
+							if (m_mutex.m_state.compare_exchange_weak(oldState, locked_no_waiters, std::memory_order_acquire, std::memory_order_relaxed))
+								return false;
+						}
+						else
+						{
+							// Push onto the waiters pushed since the holder last looked
+							waiter->m_next = reinterpret_cast<lock_operation *>(oldState);
+							if (m_mutex.m_state.compare_exchange_weak(oldState, reinterpret_cast<uintptr_t>(waiter), std::memory_order_release, std::memory_order_relaxed))
+								return true;
+						}
+					}
+				}
+
+				bool suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+					return push(this);
+				}
+
+				// A heap allocated ticket waits in the stack instead of the awaiter
+				// Cancellation marks the ticket and resumes the awaiter, unlock() drops cancelled tickets
+				// and passes the lock on. The unlocking thread and the cancellation each release the
+				// latch once they won the ticket, the awaiter releases it once registered.
+				bool suspend_cancellable(std::coroutine_handle<> awaitingCoroutine, cancellation_token token)
+				{
+					// No ticket if the mutex was released since await_ready
+					if (m_mutex.try_lock())
+						return false;
+
+					m_awaitingCoroutine = awaitingCoroutine;
+					auto *ticket = new lock_operation(m_mutex);
+					ticket->m_owner = this;
+					if (!push(ticket))
+					{
+						delete ticket;
+						return false;
+					}
+					m_ticket = ticket;
+
+					m_registration.emplace(std::move(token), [this]
+					{
+						uint8_t expected = waiting;
+						if (m_ticket->m_ticketState.compare_exchange_strong(expected, cancelled, std::memory_order_acq_rel))
+						{
+							m_cancelled = true;
+							complete();
+						}
+					});
+					return m_references.fetch_sub(1, std::memory_order_acq_rel) != 1;
+				}
+
+				void complete() noexcept
+				{
+					if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						m_awaitingCoroutine.resume();
+				}
+
+				// Ticket only, false if its awaiter was cancelled first
+				bool grant() noexcept
+				{
+					uint8_t expected = waiting;
+					return m_ticketState.compare_exchange_strong(expected, granted, std::memory_order_acq_rel);
+				}
+
+				// Ticket only, the mutex and the awaiter each hold a reference
+				void release_ticket() noexcept
+				{
+					if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						delete this;
+				}
+
+				lock_operation *m_next = nullptr;
+				std::coroutine_handle<> m_awaitingCoroutine;
+
+				// Awaiter of a cancellable task, m_references is its latch
+				lock_operation *m_ticket = nullptr;
+				bool m_cancelled = false;
+				std::optional<cancellation_registration> m_registration;
+				std::atomic<uint32_t> m_references{2};
+
+				// Ticket
+				lock_operation *m_owner = nullptr;
+				std::atomic<uint8_t> m_ticketState{waiting};
+			};
+
+			class scoped_lock_operation : public lock_operation
+			{
+			public:
+				using lock_operation::lock_operation;
+
+				[[nodiscard]] async_mutex_lock await_resume();
+			};
+
+			async_mutex() noexcept : m_state(not_locked) {}
+
+			// Frees the tickets cancelled waiters left behind
+			~async_mutex()
+			{
+				uintptr_t state = m_state.load(std::memory_order_relaxed);
+				lock_operation *pushed = state == not_locked ? nullptr : reinterpret_cast<lock_operation *>(state);
+				for (lock_operation *list : {pushed, m_waiters})
+				{
+					while (list != nullptr)
+					{
+						lock_operation *next = list->m_next;
+						if (list->m_owner != nullptr)
+							list->release_ticket();
+						list = next;
+					}
+				}
+			}
+
+			async_mutex(const async_mutex &) = delete;
+			async_mutex &operator=(const async_mutex &) = delete;
+
+			bool try_lock() noexcept
+			{
+				uintptr_t oldState = not_locked;
+				return m_state.compare_exchange_strong(oldState, locked_no_waiters, std::memory_order_acquire, std::memory_order_relaxed);
+			}
+
+			// Must be co_await'ed, the caller calls unlock() afterwards
+			lock_operation lock_async() noexcept
+			{
+				return lock_operation{*this};
+			}
+
+			// Must be co_await'ed, yields an async_mutex_lock unlocking on destruction
+			scoped_lock_operation scoped_lock_async() noexcept
+			{
+				return scoped_lock_operation{*this};
+			}
+
+			void unlock()
+			{
+				while (true)
+				{
+					lock_operation *waitersHead = m_waiters;
+					if (waitersHead == nullptr)
+					{
+						uintptr_t oldState = locked_no_waiters;
+						if (m_state.compare_exchange_strong(oldState, not_locked, std::memory_order_release, std::memory_order_relaxed))
+							return;
+
+						// Take the pushed waiters and reverse them into FIFO order
+						oldState = m_state.exchange(locked_no_waiters, std::memory_order_acquire);
+						auto *next = reinterpret_cast<lock_operation *>(oldState);
+						do
+						{
+							lock_operation *temp = next->m_next;
+							next->m_next = waitersHead;
+							waitersHead = next;
+							next = temp;
+						} while (next != nullptr);
+					}
+
+					// The lock passes to the waiter without ever being released
+					m_waiters = waitersHead->m_next;
+					lock_operation *owner = waitersHead->m_owner;
+					if (owner == nullptr)
+					{
+						waitersHead->m_awaitingCoroutine.resume();
+						return;
+					}
+
+					// A ticket, skipped if its waiter was cancelled
+					const bool granted = waitersHead->grant();
+					waitersHead->release_ticket();
+					if (granted)
+					{
+						owner->complete();
+						return;
+					}
+				}
+			}
+
+		private:
+			// - not_locked => unlocked
+			// - locked_no_waiters => locked, nobody pushed since the holder last looked
+			// - otherwise => locked, head of a stack of lock_operation*
+			static constexpr uintptr_t not_locked = 1;
+			static constexpr uintptr_t locked_no_waiters = 0;
+
+			std::atomic<uintptr_t> m_state;
+
+			// FIFO of waiters only touched by the lock holder
+			lock_operation *m_waiters = nullptr;
+		};
+
+		// Owns a locked async_mutex and unlocks it on destruction
+		class async_mutex_lock
+		{
+		public:
+			explicit async_mutex_lock(async_mutex &mutex, std::adopt_lock_t) noexcept : m_mutex(&mutex) {}
+
+			async_mutex_lock(async_mutex_lock &&other) noexcept : m_mutex(std::exchange(other.m_mutex, nullptr)) {}
+
+			async_mutex_lock(const async_mutex_lock &) = delete;
+			async_mutex_lock &operator=(const async_mutex_lock &) = delete;
+
+			~async_mutex_lock()
+			{
+				if (m_mutex != nullptr)
+					m_mutex->unlock();
+			}
+
+		private:
+			async_mutex *m_mutex;
+		};
+
+		inline async_mutex_lock async_mutex::scoped_lock_operation::await_resume()
+		{
+			lock_operation::await_resume();
+			return async_mutex_lock{m_mutex, std::adopt_lock};
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cpputils/asyncio/reset_events.h>
+#include <cstdint>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		/// \brief
+		/// Counting semaphore for coroutines.
+		///
+		/// co_await acquire() suspends until a permit is available, release() hands permits to the
+		/// waiters in FIFO order and resumes them inline. No thread ever blocks on it.
+		class async_semaphore
+		{
+		public:
+			// Largest number of permits the semaphore holds, release() drops permits beyond it
+			static constexpr uint32_t max_available = 0x7fffffff;
+
+			explicit async_semaphore(uint32_t initialPermits) noexcept : m_queue(std::min(initialPermits, max_available)) {}
+
+			async_semaphore(const async_semaphore &) = delete;
+			async_semaphore &operator=(const async_semaphore &) = delete;
+
+			// Must be co_await'ed
+			detail::async_permit_queue::operation acquire() noexcept
+			{
+				return m_queue.acquire();
+			}
+
+			bool try_acquire() noexcept
+			{
+				return m_queue.try_acquire();
+			}
+
+			void release(uint32_t count = 1) noexcept
+			{
+				m_queue.release(count, max_available);
+			}
+
+			// Permits no coroutine waits for
+			uint32_t available() const noexcept
+			{
+				return m_queue.available();
+			}
+
+		private:
+			detail::async_permit_queue m_queue;
+		};
+	}
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <utility>
+
+// source: https://github.com/lewissbaker/cppcoro/blob/master/include/cppcoro/cancellation_token.hpp
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		class cancellation_token;
+		class cancellation_registration;
+
+		namespace detail
+		{
+			struct cancellation_access;
+		}
+
+		/// \brief
+		/// Exception an operation completes with once its cancellation_token was cancelled.
+		class operation_cancelled : public std::exception
+		{
+		public:
+			const char *what() const noexcept override
+			{
+				return "operation cancelled";
+			}
+		};
+
+		namespace detail
+		{
+			// State shared by a cancellation_source and its tokens and registrations
+			// Registrations claim a slot in a list of chunks with a CAS and free it with another CAS,
+			// whoever empties a slot owns its callback. request_cancellation() raises the flag and
+			// then empties every slot, a registration claiming a slot re-checks the flag afterwards and
+			// takes its slot back to run its callback itself, so no callback is lost or run twice.
+			class CPPUTILS_API cancellation_state
+			{
+			public:
+				static cancellation_state *create()
+				{
+					return new cancellation_state();
+				}
+
+				void add_token_ref() noexcept;
+				void release_token_ref() noexcept;
+				void add_source_ref() noexcept;
+				void release_source_ref() noexcept;
+
+				bool can_be_cancelled() const noexcept;
+				bool is_cancellation_requested() const noexcept;
+
+				void request_cancellation();
+
+				// False if cancellation was requested first, the caller runs the callback itself then
+				bool try_register(cancellation_registration *registration);
+
+				// Blocks while the callback runs on another thread
+				void deregister(cancellation_registration *registration) noexcept;
+
+			private:
+				struct chunk
+				{
+					explicit chunk(size_t size) : m_size(size), m_slots(new std::atomic<cancellation_registration *>[size]()) {}
+
+					size_t m_size;
+					chunk *m_next = nullptr;
+					std::unique_ptr<std::atomic<cancellation_registration *>[]> m_slots;
+				};
+
+				cancellation_state() noexcept = default;
+				~cancellation_state();
+
+				void release() noexcept;
+
+				static constexpr int not_requested = 0;
+				static constexpr int notifying = 1;
+				static constexpr int notified = 2;
+
+				// Sources and tokens
+				std::atomic<uint32_t> m_references{1};
+				std::atomic<uint32_t> m_sources{1};
+				std::atomic<int> m_cancelled{not_requested};
+				std::atomic<chunk *> m_chunks{nullptr};
+
+				// Registration whose callback request_cancellation() is running
+				std::atomic<cancellation_registration *> m_running{nullptr};
+				std::thread::id m_notifyingThread;
+			};
+		}
+
+		/// \brief
+		/// Read side of a cancellation_source, cheap to copy and pass down.
+		///
+		/// A default constructed token can never be cancelled.
+		class CPPUTILS_API cancellation_token
+		{
+		public:
+			cancellation_token() noexcept = default;
+
+			cancellation_token(const cancellation_token &other) noexcept;
+			cancellation_token(cancellation_token &&other) noexcept : m_state(std::exchange(other.m_state, nullptr)) {}
+			~cancellation_token();
+
+			cancellation_token &operator=(const cancellation_token &other) noexcept;
+			cancellation_token &operator=(cancellation_token &&other) noexcept;
+
+			bool can_be_cancelled() const noexcept
+			{
+				return m_state != nullptr && m_state->can_be_cancelled();
+			}
+
+			bool is_cancellation_requested() const noexcept
+			{
+				return m_state != nullptr && m_state->is_cancellation_requested();
+			}
+
+			void throw_if_cancellation_requested() const
+			{
+				if (is_cancellation_requested())
+					throw operation_cancelled{};
+			}
+
+			void swap(cancellation_token &other) noexcept
+			{
+				std::swap(m_state, other.m_state);
+			}
+
+		private:
+			friend class cancellation_source;
+			friend class cancellation_registration;
+			friend struct detail::cancellation_access;
+
+			explicit cancellation_token(detail::cancellation_state *state) noexcept;
+
+			detail::cancellation_state *m_state = nullptr;
+		};
+
+		/// \brief
+		/// Owner side of a cancellation, hands out tokens and requests cancellation.
+		class CPPUTILS_API cancellation_source
+		{
+		public:
+			cancellation_source();
+
+			cancellation_source(const cancellation_source &other) noexcept;
+			cancellation_source(cancellation_source &&other) noexcept : m_state(std::exchange(other.m_state, nullptr)) {}
+			~cancellation_source();
+
+			cancellation_source &operator=(const cancellation_source &other) noexcept;
+			cancellation_source &operator=(cancellation_source &&other) noexcept;
+
+			cancellation_token token() const noexcept
+			{
+				return cancellation_token{m_state};
+			}
+
+			bool can_be_cancelled() const noexcept
+			{
+				return m_state != nullptr;
+			}
+
+			bool is_cancellation_requested() const noexcept
+			{
+				return m_state != nullptr && m_state->is_cancellation_requested();
+			}
+
+			// Runs the registered callbacks on the calling thread, later calls do nothing
+			void request_cancellation();
+
+		private:
+			detail::cancellation_state *m_state;
+		};
+
+		/// \brief
+		/// Runs a callback once the token is cancelled, for as long as the registration lives.
+		///
+		/// The callback runs inline in the constructor if cancellation was already requested,
+		/// otherwise on the thread calling request_cancellation(). The destructor waits for a
+		/// callback running on another thread, it may be destroyed from within its own callback.
+		class CPPUTILS_API cancellation_registration
+		{
+		public:
+			template <typename FUNC>
+				requires std::constructible_from<std::function<void()>, FUNC>
+			cancellation_registration(cancellation_token token, FUNC &&callback)
+				: m_callback(std::forward<FUNC>(callback))
+			{
+				register_callback(std::move(token));
+			}
+
+			~cancellation_registration();
+
+			cancellation_registration(const cancellation_registration &) = delete;
+			cancellation_registration &operator=(const cancellation_registration &) = delete;
+
+		private:
+			friend class detail::cancellation_state;
+
+			void register_callback(cancellation_token &&token);
+
+			std::function<void()> m_callback;
+			detail::cancellation_state *m_state = nullptr;
+			std::atomic<cancellation_registration *> *m_slot = nullptr;
+		};
+
+		namespace detail
+		{
+			// Lets awaiters hand a token's state around without touching its reference count
+			struct cancellation_access
+			{
+				static cancellation_state *state(const cancellation_token &token) noexcept
+				{
+					return token.m_state;
+				}
+
+				static cancellation_token token(cancellation_state *state) noexcept
+				{
+					return cancellation_token{state};
+				}
+			};
+		}
+	}
+}
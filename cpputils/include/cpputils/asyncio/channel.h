@@ -0,0 +1,480 @@
+#pragma once
+
+#include <cpputils/asyncio/reset_events.h>
+#include <atomic>
+#include <bit>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		namespace detail
+		{
+			// Lock-free MPMC ring, Dmitry Vyukov's bounded queue with a closed bit on the tail
+			// Every cell carries a sequence telling the lap it expects next, a sender claims a cell by
+			// moving the tail and publishes it by bumping the sequence. Once closed no push succeeds,
+			// which lets the receivers of an unbounded channel move to the next ring after draining it.
+			template <typename T>
+			class channel_ring
+			{
+			public:
+				enum class push_result
+				{
+					pushed,
+					full,
+					closed
+				};
+
+				explicit channel_ring(size_t capacity) : m_mask(capacity - 1), m_cells(new cell[capacity])
+				{
+					for (size_t i = 0; i < capacity; i++)
+						m_cells[i].m_sequence.store(i, std::memory_order_relaxed);
+				}
+
+				~channel_ring()
+				{
+					const size_t tail = m_tail.load(std::memory_order_relaxed) & ~closed_bit;
+					for (size_t pos = m_head.load(std::memory_order_relaxed); pos != tail; pos++)
+						m_cells[pos & m_mask].value()->~T();
+				}
+
+				channel_ring(const channel_ring &) = delete;
+				channel_ring &operator=(const channel_ring &) = delete;
+
+				size_t capacity() const noexcept
+				{
+					return m_mask + 1;
+				}
+
+				template <typename U>
+				push_result try_push(U &&value) noexcept
+				{
+					size_t pos = m_tail.load(std::memory_order_relaxed);
+					while (true)
+					{
+						if (pos & closed_bit)
+							return push_result::closed;
+
+						cell &target = m_cells[pos & m_mask];
+						const size_t sequence = target.m_sequence.load(std::memory_order_acquire);
+						const auto difference = static_cast<std::ptrdiff_t>(sequence - pos);
+						if (difference == 0)
+						{
+							if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed, std::memory_order_relaxed))
+							{
+								::new (static_cast<void *>(target.m_storage)) T(std::forward<U>(value));
+								target.m_sequence.store(pos + 1, std::memory_order_release);
+								return push_result::pushed;
+							}
+						}
+						else if (difference < 0)
+						{
+							// The cell still holds the previous lap's item
+							return push_result::full;
+						}
+						else
+						{
+							pos = m_tail.load(std::memory_order_relaxed);
+						}
+					}
+				}
+
+				// False once every claimed cell was received
+				bool try_pop(std::optional<T> &out) noexcept
+				{
+					size_t pos = m_head.load(std::memory_order_relaxed);
+					while (true)
+					{
+						cell &source = m_cells[pos & m_mask];
+						const size_t sequence = source.m_sequence.load(std::memory_order_acquire);
+						const auto difference = static_cast<std::ptrdiff_t>(sequence - (pos + 1));
+						if (difference == 0)
+						{
+							if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed, std::memory_order_relaxed))
+							{
+								T *value = source.value();
+								out.emplace(std::move(*value));
+								value->~T();
+								source.m_sequence.store(pos + m_mask + 1, std::memory_order_release);
+								return true;
+							}
+						}
+						else if (difference < 0)
+						{
+							// Not written yet, either nobody claimed the cell or its sender is still moving into it
+							if ((m_tail.load(std::memory_order_acquire) & ~closed_bit) <= pos)
+								return false;
+							std::this_thread::yield();
+							pos = m_head.load(std::memory_order_relaxed);
+						}
+						else
+						{
+							pos = m_head.load(std::memory_order_relaxed);
+						}
+					}
+				}
+
+				void close() noexcept
+				{
+					m_tail.fetch_or(closed_bit, std::memory_order_acq_rel);
+				}
+
+				bool closed() const noexcept
+				{
+					return (m_tail.load(std::memory_order_acquire) & closed_bit) != 0;
+				}
+
+				// Ring taking over once this one is closed, set before closing it
+				std::atomic<channel_ring *> m_next{nullptr};
+
+			private:
+				static constexpr size_t closed_bit = size_t(1) << (std::numeric_limits<size_t>::digits - 1);
+
+				struct cell
+				{
+					std::atomic<size_t> m_sequence;
+					alignas(T) std::byte m_storage[sizeof(T)];
+
+					T *value() noexcept
+					{
+						return std::launder(reinterpret_cast<T *>(m_storage));
+					}
+				};
+
+				const size_t m_mask;
+				std::unique_ptr<cell[]> m_cells;
+				alignas(64) std::atomic<size_t> m_head{0};
+				alignas(64) std::atomic<size_t> m_tail{0};
+			};
+		}
+
+		/// \brief
+		/// Multi-producer multi-consumer queue between coroutines.
+		///
+		/// A bounded channel holds at most capacity items, co_await send() suspends the sender while it
+		/// is full. An unbounded channel never suspends senders, its storage grows by chaining rings of
+		/// twice the size. Suspended senders and receivers wait in FIFO order and are resumed inline by
+		/// the coroutine receiving or sending on the other side.
+		///
+		/// After close() sends fail, receivers drain what is left and then get std::nullopt. A task
+		/// cancelled while it waits to send or receive throws operation_cancelled, nothing was sent
+		/// or received then.
+		///
+		///   while (auto item = co_await requests.receive())
+		///       co_await handle(*item);
+		template <typename T>
+		class channel
+		{
+			static_assert(std::is_nothrow_move_constructible_v<T>, "channel items must be nothrow move constructible");
+
+			using ring = detail::channel_ring<T>;
+
+		public:
+			static constexpr size_t unbounded = std::numeric_limits<size_t>::max();
+			static constexpr size_t max_capacity = 0x7fffffff;
+
+			class send_operation
+			{
+			public:
+				send_operation(channel &owner, T value) noexcept
+					: m_channel(owner), m_value(std::move(value)), m_slot(owner.m_slots)
+				{
+				}
+
+				bool await_ready() noexcept
+				{
+					return !m_channel.bounded() || m_channel.m_slots.try_acquire();
+				}
+
+				template <typename PROMISE>
+				bool await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine)
+				{
+					return m_slot.await_suspend(awaitingCoroutine);
+				}
+
+				// False if the channel was closed, the item was not sent
+				// Throws operation_cancelled if the sending task was cancelled while waiting for room.
+				bool await_resume()
+				{
+					m_slot.await_resume();
+					return m_channel.push_reserved(std::move(m_value));
+				}
+
+			private:
+				channel &m_channel;
+				T m_value;
+				detail::async_permit_queue::operation m_slot;
+			};
+
+			class receive_operation
+			{
+			public:
+				explicit receive_operation(channel &owner) noexcept : m_channel(owner), m_item(owner.m_items) {}
+
+				bool await_ready() noexcept
+				{
+					return m_channel.m_items.try_acquire();
+				}
+
+				template <typename PROMISE>
+				bool await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine)
+				{
+					return m_item.await_suspend(awaitingCoroutine);
+				}
+
+				// Empty once the channel is closed and drained
+				// Throws operation_cancelled if the receiving task was cancelled while waiting for an item.
+				std::optional<T> await_resume()
+				{
+					m_item.await_resume();
+					return m_channel.pop_reserved();
+				}
+
+			protected:
+				channel &m_channel;
+				detail::async_permit_queue::operation m_item;
+			};
+
+			class receive_many_operation : public receive_operation
+			{
+			public:
+				receive_many_operation(channel &owner, std::vector<T> &out, size_t maxCount) noexcept
+					: receive_operation(owner), m_out(out), m_maxCount(maxCount)
+				{
+				}
+
+				// Number of items appended, 0 once the channel is closed and drained
+				size_t await_resume()
+				{
+					this->m_item.await_resume();
+					std::optional<T> first = this->m_channel.pop_reserved();
+					if (!first)
+						return 0;
+					m_out.push_back(std::move(*first));
+
+					size_t received = 1;
+					if (m_maxCount > 1)
+					{
+						uint32_t extra = this->m_channel.m_items.try_acquire_many(static_cast<uint32_t>(std::min<size_t>(m_maxCount - 1, max_capacity)));
+						for (; extra > 0; extra--)
+						{
+							std::optional<T> item = this->m_channel.pop_reserved();
+							if (!item)
+								break;
+							m_out.push_back(std::move(*item));
+							received++;
+						}
+					}
+					return received;
+				}
+
+			private:
+				std::vector<T> &m_out;
+				size_t m_maxCount;
+			};
+
+			// Unbounded unless a capacity up to max_capacity is given
+			explicit channel(size_t capacity = unbounded)
+				: m_capacity(capacity), m_slots(capacity == unbounded ? 0 : static_cast<uint32_t>(capacity)), m_items(0)
+			{
+				if (capacity == 0 || (capacity != unbounded && capacity > max_capacity))
+					throw std::invalid_argument("channel capacity must be between 1 and channel::max_capacity");
+
+				m_first = new ring(std::bit_ceil(bounded() ? capacity : initial_unbounded_capacity));
+				m_sendRing.store(m_first, std::memory_order_relaxed);
+				m_receiveRing.store(m_first, std::memory_order_relaxed);
+			}
+
+			// No coroutine may still be waiting on the channel
+			~channel()
+			{
+				ring *current = m_first;
+				while (current != nullptr)
+				{
+					ring *next = current->m_next.load(std::memory_order_relaxed);
+					delete current;
+					current = next;
+				}
+			}
+
+			channel(const channel &) = delete;
+			channel &operator=(const channel &) = delete;
+
+			bool bounded() const noexcept
+			{
+				return m_capacity != unbounded;
+			}
+
+			size_t capacity() const noexcept
+			{
+				return m_capacity;
+			}
+
+			bool is_closed() const noexcept
+			{
+				return m_closed.load(std::memory_order_acquire);
+			}
+
+			// Must be co_await'ed, yields false if the channel was closed
+			send_operation send(T value) noexcept
+			{
+				return send_operation{*this, std::move(value)};
+			}
+
+			// Must be co_await'ed, yields the next item or std::nullopt once closed and drained
+			receive_operation receive() noexcept
+			{
+				return receive_operation{*this};
+			}
+
+			// Must be co_await'ed, waits for one item then appends up to maxCount without waiting again
+			receive_many_operation receive_many(std::vector<T> &out, size_t maxCount) noexcept
+			{
+				return receive_many_operation{*this, out, maxCount};
+			}
+
+			// Sends only if that doesn't need to wait, value is left untouched otherwise
+			bool try_send(T &&value) noexcept
+			{
+				if (bounded() && !m_slots.try_acquire())
+					return false;
+				return push_reserved(std::move(value));
+			}
+
+			bool try_send(const T &value)
+			{
+				T copy(value);
+				return try_send(std::move(copy));
+			}
+
+			std::optional<T> try_receive() noexcept
+			{
+				if (!m_items.try_acquire())
+					return std::nullopt;
+				return pop_reserved();
+			}
+
+			// Fails later sends and lets every waiting sender and receiver through
+			void close() noexcept
+			{
+				if (m_closed.exchange(true, std::memory_order_seq_cst))
+					return;
+				m_items.release(max_capacity, max_capacity);
+				if (bounded())
+					m_slots.release(max_capacity, max_capacity);
+			}
+
+		private:
+			static constexpr size_t initial_unbounded_capacity = 64;
+
+			// The caller holds a slot, or the channel is unbounded
+			bool push_reserved(T &&value) noexcept
+			{
+				// m_sending tells receivers of a closed channel whether an item may still show up
+				m_sending.fetch_add(1, std::memory_order_seq_cst);
+				if (m_closed.load(std::memory_order_seq_cst))
+				{
+					m_sending.fetch_sub(1, std::memory_order_release);
+					return false;
+				}
+
+				ring *target = m_sendRing.load(std::memory_order_acquire);
+				while (true)
+				{
+					const auto result = target->try_push(std::move(value));
+					if (result == ring::push_result::pushed)
+						break;
+
+					if (result == ring::push_result::full)
+					{
+						// A bounded ring only looks full while a receiver moves out of the cell
+						if (bounded())
+						{
+							std::this_thread::yield();
+							continue;
+						}
+						grow(target);
+					}
+					target = m_sendRing.load(std::memory_order_acquire);
+				}
+
+				// Stop counting before the release, it may resume receivers inline
+				m_sending.fetch_sub(1, std::memory_order_release);
+				m_items.release(1, max_capacity);
+				return true;
+			}
+
+			void grow(ring *full)
+			{
+				ring *next = full->m_next.load(std::memory_order_acquire);
+				if (next == nullptr)
+				{
+					ring *fresh = new ring(full->capacity() * 2);
+					if (full->m_next.compare_exchange_strong(next, fresh, std::memory_order_acq_rel, std::memory_order_acquire))
+						next = fresh;
+					else
+						delete fresh;
+				}
+				full->close();
+				m_sendRing.compare_exchange_strong(full, next, std::memory_order_acq_rel, std::memory_order_relaxed);
+			}
+
+			bool pop(std::optional<T> &out) noexcept
+			{
+				ring *source = m_receiveRing.load(std::memory_order_acquire);
+				while (true)
+				{
+					if (source->try_pop(out))
+						return true;
+					if (!source->closed())
+						return false;
+
+					// Closed rings are drained before moving on, keeping the items in order
+					if (source->try_pop(out))
+						return true;
+					ring *next = source->m_next.load(std::memory_order_acquire);
+					if (m_receiveRing.compare_exchange_strong(source, next, std::memory_order_acq_rel, std::memory_order_acquire))
+						source = next;
+				}
+			}
+
+			// The caller holds an item permit, only a closed channel hands out permits without items
+			std::optional<T> pop_reserved() noexcept
+			{
+				std::optional<T> value;
+				if (!pop(value))
+				{
+					while (m_sending.load(std::memory_order_seq_cst) != 0)
+						std::this_thread::yield();
+					if (!pop(value))
+						return std::nullopt;
+				}
+
+				if (bounded())
+					m_slots.release(1, static_cast<uint32_t>(m_capacity));
+				return value;
+			}
+
+			const size_t m_capacity;
+			detail::async_permit_queue m_slots;
+			detail::async_permit_queue m_items;
+			std::atomic<bool> m_closed{false};
+			std::atomic<uint32_t> m_sending{0};
+			ring *m_first;
+			std::atomic<ring *> m_sendRing;
+			std::atomic<ring *> m_receiveRing;
+		};
+	}
+}
@@ -5,10 +5,17 @@
 #include <optional>
 #include <iostream>
 #include <atomic>
+#include <cpputils/asyncio/adaptors.h>
+#include <cpputils/asyncio/detached_task.h>
 #include <cpputils/asyncio/reset_events.h>
 #include <cpputils/asyncio/coroutine_semantics.h>
 #include <cpputils/asyncio/sync_wait_task.h>
+#include <cpputils/asyncio/coroutine_trace.h>
+#include <cpputils/asyncio/coroutine_stats.h>
+#include <cpputils/asyncio/frame_allocator.h>
+#include <cpputils/asyncio/cancellation.h>
 #include <functional>
+#include <source_location>
 
 namespace cpputils
 {
@@ -111,9 +118,76 @@ public:
 		template <typename T>
 		class task;
 
+#if defined(CPPUTILS_TRACE_COROUTINES) || defined(CPPUTILS_COROUTINE_STATS)
+#define CPPUTILS_OBSERVE_COROUTINES
+#endif
+
 		namespace detail
 		{
-			class task_promise_base
+#if defined(CPPUTILS_OBSERVE_COROUTINES)
+			// Forwards the lifetime of a task to the tracer and the stats recorder enabled in this build
+			class coroutine_observer
+			{
+			public:
+				coroutine_observer(const std::source_location &location) noexcept
+#if defined(CPPUTILS_TRACE_COROUTINES) && defined(CPPUTILS_COROUTINE_STATS)
+					: m_tracer(location), m_stats(location)
+#elif defined(CPPUTILS_TRACE_COROUTINES)
+					: m_tracer(location)
+#else
+					: m_stats(location)
+#endif
+				{
+				}
+
+				void on_resume() noexcept
+				{
+#if defined(CPPUTILS_TRACE_COROUTINES)
+					m_tracer.on_resume();
+#endif
+#if defined(CPPUTILS_COROUTINE_STATS)
+					m_stats.on_resume();
+#endif
+				}
+
+				void on_suspend() noexcept
+				{
+#if defined(CPPUTILS_TRACE_COROUTINES)
+					m_tracer.on_suspend();
+#endif
+#if defined(CPPUTILS_COROUTINE_STATS)
+					m_stats.on_suspend();
+#endif
+				}
+
+				void on_complete() noexcept
+				{
+#if defined(CPPUTILS_TRACE_COROUTINES)
+					m_tracer.on_complete();
+#endif
+#if defined(CPPUTILS_COROUTINE_STATS)
+					m_stats.on_complete();
+#endif
+				}
+
+#if defined(CPPUTILS_COROUTINE_STATS)
+				const std::source_location &location() const noexcept
+				{
+					return m_stats.location();
+				}
+#endif
+
+			private:
+#if defined(CPPUTILS_TRACE_COROUTINES)
+				coroutine_tracer m_tracer;
+#endif
+#if defined(CPPUTILS_COROUTINE_STATS)
+				coroutine_stats_recorder m_stats;
+#endif
+			};
+#endif
+
+			class task_promise_base : public frame_allocated
 			{
 				friend struct final_awaitable;
 
@@ -125,6 +199,9 @@ public:
 					std::coroutine_handle<> await_suspend(
 						std::coroutine_handle<PROMISE> coro) noexcept
 					{
+#if defined(CPPUTILS_OBSERVE_COROUTINES)
+						coro.promise().m_observer.on_complete();
+#endif
 						return coro.promise().m_continuation;
 					}
 
@@ -132,14 +209,56 @@ public:
 				};
 
 			public:
-				task_promise_base() noexcept
+				// The location defaults to the coroutine function as the promise is constructed inside it
+				task_promise_base([[maybe_unused]] const std::source_location &location = std::source_location::current()) noexcept
+#if defined(CPPUTILS_OBSERVE_COROUTINES)
+					: m_observer(location)
+#endif
 				{
 				}
 
+#if defined(CPPUTILS_OBSERVE_COROUTINES)
+				auto initial_suspend() noexcept
+				{
+					struct initial_awaitable
+					{
+						coroutine_observer &m_observer;
+
+						bool await_ready() const noexcept { return false; }
+						void await_suspend(std::coroutine_handle<>) const noexcept {}
+						void await_resume() const noexcept { m_observer.on_resume(); }
+					};
+
+					return initial_awaitable{m_observer};
+				}
+
+				template <typename AWAITABLE>
+				decltype(auto) await_transform(AWAITABLE &&awaitable)
+				{
+					// Awaitables only reachable through a non-member operator co_await declared after this header
+					// are passed through untraced, the co_await expression still finds their operator
+					if constexpr (asyncio::member_co_await_awaitable<AWAITABLE> || asyncio::global_co_await_awaitable<AWAITABLE>)
+					{
+						using awaiter_type = decltype(get_awaiter(std::forward<AWAITABLE>(awaitable)));
+						return traced_awaiter<awaiter_type, coroutine_observer>(get_awaiter(std::forward<AWAITABLE>(awaitable)), m_observer);
+					}
+					else if constexpr (asyncio::awaitable<AWAITABLE>)
+					{
+						// An awaiter lives until the end of the co_await expression, it is used in place as
+						// timers and other awaiters registered with a service cannot be moved
+						return traced_awaiter<AWAITABLE &, coroutine_observer>(awaitable, m_observer);
+					}
+					else
+					{
+						return static_cast<AWAITABLE &&>(awaitable);
+					}
+				}
+#else
 				auto initial_suspend() noexcept
 				{
 					return std::suspend_always{};
 				}
+#endif
 
 				auto final_suspend() noexcept
 				{
@@ -151,15 +270,48 @@ public:
 					m_continuation = continuation;
 				}
 
+				// Token of the task, inherited from the awaiting task unless bound with with_cancellation
+				// Borrowed, whoever bound it keeps it alive until the task and the tasks it awaits complete.
+				cancellation_state *cancellation() const noexcept
+				{
+					return m_cancellation;
+				}
+
+				void set_cancellation(cancellation_state *state) noexcept
+				{
+					m_cancellation = state;
+				}
+
+				void inherit_cancellation(cancellation_state *parent) noexcept
+				{
+					if (m_cancellation == nullptr)
+						m_cancellation = parent;
+				}
+
+#if defined(CPPUTILS_COROUTINE_STATS)
+				// Source location of the coroutine function, waits are charged to it
+				const std::source_location &location() const noexcept
+				{
+					return m_observer.location();
+				}
+#endif
+
 			private:
 				std::coroutine_handle<> m_continuation;
+				cancellation_state *m_cancellation = nullptr;
+#if defined(CPPUTILS_OBSERVE_COROUTINES)
+				coroutine_observer m_observer;
+#endif
 			};
 
 			template <typename T>
 			class task_promise final : public task_promise_base
 			{
 			public:
-				task_promise() noexcept {}
+				task_promise(const std::source_location &location = std::source_location::current()) noexcept
+					: task_promise_base(location)
+				{
+				}
 
 				~task_promise()
 				{
@@ -250,7 +402,10 @@ public:
 			class task_promise<void> : public task_promise_base
 			{
 			public:
-				task_promise() noexcept = default;
+				task_promise(const std::source_location &location = std::source_location::current()) noexcept
+					: task_promise_base(location)
+				{
+				}
 
 				task<void> get_return_object() noexcept;
 
@@ -279,7 +434,10 @@ public:
 			class task_promise<T &> : public task_promise_base
 			{
 			public:
-				task_promise() noexcept = default;
+				task_promise(const std::source_location &location = std::source_location::current()) noexcept
+					: task_promise_base(location)
+				{
+				}
 
 				task<T &> get_return_object() noexcept;
 
@@ -309,6 +467,39 @@ public:
 			};
 		}
 
+		namespace detail
+		{
+			// Value awaiting a continuation's result yields, a returned task is awaited in turn
+			template <typename T>
+			struct unwrap_task
+			{
+				static constexpr bool is_task = false;
+				using type = T;
+			};
+
+			template <typename T>
+			struct unwrap_task<task<T>>
+			{
+				static constexpr bool is_task = true;
+				using type = T;
+			};
+
+			template <typename FUNC, typename TASK>
+			struct continuation_result
+			{
+				using value_type = typename awaitable_traits<TASK>::awaiter_return_type;
+				using invoke_type = typename std::conditional_t<std::is_void_v<value_type>, std::invoke_result<FUNC &>, std::invoke_result<FUNC &, value_type>>::type;
+				using type = typename unwrap_task<invoke_type>::type;
+			};
+
+			template <typename FUNC, typename TASK>
+			task<typename continuation_result<FUNC, TASK>::type> continue_with(TASK operation, FUNC func);
+
+			// Whether func called on the result of a task<T> returns something convertible to U
+			template <typename U, typename FUNC, typename T>
+			inline constexpr bool continues_as = std::conditional_t<std::is_void_v<T>, std::is_invocable_r<U, FUNC &>, std::is_invocable_r<U, FUNC &, T>>::value;
+		}
+
 		/// \brief
 		/// A task represents an operation that produces a result both lazily
 		/// and asynchronously.
@@ -340,9 +531,13 @@ public:
 					return !m_coroutine || m_coroutine.done();
 				}
 
+				template <typename PROMISE>
 				std::coroutine_handle<> await_suspend(
-					std::coroutine_handle<> awaitingCoroutine) noexcept
+					std::coroutine_handle<PROMISE> awaitingCoroutine) noexcept
 				{
+					// Passing the token down is a pointer copy, nested tasks observe the same cancellation
+					if constexpr (std::is_base_of_v<detail::task_promise_base, PROMISE>)
+						m_coroutine.promise().inherit_cancellation(awaitingCoroutine.promise().cancellation());
 					m_coroutine.promise().set_continuation(awaitingCoroutine);
 					return m_coroutine;
 				}
@@ -458,26 +653,76 @@ public:
 				return awaitable{m_coroutine};
 			}
 
-			template <typename U, typename V = T>
-				requires(!std::is_void_v<V>)
-			task<U> then(std::function<U(V)> func)
+			/// \brief
+			/// Binds the task to token, which it and the tasks it awaits observe instead of the awaiter's.
+			///
+			/// The token is borrowed, it must be kept alive until the task completes.
+			void set_cancellation_token(const cancellation_token &token) noexcept
 			{
-				auto value = co_await *this;
-				co_return func(value);
+				if (m_coroutine)
+					m_coroutine.promise().set_cancellation(detail::cancellation_access::state(token));
 			}
 
-			template <typename V = T>
-				requires(std::is_void_v<V>)
-			task<void> then(std::function<void()> func)
+			// Binds the task to token unless it is bound already, as awaiting it from a task does
+			// For combinators starting tasks from coroutines that are not tasks, the token is borrowed too.
+			void inherit_cancellation_token(const cancellation_token &token) noexcept
 			{
-				co_await *this;
-				func();
+				if (m_coroutine)
+					m_coroutine.promise().inherit_cancellation(detail::cancellation_access::state(token));
 			}
 
-			template <typename... Args>
-			static task create(std::function<T(Args...)> func, Args... args)
+			/// \brief
+			/// Continues with func called on the task's result, or without arguments for task<void>.
+			///
+			/// The callable is kept in the continuation's frame and the result is moved into it. When
+			/// func returns a task the continuation awaits it, yielding its value. Called on an lvalue
+			/// the task is awaited in place and must outlive the continuation, an rvalue is moved in.
+			template <typename FUNC>
+			auto then(FUNC func) &
 			{
-				co_return func(args...);
+				return detail::continue_with<FUNC, task &>(*this, std::move(func));
+			}
+
+			template <typename FUNC>
+			auto then(FUNC func) &&
+			{
+				return detail::continue_with<FUNC, task>(std::move(*this), std::move(func));
+			}
+
+			// then<U>(func) from when func was a std::function<U(T)>, yields func's result converted to U
+			template <typename U, typename FUNC>
+				requires detail::continues_as<U, FUNC, T>
+			auto then(FUNC func) &
+			{
+				return then([func = std::move(func)](auto &&...value) mutable -> U
+							{ return std::invoke(func, std::forward<decltype(value)>(value)...); });
+			}
+
+			template <typename U, typename FUNC>
+				requires detail::continues_as<U, FUNC, T>
+			auto then(FUNC func) &&
+			{
+				return std::move(*this).then([func = std::move(func)](auto &&...value) mutable -> U
+											 { return std::invoke(func, std::forward<decltype(value)>(value)...); });
+			}
+
+			// Task calling func with args, both stored in its frame and moved into the call
+			// A func returning a task<T> is awaited.
+			template <typename FUNC, typename... ARGS>
+			static task create(FUNC func, ARGS... args)
+			{
+				if constexpr (detail::unwrap_task<std::invoke_result_t<FUNC &, ARGS...>>::is_task)
+					co_return co_await std::invoke(func, std::move(args)...);
+				else
+					co_return std::invoke(func, std::move(args)...);
+			}
+
+			// create<ARGS...>(func, args...) from when func was a std::function<T(ARGS...)>
+			template <typename... ARGS, typename FUNC>
+				requires(sizeof...(ARGS) > 0 && std::is_invocable_r_v<T, FUNC &, ARGS...>)
+			static task create(FUNC func, std::type_identity_t<ARGS>... args)
+			{
+				return create<FUNC, ARGS...>(std::move(func), std::move(args)...);
 			}
 
 			T run_sync()
@@ -509,12 +754,80 @@ public:
 			}
 		}
 
+		namespace detail
+		{
+			struct cancellation_token_operation
+			{
+				bool await_ready() const noexcept { return false; }
+
+				template <typename PROMISE>
+				bool await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine) noexcept
+				{
+					if constexpr (std::is_base_of_v<task_promise_base, PROMISE>)
+						m_state = awaitingCoroutine.promise().cancellation();
+					return false;
+				}
+
+				cancellation_token await_resume() const noexcept
+				{
+					return cancellation_access::token(m_state);
+				}
+
+				cancellation_state *m_state = nullptr;
+			};
+		}
+
+		// Yields the token of the calling task, one that cannot be cancelled outside of a task
+		inline detail::cancellation_token_operation get_cancellation_token() noexcept
+		{
+			return {};
+		}
+
 		template <awaitable AWAITABLE>
 		auto make_task(AWAITABLE awaitable)
 			-> task<typename awaitable_traits<AWAITABLE>::awaiter_return_type>
 		{
 			co_return co_await static_cast<AWAITABLE &&>(awaitable);
 		}
+
+		namespace detail
+		{
+			template <typename FUNC, typename TASK>
+			task<typename continuation_result<FUNC, TASK>::type> continue_with(TASK operation, FUNC func)
+			{
+				using result = continuation_result<FUNC, TASK>;
+				if constexpr (std::is_void_v<typename result::value_type>)
+				{
+					co_await static_cast<TASK &&>(operation);
+					if constexpr (unwrap_task<typename result::invoke_type>::is_task)
+						co_return co_await std::invoke(func);
+					else
+						co_return std::invoke(func);
+				}
+				else
+				{
+					if constexpr (unwrap_task<typename result::invoke_type>::is_task)
+						co_return co_await std::invoke(func, co_await static_cast<TASK &&>(operation));
+					else
+						co_return std::invoke(func, co_await static_cast<TASK &&>(operation));
+				}
+			}
+		}
+
+		// task | transform(func) is std::move(task).then(func)
+		template <typename T, typename FUNC>
+		auto operator|(task<T> operation, detail::transform_adaptor<FUNC> adaptor)
+		{
+			return std::move(operation).then(std::move(adaptor.m_func));
+		}
+
+		// task | on(executor) starts the task, and so everything piped into it, on executor
+		template <typename T, typename EXECUTOR>
+		task<T> operator|(task<T> operation, detail::on_adaptor<EXECUTOR> adaptor)
+		{
+			co_await adaptor.m_executor->schedule();
+			co_return co_await std::move(operation);
+		}
 	}
 
 }
\ No newline at end of file
@@ -33,6 +33,14 @@ namespace cpputils
 		template <typename type>
 		concept awaitable = member_co_await_awaitable<type> || global_co_await_awaitable<type> || awaiter<type>;
 
+		/**
+		 * An executor: co_await'ing its schedule() continues the coroutine on one of its threads.
+		 */
+		template <typename type>
+		concept scheduler = requires(type &t) {
+			{ t.schedule() } -> awaitable;
+		};
+
 		template <awaitable awaitable>
 		static auto get_awaiter(awaitable &&value)
 		{
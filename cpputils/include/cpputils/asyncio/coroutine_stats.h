@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core/chrono.h>
+#include <cpputils/core/collections.h>
+#include <cpputils/core/string.h>
+#include <cstddef>
+#include <cstdint>
+#include <coroutine>
+#include <source_location>
+
+// Per coroutine runtime statistics
+// Define CPPUTILS_COROUTINE_STATS (cmake -DCPPUTILS_COROUTINE_STATS=ON) to have every task count its
+// resumes, the time it spent running and the time it spent suspended. A task keeps the counts in its
+// frame and adds them to the table of the thread it completes on, keyed by the source location of the
+// coroutine function. The reset event awaiters also count the waits of the task awaiting them, and the
+// time it spent in those waits, under that task's location.
+// Without the define the promise and the awaiters carry no extra state and nothing is recorded.
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		namespace coroutine_stats
+		{
+			// Totals of one coroutine function, or of one kind of wait
+			struct entry
+			{
+				string function;
+				string file;
+				uint32_t line = 0;
+				// Coroutines that completed, zero for waits
+				uint64_t completions = 0;
+				uint64_t resumes = 0;
+				uint64_t running_ns = 0;
+				uint64_t suspended_ns = 0;
+				// Waits on reset events, semaphores and channels, their time is part of suspended_ns
+				uint64_t waits = 0;
+				uint64_t waiting_ns = 0;
+			};
+
+			// Key the top entries are sorted by, descending
+			enum class order
+			{
+				running,
+				suspended,
+				resumes,
+				waiting
+			};
+
+			// Merges the tables of every thread and returns the count largest entries
+			CPPUTILS_API array_list<entry> top(size_t count, order by = order::running);
+
+			// Formats top(count, by) as a table, one entry per line
+			CPPUTILS_API string report(size_t count = 20, order by = order::running);
+
+			// Clears the tables of every thread
+			CPPUTILS_API void reset();
+
+			namespace detail
+			{
+				// Adds to the calling thread's entry of location
+				CPPUTILS_API void record(const std::source_location &location, uint64_t completions, uint64_t resumes,
+										 uint64_t runningNs, uint64_t suspendedNs) noexcept;
+
+				// Adds a wait to the calling thread's entry of location
+				CPPUTILS_API void record_wait(const std::source_location &location, uint64_t waitingNs) noexcept;
+			}
+		}
+
+		namespace detail
+		{
+			// Counts the resumes and running and suspended time of a single coroutine
+			// The time between creation and the first resume counts as suspended.
+			class coroutine_stats_recorder
+			{
+			public:
+				coroutine_stats_recorder(const std::source_location &location) noexcept
+					: m_location(location), m_last(chrono::steady_clock::now())
+				{
+				}
+
+				void on_resume() noexcept
+				{
+					m_suspendedNs += elapsed_ns();
+					m_resumes++;
+				}
+
+				void on_suspend() noexcept
+				{
+					m_runningNs += elapsed_ns();
+				}
+
+				void on_complete() noexcept
+				{
+					m_runningNs += elapsed_ns();
+					coroutine_stats::detail::record(m_location, 1, m_resumes, m_runningNs, m_suspendedNs);
+				}
+
+				const std::source_location &location() const noexcept
+				{
+					return m_location;
+				}
+
+			private:
+				uint64_t elapsed_ns() noexcept
+				{
+					auto now = chrono::steady_clock::now();
+					auto elapsed = std::chrono::duration_cast<chrono::nanoseconds>(now - m_last).count();
+					m_last = now;
+					return static_cast<uint64_t>(elapsed);
+				}
+
+				std::source_location m_location;
+				chrono::steady_time_point m_last;
+				uint64_t m_resumes = 0;
+				uint64_t m_runningNs = 0;
+				uint64_t m_suspendedNs = 0;
+			};
+
+			// Times a single wait of an awaiter, start() must run before the awaiter is published
+			// Only waits of tasks are recorded, under the location of the task.
+			class wait_stats_recorder
+			{
+			public:
+				template <typename PROMISE>
+				void charge_to(std::coroutine_handle<PROMISE> awaitingCoroutine) noexcept
+				{
+					if constexpr (requires { awaitingCoroutine.promise().location(); })
+						m_location = &awaitingCoroutine.promise().location();
+					else
+						m_location = nullptr;
+				}
+
+				void start() noexcept
+				{
+					m_start = chrono::steady_clock::now();
+					m_started = true;
+				}
+
+				// The awaiter did not suspend after all
+				void discard() noexcept
+				{
+					m_started = false;
+				}
+
+				// Records the wait if it suspended, the awaiting task's frame still holds the location
+				void stop() noexcept
+				{
+					if (!m_started)
+						return;
+					m_started = false;
+					if (m_location == nullptr)
+						return;
+					auto elapsed = std::chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - m_start).count();
+					coroutine_stats::detail::record_wait(*m_location, static_cast<uint64_t>(elapsed));
+				}
+
+			private:
+				const std::source_location *m_location = nullptr;
+				chrono::steady_time_point m_start;
+				bool m_started = false;
+			};
+		}
+	}
+}
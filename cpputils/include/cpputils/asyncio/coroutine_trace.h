@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core/trace.h>
+#include <cpputils/asyncio/coroutine_semantics.h>
+#include <coroutine>
+#include <source_location>
+#include <type_traits>
+#include <utility>
+
+// Coroutine lifetime tracing
+// Define CPPUTILS_TRACE_COROUTINES (cmake -DCPPUTILS_TRACE_COROUTINES=ON) to have every task emit
+// trace events while a trace session is recording:
+// - an async slice per coroutine from creation to completion, named after the coroutine function
+// - a duration slice on the running thread for every resume .. suspend interval
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		namespace detail
+		{
+			inline constexpr trace::descriptor coroutine_lifetime_descriptor{"coroutine", "coroutine", nullptr, 0};
+			inline constexpr trace::descriptor coroutine_running_descriptor{"coroutine", "coroutine.run", nullptr, 0};
+
+			// Emits the lifetime events of a single coroutine
+			class coroutine_tracer
+			{
+			public:
+				coroutine_tracer(const std::source_location &location) noexcept
+					: m_name(location.function_name())
+				{
+					if (trace::enabled())
+						trace::emit(&coroutine_lifetime_descriptor, trace::event_type::async_begin, id(), m_name);
+				}
+
+				void on_resume() noexcept
+				{
+					if (trace::enabled())
+						trace::emit(&coroutine_running_descriptor, trace::event_type::begin, id(), m_name);
+				}
+
+				void on_suspend() noexcept
+				{
+					if (trace::enabled())
+						trace::emit(&coroutine_running_descriptor, trace::event_type::end, id(), m_name);
+				}
+
+				void on_complete() noexcept
+				{
+					if (trace::enabled())
+					{
+						trace::emit(&coroutine_running_descriptor, trace::event_type::end, id(), m_name);
+						trace::emit(&coroutine_lifetime_descriptor, trace::event_type::async_end, id(), m_name);
+					}
+				}
+
+			private:
+				uint64_t id() const noexcept
+				{
+					return reinterpret_cast<uintptr_t>(this);
+				}
+
+				icstring m_name;
+			};
+
+			// Wraps an awaiter so that suspending and resuming the awaiting coroutine is traced
+			// OBSERVER receives on_suspend() and on_resume(), the promise passes one that also records stats
+			template <typename AWAITER, typename OBSERVER = coroutine_tracer>
+			class traced_awaiter
+			{
+			public:
+				traced_awaiter(AWAITER &&awaiter, OBSERVER &tracer)
+					: m_awaiter(std::forward<AWAITER>(awaiter)), m_tracer(tracer)
+				{
+				}
+
+				bool await_ready()
+				{
+					return m_awaiter.await_ready();
+				}
+
+				template <typename PROMISE>
+				auto await_suspend(std::coroutine_handle<PROMISE> coroutine)
+				{
+					using result_type = decltype(m_awaiter.await_suspend(coroutine));
+
+					m_suspended = true;
+					m_tracer.on_suspend();
+					if constexpr (std::is_same_v<result_type, bool>)
+					{
+						// Not suspending after all, the coroutine keeps running
+						bool suspended = m_awaiter.await_suspend(coroutine);
+						if (!suspended)
+						{
+							m_suspended = false;
+							m_tracer.on_resume();
+						}
+						return suspended;
+					}
+					else
+					{
+						return m_awaiter.await_suspend(coroutine);
+					}
+				}
+
+				decltype(auto) await_resume()
+				{
+					if (m_suspended)
+						m_tracer.on_resume();
+					return m_awaiter.await_resume();
+				}
+
+			private:
+				AWAITER m_awaiter;
+				OBSERVER &m_tracer;
+				bool m_suspended = false;
+			};
+		}
+	}
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cpputils/asyncio/frame_allocator.h>
+#include <coroutine>
+#include <exception>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		namespace detail
+		{
+			// Eagerly started coroutine that destroys itself on completion, the body must not throw
+			// Frames come from the recycling allocator like those of task.
+			struct detached_task
+			{
+				struct promise_type : frame_allocated
+				{
+					detached_task get_return_object() noexcept { return {}; }
+					std::suspend_never initial_suspend() noexcept { return {}; }
+					std::suspend_never final_suspend() noexcept { return {}; }
+					void return_void() noexcept {}
+					void unhandled_exception() noexcept { std::terminate(); }
+				};
+			};
+		}
+	}
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core.h>
+#include <cpputils/asyncio/async_generator.h>
+#include <cpputils/asyncio/io_context.h>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+#if defined(__linux__)
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		namespace detail
+		{
+			struct file_handle;
+		}
+
+		struct file_reader_options
+		{
+			// Size of every buffer, rounded up to the block size
+			size_t buffer_size = 1 << 20;
+
+			// Reads kept in flight, at least two
+			uint32_t buffer_count = 2;
+
+			// Opens the file with O_DIRECT, the page cache is used when the filesystem refuses it
+			bool direct = false;
+		};
+
+		/// \brief
+		/// Reads a file front to back through a few large aligned buffers kept in flight on an io_context.
+		///
+		/// Every generator reads the file from its start. buffer_count reads are issued up front and a
+		/// buffer gets its next read as soon as the consumer moved past it, so parsing one buffer
+		/// overlaps with the disk filling the others. Records are views into the buffers, valid until
+		/// the iterator is incremented, only a record straddling two buffers is copied. Iterate on the
+		/// io_context's thread:
+		///
+		///   auto lines = reader.lines();
+		///   for (auto it = co_await lines.begin(); it != lines.end(); co_await ++it)
+		///
+		/// The kernel is told the file is read sequentially and, unless direct, to prefetch the
+		/// window past the reads in flight. Reads still in flight when a generator is dropped finish
+		/// in the background, the io_context must keep running until they did.
+		///
+		/// The overlap needs the io_uring backend. epoll reports regular files as always ready, so on
+		/// that backend every read is a blocking pread on the io_context's thread and parsing waits
+		/// for the disk, only the prefetch hints still help.
+		class CPPUTILS_API async_file_reader
+		{
+		public:
+			// Alignment of the buffers, their size and the read offsets, enough for O_DIRECT
+			static constexpr size_t block_size = 4096;
+
+			// Throws std::system_error if the file cannot be opened
+			async_file_reader(io_context &context, const string &path, file_reader_options options = {});
+
+			async_file_reader(const async_file_reader &) = delete;
+			async_file_reader &operator=(const async_file_reader &) = delete;
+
+			// Size of the file when it was opened
+			uint64_t size() const noexcept;
+
+			// Whether the file is read with O_DIRECT
+			bool direct() const noexcept;
+
+			// Raw contents, one view per filled buffer
+			async_generator<std::string_view> chunks();
+
+			// Lines without their '\n', a last line without one is yielded too
+			async_generator<std::string_view> lines();
+
+			// Records of length bytes, throws std::runtime_error if the file ends inside one
+			// and std::invalid_argument from begin() when length is 0.
+			async_generator<std::string_view> fixed_records(size_t length);
+
+			// Records preceded by their length as an unsigned integer of prefix_bytes bytes (1, 2, 4 or 8)
+			// Throws std::invalid_argument for another prefix size, std::runtime_error if the file ends
+			// inside a record.
+			async_generator<std::string_view> length_prefixed(uint32_t prefix_bytes = 4, std::endian order = std::endian::little);
+
+		private:
+			async_generator<std::string_view> length_prefixed_records(uint32_t prefix_bytes, std::endian order);
+
+			io_context &m_context;
+			file_reader_options m_options;
+			std::shared_ptr<detail::file_handle> m_file;
+		};
+	}
+}
+#endif
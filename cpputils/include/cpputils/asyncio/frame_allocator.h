@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		namespace detail
+		{
+			// Called with the frame and the size the compiler asked for to release a frame
+			using frame_deallocator = void (*)(void *frame, size_t size);
+
+			// Every frame ends with a frame_deallocator slot, null for frames of the recycling allocator
+			inline constexpr size_t frame_trailer_offset(size_t size) noexcept
+			{
+				return (size + alignof(frame_deallocator) - 1) & ~(alignof(frame_deallocator) - 1);
+			}
+
+			// Per thread free lists of coroutine frames by size class
+			// Frames up to size_classes * granularity bytes are recycled, a frame freed on another thread
+			// than the one that allocated it joins the freeing thread's lists. Each class keeps at most
+			// max_cached frames, the rest go back to the global allocator.
+			struct frame_cache
+			{
+				static constexpr size_t granularity = 64;
+				static constexpr size_t size_classes = 32;
+				static constexpr uint32_t max_cached = 256;
+
+				struct free_block
+				{
+					free_block *m_next;
+				};
+
+				free_block *m_free[size_classes] = {};
+				uint32_t m_count[size_classes] = {};
+
+				~frame_cache()
+				{
+					for (size_t i = 0; i < size_classes; i++)
+					{
+						while (free_block *block = m_free[i])
+						{
+							m_free[i] = block->m_next;
+							::operator delete(block, (i + 1) * granularity);
+						}
+					}
+				}
+			};
+
+			inline thread_local frame_cache t_frameCache;
+
+			inline void *allocate_frame(size_t size)
+			{
+				const size_t total = frame_trailer_offset(size) + sizeof(frame_deallocator);
+				void *frame;
+#if defined(CPPUTILS_NO_COROUTINE_FRAME_POOL)
+				frame = ::operator new(total);
+#else
+				const size_t sizeClass = (total - 1) / frame_cache::granularity;
+				if (sizeClass < frame_cache::size_classes)
+				{
+					frame_cache &cache = t_frameCache;
+					if (frame_cache::free_block *block = cache.m_free[sizeClass])
+					{
+						cache.m_free[sizeClass] = block->m_next;
+						cache.m_count[sizeClass]--;
+						frame = block;
+					}
+					else
+					{
+						frame = ::operator new((sizeClass + 1) * frame_cache::granularity);
+					}
+				}
+				else
+				{
+					frame = ::operator new(total);
+				}
+#endif
+				::new (static_cast<char *>(frame) + frame_trailer_offset(size)) frame_deallocator(nullptr);
+				return frame;
+			}
+
+			inline void deallocate_frame(void *frame, size_t size) noexcept
+			{
+				frame_deallocator deallocator = *reinterpret_cast<frame_deallocator *>(static_cast<char *>(frame) + frame_trailer_offset(size));
+				if (deallocator != nullptr)
+				{
+					deallocator(frame, size);
+					return;
+				}
+
+				const size_t total = frame_trailer_offset(size) + sizeof(frame_deallocator);
+#if defined(CPPUTILS_NO_COROUTINE_FRAME_POOL)
+				::operator delete(frame, total);
+#else
+				const size_t sizeClass = (total - 1) / frame_cache::granularity;
+				if (sizeClass >= frame_cache::size_classes)
+				{
+					::operator delete(frame, total);
+					return;
+				}
+
+				frame_cache &cache = t_frameCache;
+				if (cache.m_count[sizeClass] >= frame_cache::max_cached)
+				{
+					::operator delete(frame, (sizeClass + 1) * frame_cache::granularity);
+					return;
+				}
+
+				auto *block = static_cast<frame_cache::free_block *>(frame);
+				block->m_next = cache.m_free[sizeClass];
+				cache.m_free[sizeClass] = block;
+				cache.m_count[sizeClass]++;
+#endif
+			}
+
+			// Frame layout with a user allocator: frame, deallocator slot, then the allocator itself
+			template <typename ALLOCATOR>
+			struct allocator_frame_layout
+			{
+				static constexpr size_t allocator_offset(size_t size) noexcept
+				{
+					size_t end = frame_trailer_offset(size) + sizeof(frame_deallocator);
+					return (end + alignof(ALLOCATOR) - 1) & ~(alignof(ALLOCATOR) - 1);
+				}
+
+				static constexpr size_t total(size_t size) noexcept
+				{
+					return allocator_offset(size) + sizeof(ALLOCATOR);
+				}
+			};
+
+			template <typename ALLOCATOR>
+			void deallocate_frame_with(void *frame, size_t size)
+			{
+				using layout = allocator_frame_layout<ALLOCATOR>;
+				ALLOCATOR *stored = std::launder(reinterpret_cast<ALLOCATOR *>(static_cast<char *>(frame) + layout::allocator_offset(size)));
+				ALLOCATOR allocator(std::move(*stored));
+				stored->~ALLOCATOR();
+				std::allocator_traits<ALLOCATOR>::deallocate(allocator, static_cast<std::byte *>(frame), layout::total(size));
+			}
+
+			template <typename ALLOCATOR>
+			void *allocate_frame_with(const ALLOCATOR &userAllocator, size_t size)
+			{
+				using byte_allocator = typename std::allocator_traits<ALLOCATOR>::template rebind_alloc<std::byte>;
+				using layout = allocator_frame_layout<byte_allocator>;
+
+				byte_allocator allocator(userAllocator);
+				std::byte *frame = std::allocator_traits<byte_allocator>::allocate(allocator, layout::total(size));
+				::new (frame + layout::allocator_offset(size)) byte_allocator(std::move(allocator));
+				::new (frame + frame_trailer_offset(size)) frame_deallocator(&deallocate_frame_with<byte_allocator>);
+				return frame;
+			}
+
+			// Base of promise types whose frames come from the recycling allocator
+			// A coroutine taking std::allocator_arg_t followed by an allocator, as its first parameters or
+			// right after the object parameter of a member function, gets its frame from that allocator.
+			class frame_allocated
+			{
+			public:
+				static void *operator new(size_t size)
+				{
+					return allocate_frame(size);
+				}
+
+				template <typename ALLOCATOR, typename... ARGS>
+				static void *operator new(size_t size, std::allocator_arg_t, const ALLOCATOR &allocator, const ARGS &...)
+				{
+					return allocate_frame_with(allocator, size);
+				}
+
+				template <typename OBJECT, typename ALLOCATOR, typename... ARGS>
+				static void *operator new(size_t size, const OBJECT &, std::allocator_arg_t, const ALLOCATOR &allocator, const ARGS &...)
+				{
+					return allocate_frame_with(allocator, size);
+				}
+
+				static void operator delete(void *frame, size_t size) noexcept
+				{
+					deallocate_frame(frame, size);
+				}
+
+				// Matching placement forms, so every operator new above has its operator delete
+				// Coroutine frames are always freed through the sized form, the only one that can find the
+				// trailer, these only keep a new-expression on a promise from compiling.
+				template <typename ALLOCATOR, typename... ARGS>
+				static void operator delete(void *frame, std::allocator_arg_t, const ALLOCATOR &, const ARGS &...) noexcept = delete;
+
+				template <typename OBJECT, typename ALLOCATOR, typename... ARGS>
+				static void operator delete(void *frame, const OBJECT &, std::allocator_arg_t, const ALLOCATOR &, const ARGS &...) noexcept = delete;
+			};
+		}
+	}
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cpputils/asyncio/adaptors.h>
+#include <cpputils/asyncio/frame_allocator.h>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <ranges>
+#include <type_traits>
+#include <utility>
+
+// source: https://github.com/lewissbaker/cppcoro/blob/master/include/cppcoro/generator.hpp
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		template <typename T>
+		class generator;
+
+		namespace detail
+		{
+			template <typename T>
+			class generator_promise : public frame_allocated
+			{
+			public:
+				using value_type = std::remove_reference_t<T>;
+				using reference_type = std::conditional_t<std::is_reference_v<T>, T, T &>;
+				using pointer_type = value_type *;
+
+				generator_promise() = default;
+
+				generator<T> get_return_object() noexcept;
+
+				std::suspend_always initial_suspend() const noexcept { return {}; }
+				std::suspend_always final_suspend() const noexcept { return {}; }
+
+				// Yielded values are referenced, not copied, a temporary lives until the generator resumes
+				std::suspend_always yield_value(std::remove_reference_t<T> &value) noexcept
+				{
+					m_value = std::addressof(value);
+					return {};
+				}
+
+				std::suspend_always yield_value(std::remove_reference_t<T> &&value) noexcept
+				{
+					m_value = std::addressof(value);
+					return {};
+				}
+
+				void unhandled_exception()
+				{
+					m_exception = std::current_exception();
+				}
+
+				void return_void() noexcept {}
+
+				reference_type value() const noexcept
+				{
+					return static_cast<reference_type>(*m_value);
+				}
+
+				// Don't allow any use of 'co_await' inside the generator coroutine.
+				template <typename U>
+				std::suspend_never await_transform(U &&value) = delete;
+
+				void rethrow_if_exception()
+				{
+					if (m_exception)
+						std::rethrow_exception(m_exception);
+				}
+
+			private:
+				pointer_type m_value = nullptr;
+				std::exception_ptr m_exception;
+			};
+
+			template <typename T>
+			class generator_iterator
+			{
+				using coroutine_handle = std::coroutine_handle<generator_promise<T>>;
+
+			public:
+				using iterator_category = std::input_iterator_tag;
+				using iterator_concept = std::input_iterator_tag;
+				using difference_type = std::ptrdiff_t;
+				using value_type = typename generator_promise<T>::value_type;
+				using reference = typename generator_promise<T>::reference_type;
+				using pointer = typename generator_promise<T>::pointer_type;
+
+				generator_iterator() noexcept = default;
+
+				explicit generator_iterator(coroutine_handle coroutine) noexcept : m_coroutine(coroutine) {}
+
+				friend bool operator==(const generator_iterator &it, std::default_sentinel_t) noexcept
+				{
+					return !it.m_coroutine || it.m_coroutine.done();
+				}
+
+				generator_iterator &operator++()
+				{
+					m_coroutine.resume();
+					if (m_coroutine.done())
+						m_coroutine.promise().rethrow_if_exception();
+					return *this;
+				}
+
+				void operator++(int)
+				{
+					++*this;
+				}
+
+				reference operator*() const noexcept
+				{
+					return m_coroutine.promise().value();
+				}
+
+				pointer operator->() const noexcept
+				{
+					return std::addressof(operator*());
+				}
+
+			private:
+				coroutine_handle m_coroutine = nullptr;
+			};
+		}
+
+		/// \brief
+		/// Lazy synchronous sequence produced by a coroutine with co_yield.
+		///
+		/// The body runs up to the next co_yield on every increment. Yielded values are handed out by
+		/// reference, so iterating never copies them. A generator is an input range and a view, it can
+		/// be iterated once and piped into std::views or the adaptors of adaptors.h.
+		template <typename T>
+		class [[nodiscard]] generator : public std::ranges::view_base
+		{
+		public:
+			using promise_type = detail::generator_promise<T>;
+			using iterator = detail::generator_iterator<T>;
+
+			generator() noexcept = default;
+
+			generator(generator &&other) noexcept : m_coroutine(std::exchange(other.m_coroutine, nullptr)) {}
+
+			generator(const generator &) = delete;
+
+			generator &operator=(generator other) noexcept
+			{
+				std::swap(m_coroutine, other.m_coroutine);
+				return *this;
+			}
+
+			~generator()
+			{
+				if (m_coroutine)
+					m_coroutine.destroy();
+			}
+
+			// Runs the body to the first co_yield
+			iterator begin()
+			{
+				if (m_coroutine)
+				{
+					m_coroutine.resume();
+					if (m_coroutine.done())
+						m_coroutine.promise().rethrow_if_exception();
+				}
+				return iterator{m_coroutine};
+			}
+
+			std::default_sentinel_t end() const noexcept
+			{
+				return std::default_sentinel;
+			}
+
+		private:
+			friend class detail::generator_promise<T>;
+
+			explicit generator(std::coroutine_handle<promise_type> coroutine) noexcept : m_coroutine(coroutine) {}
+
+			std::coroutine_handle<promise_type> m_coroutine = nullptr;
+		};
+
+		namespace detail
+		{
+			template <typename T>
+			generator<T> generator_promise<T>::get_return_object() noexcept
+			{
+				return generator<T>{std::coroutine_handle<generator_promise<T>>::from_promise(*this)};
+			}
+		}
+
+		template <typename T, typename FUNC>
+		generator<std::invoke_result_t<FUNC &, typename generator<T>::iterator::reference>> operator|(generator<T> source, detail::transform_adaptor<FUNC> adaptor)
+		{
+			for (auto &&value : source)
+				co_yield std::invoke(adaptor.m_func, static_cast<decltype(value)>(value));
+		}
+
+		template <typename T, typename PREDICATE>
+		generator<T> operator|(generator<T> source, detail::filter_adaptor<PREDICATE> adaptor)
+		{
+			for (auto &&value : source)
+			{
+				if (std::invoke(adaptor.m_predicate, std::as_const(value)))
+					co_yield static_cast<decltype(value)>(value);
+			}
+		}
+
+		template <typename T>
+		generator<T> operator|(generator<T> source, detail::take_adaptor adaptor)
+		{
+			if (adaptor.m_count == 0)
+				co_return;
+
+			size_t taken = 0;
+			for (auto &&value : source)
+			{
+				co_yield static_cast<decltype(value)>(value);
+				if (++taken == adaptor.m_count)
+					break;
+			}
+		}
+	}
+}
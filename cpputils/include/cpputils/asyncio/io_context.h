@@ -0,0 +1,321 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core.h>
+#include <cpputils/asyncio/cancellation.h>
+#include <cpputils/asyncio/coroutine.h>
+#include <cpputils/asyncio/coroutine_semantics.h>
+#include <cpputils/asyncio/reset_events.h>
+#include <cpputils/asyncio/sync_wait_task.h>
+#include <atomic>
+#include <coroutine>
+#include <optional>
+
+#if defined(__linux__)
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		class io_context;
+
+		// Kind of an io_operation
+		enum class io_opcode : uint8_t
+		{
+			read,
+			write,
+			readv,
+			writev,
+			accept,
+			connect,
+			recv,
+			send
+		};
+
+		// Awaiter shared by every I/O operation, lives in the awaiting coroutine's frame
+		// The result is the byte count, the accepted descriptor or 0, negative values are -errno.
+		// A pending operation observes the given token, or the awaiting task's, and once it is
+		// cancelled the reactor withdraws it and the co_await throws operation_cancelled.
+		class CPPUTILS_API io_operation_base
+		{
+		public:
+			bool await_ready() const noexcept { return false; }
+
+			// Returns false when the operation completed without having to wait
+			template <typename PROMISE>
+			bool await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine)
+			{
+				if constexpr (std::is_base_of_v<detail::task_promise_base, PROMISE>)
+				{
+					if (!m_token.can_be_cancelled())
+						m_token = detail::cancellation_access::token(awaitingCoroutine.promise().cancellation());
+				}
+				return suspend(awaitingCoroutine);
+			}
+
+		protected:
+			io_operation_base(io_context &context, io_opcode opcode, int fd, cancellation_token &&token) noexcept
+				: m_context(context), m_opcode(opcode), m_fd(fd), m_token(std::move(token))
+			{
+			}
+
+			// Copies the arguments, operations are returned by value before they are awaited
+			io_operation_base(const io_operation_base &other) noexcept;
+
+			// Throws operation_cancelled if the operation was cancelled, std::system_error if it failed
+			int64_t get_result();
+
+		private:
+			friend class io_context;
+
+			// Progress of a cancellation, changed by the cancelling thread and the reactor
+			enum cancel_state : uint8_t
+			{
+				pending,
+				// On the context's cancel stack, a completion must wait until the reactor took it off
+				cancel_queued,
+				completed_while_queued,
+				cancel_issued,
+				completed
+			};
+
+			bool suspend(std::coroutine_handle<> awaitingCoroutine);
+
+			io_context &m_context;
+			io_opcode m_opcode;
+			int m_fd;
+
+			// Arguments, their meaning depends on the opcode
+			void *m_buffer = nullptr;
+			size_t m_length = 0;
+			int64_t m_offset = -1;
+			int m_flags = 0;
+			sockaddr *m_address = nullptr;
+			socklen_t *m_addressLength = nullptr;
+
+			int64_t m_result = 0;
+			std::coroutine_handle<> m_awaitingCoroutine;
+			io_operation_base *m_next = nullptr;
+
+			cancellation_token m_token;
+			std::optional<cancellation_registration> m_registration;
+			std::atomic<uint8_t> m_cancelState{pending};
+			io_operation_base *m_cancelNext = nullptr;
+		};
+
+		// I/O awaiter whose co_await yields RESULT
+		template <typename RESULT>
+		class io_operation : public io_operation_base
+		{
+		public:
+			io_operation(io_context &context, io_opcode opcode, int fd, cancellation_token &&token) noexcept
+				: io_operation_base(context, opcode, fd, std::move(token))
+			{
+			}
+
+			RESULT await_resume()
+			{
+				if constexpr (std::is_void_v<RESULT>)
+					get_result();
+				else
+					return static_cast<RESULT>(get_result());
+			}
+		};
+
+		// I/O reactor driving awaitable file and socket operations
+		// Uses io_uring when the kernel offers it and falls back to epoll otherwise. With io_uring
+		// operations are queued as submission entries and handed to the kernel in one batch each
+		// time the reactor polls, with epoll they are attempted directly and wait for readiness on
+		// EAGAIN, so descriptors should be non-blocking on that backend.
+		//
+		// Operations must be started on the reactor thread, the one calling run(). Coroutines on
+		// other threads get there with co_await io.schedule(). Completions resume the awaiting
+		// coroutine on the reactor thread.
+		class CPPUTILS_API io_context
+		{
+		public:
+			enum class backend
+			{
+				io_uring,
+				epoll
+			};
+
+			// Awaiter that resumes the awaiting coroutine on the reactor thread, callable from any thread
+			class schedule_operation
+			{
+			public:
+				schedule_operation(io_context &context) noexcept : m_context(context) {}
+
+				bool await_ready() const noexcept { return false; }
+
+				void await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+					m_context.schedule_impl(this);
+				}
+
+				void await_resume() const noexcept {}
+
+			private:
+				friend class io_context;
+				io_context &m_context;
+				std::coroutine_handle<> m_awaitingCoroutine;
+				schedule_operation *m_next = nullptr;
+			};
+
+			// entries is the io_uring submission queue size, force_epoll skips io_uring
+			explicit io_context(uint32_t entries = 4096, bool force_epoll = false);
+			~io_context();
+
+			io_context(const io_context &) = delete;
+			io_context &operator=(const io_context &) = delete;
+
+			backend get_backend() const noexcept
+			{
+				return m_backend;
+			}
+
+			schedule_operation schedule() noexcept
+			{
+				return schedule_operation{*this};
+			}
+
+			// Reads into buffer, at offset or at the file position when offset is negative
+			// Every operation takes an optional token cancelling it while it is pending.
+			io_operation<size_t> read(int fd, void *buffer, size_t length, int64_t offset = -1, cancellation_token token = {}) noexcept
+			{
+				io_operation<size_t> operation{*this, io_opcode::read, fd, std::move(token)};
+				operation.m_buffer = buffer;
+				operation.m_length = length;
+				operation.m_offset = offset;
+				return operation;
+			}
+
+			io_operation<size_t> write(int fd, const void *buffer, size_t length, int64_t offset = -1, cancellation_token token = {}) noexcept
+			{
+				io_operation<size_t> operation{*this, io_opcode::write, fd, std::move(token)};
+				operation.m_buffer = const_cast<void *>(buffer);
+				operation.m_length = length;
+				operation.m_offset = offset;
+				return operation;
+			}
+
+			io_operation<size_t> readv(int fd, const iovec *buffers, int count, int64_t offset = -1, cancellation_token token = {}) noexcept
+			{
+				io_operation<size_t> operation{*this, io_opcode::readv, fd, std::move(token)};
+				operation.m_buffer = const_cast<iovec *>(buffers);
+				operation.m_length = static_cast<size_t>(count);
+				operation.m_offset = offset;
+				return operation;
+			}
+
+			io_operation<size_t> writev(int fd, const iovec *buffers, int count, int64_t offset = -1, cancellation_token token = {}) noexcept
+			{
+				io_operation<size_t> operation{*this, io_opcode::writev, fd, std::move(token)};
+				operation.m_buffer = const_cast<iovec *>(buffers);
+				operation.m_length = static_cast<size_t>(count);
+				operation.m_offset = offset;
+				return operation;
+			}
+
+			// Yields the accepted descriptor, flags are accept4 flags
+			io_operation<int> accept(int fd, sockaddr *address = nullptr, socklen_t *addressLength = nullptr, int flags = 0, cancellation_token token = {}) noexcept
+			{
+				io_operation<int> operation{*this, io_opcode::accept, fd, std::move(token)};
+				operation.m_address = address;
+				operation.m_addressLength = addressLength;
+				operation.m_flags = flags;
+				return operation;
+			}
+
+			io_operation<void> connect(int fd, const sockaddr *address, socklen_t addressLength, cancellation_token token = {}) noexcept
+			{
+				io_operation<void> operation{*this, io_opcode::connect, fd, std::move(token)};
+				operation.m_address = const_cast<sockaddr *>(address);
+				operation.m_length = addressLength;
+				return operation;
+			}
+
+			io_operation<size_t> recv(int fd, void *buffer, size_t length, int flags = 0, cancellation_token token = {}) noexcept
+			{
+				io_operation<size_t> operation{*this, io_opcode::recv, fd, std::move(token)};
+				operation.m_buffer = buffer;
+				operation.m_length = length;
+				operation.m_flags = flags;
+				return operation;
+			}
+
+			io_operation<size_t> send(int fd, const void *buffer, size_t length, int flags = 0, cancellation_token token = {}) noexcept
+			{
+				io_operation<size_t> operation{*this, io_opcode::send, fd, std::move(token)};
+				operation.m_buffer = const_cast<void *>(buffer);
+				operation.m_length = length;
+				operation.m_flags = flags;
+				return operation;
+			}
+
+			// Processes completions until stop() is called
+			void run();
+
+			// Processes the completions that are ready without blocking, returns how many coroutines were resumed
+			size_t poll();
+
+			// Makes run() return, callable from any thread
+			void stop();
+
+			// Runs the awaitable to completion on the calling thread, which acts as the reactor thread
+			template <awaitable T>
+			auto run(T &&value)
+			{
+				auto task = detail::make_sync_wait_task(std::forward<T>(value));
+				manual_reset_event event;
+				task.start(event);
+				while (!event.is_set())
+					process(true);
+				return task.result();
+			}
+
+		private:
+			class uring;
+			class epoll_reactor;
+			friend class io_operation_base;
+
+			// Starts the operation, returns false if it already completed
+			bool start(io_operation_base *operation);
+			void schedule_impl(schedule_operation *operation) noexcept;
+
+			// Hands a cancelled operation to the reactor, callable from any thread
+			void cancel_impl(io_operation_base *operation) noexcept;
+
+			// Withdraws the cancelled operations and resumes those that completed meanwhile
+			void process_cancellations();
+
+			// Waits for completions when wait is set and resumes them, returns how many were resumed
+			size_t process(bool wait);
+			size_t resume_scheduled();
+			void complete(io_operation_base *operation) noexcept;
+			void wake() noexcept;
+
+			backend m_backend;
+			uref<uring> m_uring;
+			uref<epoll_reactor> m_epoll;
+
+			// eventfd the reactor blocks on together with the I/O, signalled by schedule() and stop()
+			int m_wakeFd = -1;
+
+			// Ready queue of completed operations, intrusive FIFO
+			io_operation_base *m_readyHead = nullptr;
+			io_operation_base *m_readyTail = nullptr;
+
+			// Coroutines scheduled from any thread, lock-free stack of operations
+			alignas(cache_line_size) std::atomic<schedule_operation *> m_remoteQueue{nullptr};
+			std::atomic<bool> m_stopRequested{false};
+
+			// Operations cancelled from any thread, lock-free stack through m_cancelNext
+			std::atomic<io_operation_base *> m_cancelQueue{nullptr};
+		};
+	}
+}
+#endif
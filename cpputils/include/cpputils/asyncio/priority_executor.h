@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		// Urgency of a coroutine scheduled on a priority_executor
+		enum class task_priority : uint8_t
+		{
+			high,
+			normal,
+			low,
+			background
+		};
+
+		struct priority_executor_options
+		{
+			// A coroutine of each priority is ordered as if it was due that long after it was queued
+			// The gaps bound starvation: queued work of a lower priority overtakes newer work of a
+			// higher one once it waited for the difference.
+			std::chrono::nanoseconds slack[4] = {std::chrono::nanoseconds(0), std::chrono::milliseconds(2),
+												 std::chrono::milliseconds(20), std::chrono::milliseconds(200)};
+
+			// Running time after which yield_if_needed() gives way to any queued coroutine
+			std::chrono::nanoseconds quantum = std::chrono::milliseconds(1);
+		};
+
+		// Earliest deadline first executor
+		// Every queued coroutine carries a deadline, the one given to schedule_before() or the time it
+		// was queued plus the slack of its priority, and workers always resume the earliest. Coroutines
+		// only give the thread up where they suspend: long running ones call co_await yield_if_needed()
+		// and get requeued when earlier work is waiting or their quantum ran out. The queue is a heap
+		// under a mutex, meant for request sized coroutines rather than the finest grained hops.
+		//
+		// Usage: co_await executor.schedule(task_priority::background); moves the current coroutine
+		// onto a worker thread, behind request coroutines scheduled with task_priority::high.
+		class CPPUTILS_API priority_executor
+		{
+		public:
+			using clock = std::chrono::steady_clock;
+			using time_point = clock::time_point;
+
+			// Awaiter queueing the awaiting coroutine, lives in the awaiting coroutine's frame
+			class schedule_operation
+			{
+			public:
+				schedule_operation(priority_executor *executor, task_priority priority, int64_t deadline, bool conditional) noexcept
+					: m_executor(executor), m_priority(priority), m_deadline(deadline), m_conditional(conditional)
+				{
+				}
+
+				bool await_ready() const noexcept
+				{
+					return m_conditional && (m_executor == nullptr || !m_executor->should_yield());
+				}
+
+				void await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+					m_executor->schedule_impl(this);
+				}
+
+				void await_resume() const noexcept {}
+
+			private:
+				friend class priority_executor;
+
+				priority_executor *m_executor;
+				task_priority m_priority;
+				// Nanoseconds on clock, no_deadline when derived from the priority
+				int64_t m_deadline;
+				bool m_conditional;
+				int64_t m_key = 0;
+				uint64_t m_sequence = 0;
+				std::coroutine_handle<> m_awaitingCoroutine;
+			};
+
+			static constexpr int64_t no_deadline = INT64_MAX;
+
+			// Starts thread_count workers, defaults to one per hardware thread
+			explicit priority_executor(uint32_t thread_count = std::thread::hardware_concurrency(), priority_executor_options options = {});
+
+			// Runs the remaining work then joins the workers
+			~priority_executor();
+
+			priority_executor(const priority_executor &) = delete;
+			priority_executor &operator=(const priority_executor &) = delete;
+
+			schedule_operation schedule(task_priority priority = task_priority::normal) noexcept
+			{
+				return schedule_operation{this, priority, no_deadline, false};
+			}
+
+			// Queues the awaiting coroutine to run by deadline, ahead of everything due later
+			schedule_operation schedule_before(time_point deadline) noexcept
+			{
+				// Deadlines are kept in nanoseconds whatever the clock's period
+				const auto deadlineNs = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+				return schedule_operation{this, task_priority::high, deadlineNs, false};
+			}
+
+			// Requeues the running coroutine if earlier work is queued or its quantum ran out
+			// Completes without suspending otherwise, and on threads that are not workers.
+			schedule_operation yield_if_needed() noexcept
+			{
+				return schedule_operation{is_worker_thread() ? this : nullptr, task_priority::normal, no_deadline, true};
+			}
+
+			uint32_t thread_count() const noexcept
+			{
+				return m_threadCount;
+			}
+
+			// Coroutines waiting for a worker
+			size_t queued() const noexcept
+			{
+				return m_queued.load(std::memory_order_relaxed);
+			}
+
+			// Is the calling thread one of this executor's workers
+			bool is_worker_thread() const noexcept;
+
+			// Executor whose worker the calling thread is, nullptr elsewhere
+			static priority_executor *current() noexcept;
+
+			// Asks the workers to exit once the queue is empty, the destructor calls it
+			void shutdown();
+
+		private:
+			bool should_yield() const noexcept;
+			void schedule_impl(schedule_operation *operation) noexcept;
+			void run_worker();
+
+			// Heap order, the earliest key first and FIFO among equal keys
+			static bool later(const schedule_operation *a, const schedule_operation *b) noexcept
+			{
+				return a->m_key != b->m_key ? a->m_key > b->m_key : a->m_sequence > b->m_sequence;
+			}
+
+			uint32_t m_threadCount;
+			priority_executor_options m_options;
+			array_list<std::thread> m_threads;
+
+			std::mutex m_mutex;
+			std::condition_variable m_condition;
+			array_list<schedule_operation *> m_heap;
+			uint64_t m_nextSequence = 0;
+			uint32_t m_sleepingCount = 0;
+			bool m_stopRequested = false;
+
+			// Published for yield_if_needed(), which reads them without the lock
+			alignas(cache_line_size) std::atomic<size_t> m_queued{0};
+			std::atomic<int64_t> m_earliestKey{no_deadline};
+		};
+
+		// Preemption point for long running coroutines on a priority_executor
+		// Does nothing outside of the executor's workers.
+		inline priority_executor::schedule_operation yield_if_needed() noexcept
+		{
+			priority_executor *executor = priority_executor::current();
+			return executor != nullptr ? executor->yield_if_needed() : priority_executor::schedule_operation{nullptr, task_priority::normal, priority_executor::no_deadline, true};
+		}
+	}
+}
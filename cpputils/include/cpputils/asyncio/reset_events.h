@@ -2,28 +2,62 @@
 
 #include <cpputils/cpputils_api.h>
 #include <cpputils/core.h>
+#include <cpputils/asyncio/coroutine_semantics.h>
+#include <cpputils/asyncio/coroutine_stats.h>
+#include <cpputils/asyncio/detached_task.h>
+#include <cpputils/asyncio/cancellation.h>
+#include <algorithm>
 #include <coroutine>
+#include <cstddef>
+#include <cstdint>
 #include <atomic>
 #include <mutex>
 #include <condition_variable>
+#include <optional>
+#include <thread>
+#include <type_traits>
 
 namespace cpputils
 {
 	namespace asyncio
 	{
+		namespace detail
+		{
+			class task_promise_base;
+		}
+
 		// Events stuff
 
 		// Manual reset event
+		// Blocks on the state word itself (a futex on Linux) after a short spin. set() and wait() only
+		// enter the kernel when a thread actually sleeps, timed waiters use the condition variable.
 		class manual_reset_event
 		{
 		private:
+			static constexpr uint32_t set_flag = 1;
+			static constexpr uint32_t waiting_flag = 2;
+			static constexpr uint32_t timed_waiting_flag = 4;
+			static constexpr int spin_rounds = 64;
+
+			std::atomic<uint32_t> m_state;
 			std::mutex m_mutex;
 			std::condition_variable m_cv;
-			std::atomic<bool> m_isSet;
+
+			bool spin_until_set() const noexcept
+			{
+				for (int round = 0; round < spin_rounds; round++)
+				{
+					if (is_set())
+						return true;
+					if (round >= spin_rounds / 2)
+						std::this_thread::yield();
+				}
+				return false;
+			}
 
 		public:
 			manual_reset_event(bool initiallySet = false) noexcept
-				: m_isSet(initiallySet)
+				: m_state(initiallySet ? set_flag : 0)
 			{
 			}
 
@@ -34,30 +68,60 @@ namespace cpputils
 
 			void set() noexcept
 			{
-				std::lock_guard<std::mutex> lock(m_mutex);
-				m_isSet = true;
-				m_cv.notify_all();
+				const uint32_t oldState = m_state.fetch_or(set_flag, std::memory_order_acq_rel);
+				if (oldState & waiting_flag)
+					m_state.notify_all();
+				if (oldState & timed_waiting_flag)
+				{
+					// Timed waiters check the state under the mutex, taking it orders the notify after their check
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_cv.notify_all();
+				}
 			}
 			void reset() noexcept
 			{
-				std::lock_guard<std::mutex> lock(m_mutex);
-				m_isSet = false;
+				// The waiting flags stay, threads may still sleep in wait() and the next set() must wake them
+				m_state.fetch_and(~set_flag, std::memory_order_relaxed);
 			}
 
 			void wait() noexcept
 			{
-				std::unique_lock<std::mutex> lock(m_mutex);
-				m_cv.wait(lock, [this]
-						  { return m_isSet == true; });
+				if (is_set() || spin_until_set())
+					return;
+
+				uint32_t state = m_state.load(std::memory_order_acquire);
+				while (!(state & set_flag))
+				{
+					if (!(state & waiting_flag) && !m_state.compare_exchange_weak(state, state | waiting_flag, std::memory_order_acquire))
+						continue;
+					m_state.wait(state | waiting_flag, std::memory_order_acquire);
+					state = m_state.load(std::memory_order_acquire);
+				}
 			}
 			bool wait_for(std::chrono::nanoseconds timeout) noexcept
 			{
+				if (is_set() || spin_until_set())
+					return true;
+
 				std::unique_lock<std::mutex> lock(m_mutex);
+				if (m_state.fetch_or(timed_waiting_flag, std::memory_order_acq_rel) & set_flag)
+					return true;
 				return m_cv.wait_for(lock, timeout, [this]
-									 { return m_isSet == true; });
+									 { return is_set(); });
+			}
+			bool is_set() const noexcept
+			{
+				return (m_state.load(std::memory_order_acquire) & set_flag) != 0;
 			}
 		};
 
+		/// \brief
+		/// Event resuming every awaiting coroutine once set, until reset.
+		///
+		/// A waiting task whose cancellation token can be cancelled leaves the event as soon as the
+		/// token is cancelled and throws operation_cancelled, resuming on the cancelling thread. Those
+		/// waiters sit on a separate list under a mutex so they can unlink themselves, the others keep
+		/// the lock-free list.
 		class async_manual_reset_event
 		{
 		public:
@@ -77,18 +141,57 @@ namespace cpputils
 					: m_event(event)
 				{
 				}
+
+				// Copied before it is awaited, the traced builds move it into their wrapper
+				awaiter(const awaiter &other) noexcept
+					: m_event(other.m_event)
+				{
+				}
 				bool await_ready() const noexcept
 				{
 					return m_event.is_set();
 				}
-				bool await_suspend(
-					std::coroutine_handle<> awaitingCoroutine) noexcept
+				template <typename PROMISE>
+				bool await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine)
+				{
+#if defined(CPPUTILS_COROUTINE_STATS)
+					m_waitStats.charge_to(awaitingCoroutine);
+#endif
+					if constexpr (std::is_base_of_v<detail::task_promise_base, PROMISE>)
+					{
+						detail::cancellation_state *cancellation = awaitingCoroutine.promise().cancellation();
+						if (cancellation != nullptr && cancellation->can_be_cancelled())
+							return suspend_cancellable(awaitingCoroutine, detail::cancellation_access::token(cancellation));
+					}
+					return suspend(awaitingCoroutine);
+				}
+				void await_resume()
+				{
+#if defined(CPPUTILS_COROUTINE_STATS)
+					m_waitStats.stop();
+#endif
+					if (m_registration)
+					{
+						// Waits for a callback still running on another thread
+						m_registration.reset();
+						if (m_cancelled)
+							throw operation_cancelled{};
+					}
+				}
+
+			private:
+				friend class async_manual_reset_event;
+
+				bool suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
 				{
 					// Special m_state value that indicates the event is in the 'set' state.
 					const void *const setState = &m_event;
 
 					// Remember the handle of the awaiting coroutine.
 					m_awaitingCoroutine = awaitingCoroutine;
+#if defined(CPPUTILS_COROUTINE_STATS)
+					m_waitStats.start();
+#endif
 
 					// Try to atomically push this awaiter onto the front of the list.
 					void *oldValue = m_event.m_state.load(std::memory_order_acquire);
@@ -96,7 +199,12 @@ namespace cpputils
 					{
 						// Resume immediately if already in 'set' state.
 						if (oldValue == setState)
+						{
+#if defined(CPPUTILS_COROUTINE_STATS)
+							m_waitStats.discard();
+#endif
 							return false;
+						}
 
 						// Update linked list to point at current head.
 						m_next = static_cast<awaiter *>(oldValue);
@@ -112,13 +220,82 @@ namespace cpputils
 					// Successfully enqueued. Remain suspended.
 					return true;
 				}
-				void await_resume() noexcept {}
 
-			private:
-				friend class async_manual_reset_event;
+				// set() and the cancellation each release the latch once they took the awaiter off the
+				// list, the awaiter releases it once registered, the last one resumes
+				bool suspend_cancellable(std::coroutine_handle<> awaitingCoroutine, cancellation_token token)
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+					m_cancellable = true;
+#if defined(CPPUTILS_COROUTINE_STATS)
+					m_waitStats.start();
+#endif
+
+					// Linked before looking at the state, set() looks at the list after changing it
+					{
+						std::lock_guard<std::mutex> lock(m_event.m_mutex);
+						m_event.link(this);
+					}
+					if (m_event.m_state.load(std::memory_order_seq_cst) == &m_event)
+					{
+						std::lock_guard<std::mutex> lock(m_event.m_mutex);
+						if (m_linked)
+						{
+							m_event.unlink(this);
+#if defined(CPPUTILS_COROUTINE_STATS)
+							m_waitStats.discard();
+#endif
+							return false;
+						}
+					}
+
+					m_registration.emplace(std::move(token), [this]
+					{
+						bool unlinked;
+						{
+							std::lock_guard<std::mutex> lock(m_event.m_mutex);
+							unlinked = m_linked;
+							if (unlinked)
+								m_event.unlink(this);
+						}
+						if (unlinked)
+						{
+							m_cancelled = true;
+							complete();
+						}
+					});
+					return m_latch.fetch_sub(1, std::memory_order_acq_rel) != 1;
+				}
+
+				void complete() noexcept
+				{
+					if (m_latch.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						m_awaitingCoroutine.resume();
+				}
+
+				// Called by set() once the awaiter is off the list
+				void wake() noexcept
+				{
+					if (m_cancellable)
+						complete();
+					else
+						m_awaitingCoroutine.resume();
+				}
+
 				const async_manual_reset_event &m_event;
 				std::coroutine_handle<> m_awaitingCoroutine;
 				awaiter *m_next;
+#if defined(CPPUTILS_COROUTINE_STATS)
+				detail::wait_stats_recorder m_waitStats;
+#endif
+
+				// Cancellable waits only, the list fields are guarded by the event's mutex
+				awaiter *m_prev = nullptr;
+				bool m_linked = false;
+				bool m_cancellable = false;
+				bool m_cancelled = false;
+				std::atomic<int> m_latch{2};
+				std::optional<cancellation_registration> m_registration;
 			};
 
 			awaiter operator co_await() const noexcept
@@ -132,23 +309,48 @@ namespace cpputils
 				// visibility of our prior writes.
 				// Needs to be 'acquire' so that we have visibility of prior
 				// writes by awaiting coroutines.
-				void *oldValue = m_state.exchange(this, std::memory_order_acq_rel);
+				void *oldValue = m_state.exchange(this, std::memory_order_seq_cst);
 				if (oldValue != this)
 				{
 					// Wasn't already in 'set' state.
 					// Treat old value as head of a linked-list of waiters
 					// which we have now acquired and need to resume.
-					auto *waiters = static_cast<awaiter *>(oldValue);
+					auto *waiters = take_waiters(static_cast<awaiter *>(oldValue));
 					while (waiters != nullptr)
 					{
 						// Read m_next before resuming the coroutine as resuming
 						// the coroutine will likely destroy the awaiter object.
 						auto *next = waiters->m_next;
-						waiters->m_awaitingCoroutine.resume();
+						waiters->wake();
 						waiters = next;
 					}
 				}
 			}
+			// Waiters handed to one executor task by set(executor)
+			static constexpr size_t default_batch_size = 64;
+
+			// Posts the waiters to executor in batches of batchSize instead of resuming them inline
+			// The setter only walks the list, the batches run in parallel on the executor's threads.
+			template <scheduler EXECUTOR>
+			void set(EXECUTOR &executor, size_t batchSize = default_batch_size)
+			{
+				void *oldValue = m_state.exchange(this, std::memory_order_seq_cst);
+				if (oldValue == this)
+					return;
+
+				auto *waiters = take_waiters(static_cast<awaiter *>(oldValue));
+				while (waiters != nullptr)
+				{
+					// Cut the batch off the list before posting it, its awaiters may be gone right after
+					awaiter *batch = waiters;
+					for (size_t i = 1; i < batchSize && waiters->m_next != nullptr; i++)
+						waiters = waiters->m_next;
+					awaiter *next = waiters->m_next;
+					waiters->m_next = nullptr;
+					resume_batch(executor, batch);
+					waiters = next;
+				}
+			}
 			void reset() noexcept
 			{
 				void *oldValue = this;
@@ -162,10 +364,417 @@ namespace cpputils
 		private:
 			friend struct awaiter;
 
+			void link(awaiter *waiter) const noexcept
+			{
+				waiter->m_prev = nullptr;
+				waiter->m_next = m_cancellable.load(std::memory_order_relaxed);
+				if (waiter->m_next != nullptr)
+					waiter->m_next->m_prev = waiter;
+				waiter->m_linked = true;
+				m_cancellable.store(waiter, std::memory_order_seq_cst);
+			}
+
+			void unlink(awaiter *waiter) const noexcept
+			{
+				if (waiter->m_prev != nullptr)
+					waiter->m_prev->m_next = waiter->m_next;
+				else
+					m_cancellable.store(waiter->m_next, std::memory_order_relaxed);
+				if (waiter->m_next != nullptr)
+					waiter->m_next->m_prev = waiter->m_prev;
+				waiter->m_linked = false;
+			}
+
+			// Appends the cancellable waiters to those taken off m_state, the lock is only taken when there are some
+			awaiter *take_waiters(awaiter *waiters) noexcept
+			{
+				if (m_cancellable.load(std::memory_order_seq_cst) == nullptr)
+					return waiters;
+
+				std::lock_guard<std::mutex> lock(m_mutex);
+				awaiter *cancellable = m_cancellable.load(std::memory_order_relaxed);
+				if (cancellable == nullptr)
+					return waiters;
+				m_cancellable.store(nullptr, std::memory_order_relaxed);
+
+				awaiter *last = cancellable;
+				for (awaiter *waiter = cancellable; waiter != nullptr; waiter = waiter->m_next)
+				{
+					waiter->m_linked = false;
+					last = waiter;
+				}
+				last->m_next = waiters;
+				return cancellable;
+			}
+
+			template <scheduler EXECUTOR>
+			static detail::detached_task resume_batch(EXECUTOR &executor, awaiter *waiters)
+			{
+				co_await executor.schedule();
+				while (waiters != nullptr)
+				{
+					auto *next = waiters->m_next;
+					waiters->wake();
+					waiters = next;
+				}
+			}
+
 			// - 'this' => set state
 			// - otherwise => not set, head of linked list of awaiter*.
 			mutable std::atomic<void *> m_state;
+
+			// Waiters of cancellable tasks, doubly linked under m_mutex
+			mutable std::atomic<awaiter *> m_cancellable{nullptr};
+			mutable std::mutex m_mutex;
+		};
+
+		namespace detail
+		{
+			// Coroutines waiting on a count of permits, the algorithm of cppcoro's async_auto_reset_event
+			// m_state packs the permits released (low 32 bits) and the waiters queued (high 32 bits).
+			// Whoever moves both counts to non zero becomes the resumer: it pairs permits with waiters,
+			// moving pushed awaiters to the FIFO list m_waiters only the resumer touches, and loops until
+			// no pair is left. Nothing blocks, a waiter is resumed on the thread that released its permit.
+			class async_permit_queue
+			{
+			public:
+				class operation
+				{
+				public:
+					operation() noexcept : m_queue(nullptr) {}
+
+					explicit operation(async_permit_queue &queue) noexcept : m_queue(&queue) {}
+
+					operation(const operation &other) noexcept : m_queue(other.m_queue) {}
+
+					bool await_ready() const noexcept
+					{
+						return m_queue == nullptr;
+					}
+
+					template <typename PROMISE>
+					bool await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine)
+					{
+#if defined(CPPUTILS_COROUTINE_STATS)
+						m_waitStats.charge_to(awaitingCoroutine);
+#endif
+						if constexpr (std::is_base_of_v<task_promise_base, PROMISE>)
+						{
+							cancellation_state *cancellation = awaitingCoroutine.promise().cancellation();
+							if (cancellation != nullptr && cancellation->can_be_cancelled())
+								return suspend_cancellable(awaitingCoroutine, cancellation_access::token(cancellation));
+						}
+						return suspend(awaitingCoroutine);
+					}
+
+					void await_resume()
+					{
+#if defined(CPPUTILS_COROUTINE_STATS)
+						m_waitStats.stop();
+#endif
+						if (m_ticket != nullptr)
+						{
+							// Waits for a callback still running on another thread
+							m_registration.reset();
+							m_ticket->release_ticket();
+							m_ticket = nullptr;
+							if (m_cancelled)
+								throw operation_cancelled{};
+						}
+					}
+
+				private:
+					friend class async_permit_queue;
+
+					static constexpr uint8_t waiting = 0;
+					static constexpr uint8_t granted = 1;
+					static constexpr uint8_t cancelled = 2;
+
+					bool suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+					{
+						m_awaitingCoroutine = awaitingCoroutine;
+#if defined(CPPUTILS_COROUTINE_STATS)
+						m_waitStats.start();
+#endif
+						m_queue->enqueue(this);
+
+						// The resumer may already have handed us a permit, the last one through resumes us
+						const bool suspended = m_references.fetch_sub(1, std::memory_order_acq_rel) != 1;
+#if defined(CPPUTILS_COROUTINE_STATS)
+						if (!suspended)
+							m_waitStats.discard();
+#endif
+						return suspended;
+					}
+
+					// A ticket, a heap allocated operation, waits in the queue instead of the awaiter
+					// Cancellation marks the ticket and resumes the awaiter, the ticket stays queued and
+					// the next resumer drops it without spending a permit. The resumer granting the ticket
+					// and the cancellation each release the awaiter's latch once they won the ticket, the
+					// awaiter releases it once registered, the last one resumes.
+					bool suspend_cancellable(std::coroutine_handle<> awaitingCoroutine, cancellation_token token)
+					{
+						m_awaitingCoroutine = awaitingCoroutine;
+#if defined(CPPUTILS_COROUTINE_STATS)
+						m_waitStats.start();
+#endif
+						m_ticket = new operation(*m_queue);
+						m_ticket->m_owner = this;
+						m_queue->enqueue(m_ticket);
+
+						m_registration.emplace(std::move(token), [this]
+						{
+							uint8_t expected = waiting;
+							if (m_ticket->m_ticketState.compare_exchange_strong(expected, cancelled, std::memory_order_acq_rel))
+							{
+								m_cancelled = true;
+								complete();
+							}
+						});
+						return m_references.fetch_sub(1, std::memory_order_acq_rel) != 1;
+					}
+
+					void complete() noexcept
+					{
+						if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+							m_awaitingCoroutine.resume();
+					}
+
+					// Ticket only, false if its awaiter was cancelled first
+					bool grant() noexcept
+					{
+						uint8_t expected = waiting;
+						return m_ticketState.compare_exchange_strong(expected, granted, std::memory_order_acq_rel);
+					}
+
+					// Ticket only, the queue and the awaiter each hold a reference
+					void release_ticket() noexcept
+					{
+						if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+							delete this;
+					}
+
+					async_permit_queue *m_queue;
+					operation *m_next = nullptr;
+					std::coroutine_handle<> m_awaitingCoroutine;
+					// The latch of a queued awaiter, the reference count of a ticket
+					std::atomic<uint32_t> m_references{2};
+#if defined(CPPUTILS_COROUTINE_STATS)
+					wait_stats_recorder m_waitStats;
+#endif
+
+					// Awaiter of a cancellable task
+					operation *m_ticket = nullptr;
+					bool m_cancelled = false;
+					std::optional<cancellation_registration> m_registration;
+
+					// Ticket
+					operation *m_owner = nullptr;
+					std::atomic<uint8_t> m_ticketState{waiting};
+				};
+
+				explicit async_permit_queue(uint32_t initialPermits) noexcept : m_state(initialPermits) {}
+
+				// Frees the tickets cancelled waiters left behind
+				~async_permit_queue()
+				{
+					for (operation *list : {m_newWaiters.load(std::memory_order_relaxed), m_waiters})
+					{
+						while (list != nullptr)
+						{
+							operation *next = list->m_next;
+							if (list->m_owner != nullptr)
+								list->release_ticket();
+							list = next;
+						}
+					}
+				}
+
+				async_permit_queue(const async_permit_queue &) = delete;
+				async_permit_queue &operator=(const async_permit_queue &) = delete;
+
+				// Takes a permit nobody waits for, if there is one
+				bool try_acquire() noexcept
+				{
+					uint64_t oldState = m_state.load(std::memory_order_relaxed);
+					while (permits(oldState) > waiters(oldState))
+					{
+						if (m_state.compare_exchange_weak(oldState, oldState - permit_increment, std::memory_order_acquire, std::memory_order_relaxed))
+							return true;
+					}
+					return false;
+				}
+
+				// Takes up to count permits nobody waits for, returns how many
+				uint32_t try_acquire_many(uint32_t count) noexcept
+				{
+					uint64_t oldState = m_state.load(std::memory_order_relaxed);
+					while (true)
+					{
+						const uint32_t taken = std::min(count, available(oldState));
+						if (taken == 0)
+							return 0;
+						if (m_state.compare_exchange_weak(oldState, oldState - taken * permit_increment, std::memory_order_acquire, std::memory_order_relaxed))
+							return taken;
+					}
+				}
+
+				operation acquire() noexcept
+				{
+					return try_acquire() ? operation{} : operation{*this};
+				}
+
+				// Adds count permits without letting the unclaimed ones exceed maxAvailable
+				void release(uint32_t count, uint32_t maxAvailable) noexcept
+				{
+					uint64_t oldState = m_state.load(std::memory_order_relaxed);
+					uint32_t released;
+					do
+					{
+						const uint32_t unclaimed = available(oldState);
+						if (unclaimed >= maxAvailable || count == 0)
+							return;
+						released = std::min(count, maxAvailable - unclaimed);
+					} while (!m_state.compare_exchange_weak(oldState, oldState + released, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+					if (permits(oldState) == 0 && waiters(oldState) != 0)
+						resume_waiters(oldState + released);
+				}
+
+				// Permits nobody waits for
+				uint32_t available() const noexcept
+				{
+					return available(m_state.load(std::memory_order_relaxed));
+				}
+
+			private:
+				static constexpr uint64_t permit_increment = 1;
+				static constexpr uint64_t waiter_increment = uint64_t(1) << 32;
+
+				static constexpr uint32_t permits(uint64_t state) noexcept { return static_cast<uint32_t>(state); }
+				static constexpr uint32_t waiters(uint64_t state) noexcept { return static_cast<uint32_t>(state >> 32); }
+
+				static constexpr uint32_t available(uint64_t state) noexcept
+				{
+					return permits(state) > waiters(state) ? permits(state) - waiters(state) : 0;
+				}
+
+				// Pushes a waiter and counts it, the caller becomes the resumer if permits are waiting
+				void enqueue(operation *waiter) noexcept
+				{
+					operation *head = m_newWaiters.load(std::memory_order_relaxed);
+					do
+					{
+						waiter->m_next = head;
+					} while (!m_newWaiters.compare_exchange_weak(head, waiter, std::memory_order_release, std::memory_order_relaxed));
+
+					const uint64_t oldState = m_state.fetch_add(waiter_increment, std::memory_order_acq_rel);
+					if (permits(oldState) != 0 && waiters(oldState) == 0)
+						resume_waiters(oldState + waiter_increment);
+				}
+
+				void resume_waiters(uint64_t state) noexcept
+				{
+					operation *toResume = nullptr;
+					operation **toResumeEnd = &toResume;
+
+					uint32_t count = std::min(permits(state), waiters(state));
+					do
+					{
+						// Tickets of cancelled waiters leave the count without taking a permit
+						uint64_t delta = 0;
+						for (uint32_t i = 0; i < count; i++)
+						{
+							if (m_waiters == nullptr)
+							{
+								// Every counted waiter was pushed before being counted, reverse them into FIFO order
+								operation *newWaiters = m_newWaiters.exchange(nullptr, std::memory_order_acquire);
+								do
+								{
+									operation *next = newWaiters->m_next;
+									newWaiters->m_next = m_waiters;
+									m_waiters = newWaiters;
+									newWaiters = next;
+								} while (newWaiters != nullptr);
+							}
+
+							operation *waiter = m_waiters;
+							m_waiters = waiter->m_next;
+							waiter->m_next = nullptr;
+							if (waiter->m_owner != nullptr && !waiter->grant())
+							{
+								waiter->release_ticket();
+								delta += waiter_increment;
+								continue;
+							}
+							*toResumeEnd = waiter;
+							toResumeEnd = &waiter->m_next;
+							delta += permit_increment + waiter_increment;
+						}
+
+						const uint64_t newState = m_state.fetch_sub(delta, std::memory_order_acq_rel) - delta;
+						count = std::min(permits(newState), waiters(newState));
+					} while (count > 0);
+
+					while (toResume != nullptr)
+					{
+						// Read m_next first, resuming the waiter may destroy it
+						operation *waiter = toResume;
+						toResume = waiter->m_next;
+						if (operation *owner = waiter->m_owner)
+						{
+							waiter->release_ticket();
+							owner->complete();
+						}
+						else if (waiter->m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						{
+							waiter->m_awaitingCoroutine.resume();
+						}
+					}
+				}
+
+				std::atomic<uint64_t> m_state;
+				std::atomic<operation *> m_newWaiters{nullptr};
+				operation *m_waiters = nullptr;
+			};
+		}
+
+		/// \brief
+		/// Event letting one awaiting coroutine through per set().
+		///
+		/// set() on an event already set does nothing, awaiting a set event resets it. Waiters are let
+		/// through in FIFO order and resumed inline by the thread calling set().
+		class async_auto_reset_event
+		{
+		public:
+			async_auto_reset_event(bool initiallySet = false) noexcept : m_queue(initiallySet ? 1 : 0) {}
+
+			async_auto_reset_event(const async_auto_reset_event &) = delete;
+			async_auto_reset_event &operator=(const async_auto_reset_event &) = delete;
+
+			detail::async_permit_queue::operation operator co_await() noexcept
+			{
+				return m_queue.acquire();
+			}
+
+			void set() noexcept
+			{
+				m_queue.release(1, 1);
+			}
+
+			void reset() noexcept
+			{
+				m_queue.try_acquire();
+			}
+
+			bool is_set() const noexcept
+			{
+				return m_queue.available() != 0;
+			}
+
+		private:
+			detail::async_permit_queue m_queue;
 		};
 
 	}
-}
\ No newline at end of file
+}
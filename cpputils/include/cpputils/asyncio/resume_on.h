@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cpputils/asyncio/coroutine.h>
+#include <cpputils/asyncio/coroutine_semantics.h>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+// source: https://github.com/lewissbaker/cppcoro/blob/master/include/cppcoro/resume_on.hpp
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		/// \brief
+		/// Awaits awaitable, then continues on executor whichever thread completed it.
+		///
+		/// Lets a waiter pick where it runs next, e.g. co_await resume_on(pool, event) moves each
+		/// coroutine woken by an inline set() onto the pool instead of running it on the setter.
+		/// Exceptions are rethrown on the executor too. awaitable is taken by reference, co_await the
+		/// returned task within the full expression that passed a temporary.
+		template <scheduler EXECUTOR, awaitable AWAITABLE>
+		auto resume_on(EXECUTOR &executor, AWAITABLE &&awaitable)
+			-> task<typename awaitable_traits<AWAITABLE>::awaiter_return_type>
+		{
+			using result_type = typename awaitable_traits<AWAITABLE>::awaiter_return_type;
+
+			std::exception_ptr exception;
+			if constexpr (std::is_void_v<result_type>)
+			{
+				try
+				{
+					co_await std::forward<AWAITABLE>(awaitable);
+				}
+				catch (...)
+				{
+					exception = std::current_exception();
+				}
+				co_await executor.schedule();
+				if (exception)
+					std::rethrow_exception(exception);
+			}
+			else
+			{
+				// References are kept as pointers, the referenced object outlives the switch
+				using stored_type = std::conditional_t<std::is_reference_v<result_type>, std::remove_reference_t<result_type> *, result_type>;
+				std::optional<stored_type> value;
+				try
+				{
+					if constexpr (std::is_reference_v<result_type>)
+						value.emplace(std::addressof(co_await std::forward<AWAITABLE>(awaitable)));
+					else
+						value.emplace(co_await std::forward<AWAITABLE>(awaitable));
+				}
+				catch (...)
+				{
+					exception = std::current_exception();
+				}
+				co_await executor.schedule();
+				if (exception)
+					std::rethrow_exception(exception);
+				if constexpr (std::is_reference_v<result_type>)
+					co_return **value;
+				else
+					co_return std::move(*value);
+			}
+		}
+	}
+}
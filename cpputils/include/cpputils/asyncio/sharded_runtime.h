@@ -0,0 +1,197 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core.h>
+#include <cpputils/asyncio/timer.h>
+#include <atomic>
+#include <chrono>
+#include <coroutine>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		// Thread per core runtime
+		// Every shard is one thread, pinned to its own core, running its own loop: a FIFO run queue
+		// only that thread touches, a timer wheel without locks and the thread local frame pools as
+		// allocator. Shards talk through one bounded single producer single consumer ring per ordered
+		// pair of shards, threads outside the runtime (and a shard whose ring is full) go through a
+		// lock-free stack. A coroutine moves to another shard only with co_await on_shard(n), tasks
+		// and events resume their awaiters inline and so stay on the shard they run on, keep their
+		// state partitioned per shard and hand work over by hopping. An idle shard sleeps until work
+		// arrives or its next timer expires.
+		//
+		// Usage: co_await on_shard(runtime, 2); continues the current coroutine on shard 2.
+		class CPPUTILS_API sharded_runtime
+		{
+		public:
+			static constexpr uint32_t no_shard = UINT32_MAX;
+
+			// Awaiter resuming the awaiting coroutine on a shard, completes inline when already there
+			class schedule_operation
+			{
+			public:
+				schedule_operation(sharded_runtime &runtime, uint32_t shard, bool requeue = false) noexcept
+					: m_runtime(runtime), m_shard(shard), m_requeue(requeue)
+				{
+				}
+
+				bool await_ready() const noexcept
+				{
+					return !m_requeue && m_runtime.current_shard() == m_shard;
+				}
+
+				void await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+					m_runtime.schedule_impl(m_shard, this);
+				}
+
+				void await_resume() const noexcept {}
+
+			private:
+				friend class sharded_runtime;
+				sharded_runtime &m_runtime;
+				uint32_t m_shard;
+				bool m_requeue;
+				std::coroutine_handle<> m_awaitingCoroutine;
+				schedule_operation *m_next = nullptr;
+			};
+
+			// Awaiter sleeping on the current shard's timer wheel, it resumes on the same shard
+			// Shard timers do not observe cancellation tokens, wrap the task with with_cancellation().
+			class timer_operation : private timer_node
+			{
+			public:
+				timer_operation(sharded_runtime &runtime, timer_service::time_point deadline) noexcept
+					: m_runtime(runtime), m_deadline(deadline)
+				{
+				}
+
+				bool await_ready() const noexcept
+				{
+					return m_deadline <= timer_service::clock::now();
+				}
+
+				void await_suspend(std::coroutine_handle<> awaitingCoroutine)
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+					m_callback = [](timer_node *node)
+					{ static_cast<timer_operation *>(node)->m_awaitingCoroutine.resume(); };
+					m_runtime.arm(this, m_deadline);
+				}
+
+				void await_resume() const noexcept {}
+
+			private:
+				sharded_runtime &m_runtime;
+				timer_service::time_point m_deadline;
+				std::coroutine_handle<> m_awaitingCoroutine;
+			};
+
+			// Starts shard_count shards, pinning shard i to cpu i when pin_threads is set
+			// Ticks of the shard timer wheels are resolution long.
+			explicit sharded_runtime(uint32_t shard_count = std::thread::hardware_concurrency(), bool pin_threads = true,
+									 timer_service::duration resolution = std::chrono::milliseconds(1));
+
+			// Runs the queued work then joins the shards, coroutines still sleeping are never resumed
+			~sharded_runtime();
+
+			sharded_runtime(const sharded_runtime &) = delete;
+			sharded_runtime &operator=(const sharded_runtime &) = delete;
+
+			// Moves the awaiting coroutine onto shard, callable from any thread
+			schedule_operation schedule(uint32_t shard) noexcept
+			{
+				return schedule_operation{*this, shard};
+			}
+
+			// Requeues the awaiting coroutine behind the work already queued on its shard
+			// Awaited outside of the runtime it moves the coroutine onto shard 0.
+			schedule_operation yield() noexcept
+			{
+				uint32_t shard = current_shard();
+				return schedule_operation{*this, shard == no_shard ? 0 : shard, true};
+			}
+
+			// Must be awaited on one of the shards, throws std::logic_error otherwise
+			timer_operation sleep_until(timer_service::time_point deadline) noexcept
+			{
+				return timer_operation{*this, deadline};
+			}
+
+			template <typename REP, typename PERIOD>
+			timer_operation sleep_for(std::chrono::duration<REP, PERIOD> delay) noexcept
+			{
+				return timer_operation{*this, timer_service::clock::now() + std::chrono::duration_cast<timer_service::duration>(delay)};
+			}
+
+			uint32_t shard_count() const noexcept
+			{
+				return m_shardCount;
+			}
+
+			// Shard of this runtime the calling thread runs, no_shard for any other thread
+			uint32_t current_shard() const noexcept;
+
+			// Runtime whose shard the calling thread runs, nullptr outside of any shard
+			static sharded_runtime *current() noexcept;
+
+			// Asks the shards to exit once every shard is idle and nothing is queued on any of them
+			// Coroutines still running may keep hopping between shards until they finish or sleep.
+			// Scheduling from outside the runtime after the shards exited is not supported, the
+			// coroutine would never resume. The destructor calls it.
+			void shutdown();
+
+		private:
+			class spsc_ring;
+			struct shard_state;
+
+			void schedule_impl(uint32_t shard, schedule_operation *operation) noexcept;
+			void arm(timer_node *node, timer_service::time_point deadline);
+			void wake(shard_state &shard) noexcept;
+			void run_shard(uint32_t index, bool pin);
+			size_t run_once(shard_state &shard);
+			bool has_work(const shard_state &shard) const noexcept;
+			bool has_queued_work(const shard_state &shard) const noexcept;
+			bool drained(shard_state &shard);
+			bool unpark(shard_state &shard);
+			uint64_t to_tick(timer_service::time_point time, bool roundUp) const noexcept;
+
+			uint32_t m_shardCount;
+			timer_service::duration m_resolution;
+			timer_service::time_point m_epoch;
+			uref<shard_state[]> m_shards;
+
+			// Ring from shard i to shard j at i * m_shardCount + j
+			uref<spsc_ring[]> m_rings;
+			array_list<std::thread> m_threads;
+			std::atomic<bool> m_stopRequested{false};
+
+			// Shards parked after shutdown(), the last one to park with nothing queued sets m_drained
+			std::mutex m_exitMutex;
+			uint32_t m_parkedShards = 0;
+			bool m_drained = false;
+		};
+
+		// Continues the awaiting coroutine on shard of runtime
+		inline sharded_runtime::schedule_operation on_shard(sharded_runtime &runtime, uint32_t shard) noexcept
+		{
+			return runtime.schedule(shard);
+		}
+
+		// Continues the awaiting coroutine on shard of the runtime it runs on
+		// Throws std::logic_error when called outside of a shard.
+		inline sharded_runtime::schedule_operation on_shard(uint32_t shard)
+		{
+			sharded_runtime *runtime = sharded_runtime::current();
+			if (runtime == nullptr)
+				throw std::logic_error("on_shard() called outside of a sharded_runtime");
+			return runtime->schedule(shard);
+		}
+	}
+}
@@ -0,0 +1,406 @@
+#pragma once
+
+#include <cpputils/asyncio/coroutine.h>
+#include <cpputils/asyncio/frame_allocator.h>
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// source: https://github.com/lewissbaker/cppcoro/blob/master/include/cppcoro/shared_task.hpp
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		template <typename T>
+		class shared_task;
+
+		namespace detail
+		{
+			struct shared_task_waiter
+			{
+				std::coroutine_handle<> m_continuation;
+				shared_task_waiter *m_next;
+			};
+
+			class shared_task_promise_base : public frame_allocated
+			{
+				friend struct final_awaiter;
+
+				struct final_awaiter
+				{
+					bool await_ready() const noexcept { return false; }
+
+					template <typename PROMISE>
+					void await_suspend(std::coroutine_handle<PROMISE> coroutine) noexcept
+					{
+						shared_task_promise_base &promise = coroutine.promise();
+
+						// Exchange operation needs to be 'release' so that subsequent awaiters have
+						// visibility of the result. Also needs to be 'acquire' so we have visibility
+						// of writes to the waiters list.
+						void *const valueReadyValue = &promise;
+						void *waiters = promise.m_waiters.exchange(valueReadyValue, std::memory_order_acq_rel);
+						if (waiters != nullptr)
+						{
+							// Read m_next before resuming, resuming the waiter may destroy it and this frame
+							auto *waiter = static_cast<shared_task_waiter *>(waiters);
+							while (waiter->m_next != nullptr)
+							{
+								auto *next = waiter->m_next;
+								waiter->m_continuation.resume();
+								waiter = next;
+							}
+							waiter->m_continuation.resume();
+						}
+					}
+
+					void await_resume() noexcept {}
+				};
+
+			public:
+				shared_task_promise_base() noexcept
+					: m_refCount(1), m_waiters(&this->m_waiters)
+				{
+				}
+
+				std::suspend_always initial_suspend() noexcept { return {}; }
+				final_awaiter final_suspend() noexcept { return {}; }
+
+				void unhandled_exception() noexcept
+				{
+					m_exception = std::current_exception();
+				}
+
+				bool is_ready() const noexcept
+				{
+					const void *const valueReadyValue = this;
+					return m_waiters.load(std::memory_order_acquire) == valueReadyValue;
+				}
+
+				void add_ref() noexcept
+				{
+					m_refCount.fetch_add(1, std::memory_order_relaxed);
+				}
+
+				// False once the last reference is gone and the frame must be destroyed
+				bool try_detach() noexcept
+				{
+					return m_refCount.fetch_sub(1, std::memory_order_acq_rel) != 1;
+				}
+
+				// Starts the coroutine on the first await, then queues the waiter
+				// Returns false if the result is already available and the waiter must not suspend.
+				bool try_await(shared_task_waiter *waiter, std::coroutine_handle<> coroutine)
+				{
+					void *const valueReadyValue = this;
+					void *const notStartedValue = &this->m_waiters;
+					constexpr void *startedNoWaitersValue = nullptr;
+
+					// Only the awaiter moving the state out of 'not started' runs the coroutine
+					void *oldWaiters = m_waiters.load(std::memory_order_acquire);
+					if (oldWaiters == notStartedValue && m_waiters.compare_exchange_strong(oldWaiters, startedNoWaitersValue, std::memory_order_relaxed))
+					{
+						coroutine.resume();
+						oldWaiters = m_waiters.load(std::memory_order_acquire);
+					}
+
+					do
+					{
+						if (oldWaiters == valueReadyValue)
+							return false;
+
+						waiter->m_next = static_cast<shared_task_waiter *>(oldWaiters);
+					} while (!m_waiters.compare_exchange_weak(
+						oldWaiters,
+						static_cast<void *>(waiter),
+						std::memory_order_release,
+						std::memory_order_acquire));
+
+					return true;
+				}
+
+			protected:
+				bool completed_with_unhandled_exception() const noexcept
+				{
+					return m_exception != nullptr;
+				}
+
+				void rethrow_if_unhandled_exception()
+				{
+					if (m_exception != nullptr)
+						std::rethrow_exception(m_exception);
+				}
+
+			private:
+				std::atomic<uint32_t> m_refCount;
+
+				// - nullptr => started, no waiters
+				// - this => result ready
+				// - &this->m_waiters => not started
+				// - otherwise => started, head of linked list of shared_task_waiter*
+				std::atomic<void *> m_waiters;
+				std::exception_ptr m_exception;
+			};
+
+			template <typename T>
+			class shared_task_promise final : public shared_task_promise_base
+			{
+			public:
+				shared_task_promise() noexcept = default;
+
+				~shared_task_promise()
+				{
+					if (this->is_ready() && !this->completed_with_unhandled_exception())
+						std::launder(reinterpret_cast<T *>(&m_valueStorage))->~T();
+				}
+
+				shared_task<T> get_return_object() noexcept;
+
+				template <
+					typename VALUE,
+					typename = std::enable_if_t<std::is_convertible_v<VALUE &&, T>>>
+				void return_value(VALUE &&value) noexcept(std::is_nothrow_constructible_v<T, VALUE &&>)
+				{
+					::new (static_cast<void *>(std::addressof(m_valueStorage))) T(std::forward<VALUE>(value));
+				}
+
+				// Every awaiter gets the same object
+				T &result()
+				{
+					this->rethrow_if_unhandled_exception();
+					return *std::launder(reinterpret_cast<T *>(&m_valueStorage));
+				}
+
+			private:
+				alignas(T) std::byte m_valueStorage[sizeof(T)];
+			};
+
+			template <>
+			class shared_task_promise<void> final : public shared_task_promise_base
+			{
+			public:
+				shared_task_promise() noexcept = default;
+
+				shared_task<void> get_return_object() noexcept;
+
+				void return_void() noexcept {}
+
+				void result()
+				{
+					this->rethrow_if_unhandled_exception();
+				}
+			};
+
+			template <typename T>
+			class shared_task_promise<T &> final : public shared_task_promise_base
+			{
+			public:
+				shared_task_promise() noexcept = default;
+
+				shared_task<T &> get_return_object() noexcept;
+
+				void return_value(T &value) noexcept
+				{
+					m_value = std::addressof(value);
+				}
+
+				T &result()
+				{
+					this->rethrow_if_unhandled_exception();
+					return *m_value;
+				}
+
+			private:
+				T *m_value = nullptr;
+			};
+		}
+
+		/// \brief
+		/// A lazily started task whose result any number of coroutines can await.
+		///
+		/// Copies share one coroutine frame, which is freed with the last copy. The first co_await
+		/// starts the coroutine inline, awaiters arriving while it runs queue on a lock-free list and are
+		/// all resumed once it completes. Later awaiters get the stored result without suspending.
+		template <typename T = void>
+		class [[nodiscard]] shared_task
+		{
+		public:
+			using promise_type = detail::shared_task_promise<T>;
+
+			using value_type = T;
+
+		private:
+			struct awaitable_base
+			{
+				std::coroutine_handle<promise_type> m_coroutine;
+				detail::shared_task_waiter m_waiter;
+
+				awaitable_base(std::coroutine_handle<promise_type> coroutine) noexcept
+					: m_coroutine(coroutine)
+				{
+				}
+
+				bool await_ready() const noexcept
+				{
+					return !m_coroutine || m_coroutine.promise().is_ready();
+				}
+
+				bool await_suspend(std::coroutine_handle<> awaiter) noexcept
+				{
+					m_waiter.m_continuation = awaiter;
+					return m_coroutine.promise().try_await(&m_waiter, m_coroutine);
+				}
+			};
+
+		public:
+			shared_task() noexcept
+				: m_coroutine(nullptr)
+			{
+			}
+
+			explicit shared_task(std::coroutine_handle<promise_type> coroutine)
+				: m_coroutine(coroutine)
+			{
+				// The promise starts with a reference count of 1, owned by this shared_task
+			}
+
+			shared_task(shared_task &&other) noexcept
+				: m_coroutine(std::exchange(other.m_coroutine, nullptr))
+			{
+			}
+
+			shared_task(const shared_task &other) noexcept
+				: m_coroutine(other.m_coroutine)
+			{
+				if (m_coroutine)
+					m_coroutine.promise().add_ref();
+			}
+
+			~shared_task()
+			{
+				destroy();
+			}
+
+			shared_task &operator=(shared_task &&other) noexcept
+			{
+				if (&other != this)
+				{
+					destroy();
+					m_coroutine = std::exchange(other.m_coroutine, nullptr);
+				}
+				return *this;
+			}
+
+			shared_task &operator=(const shared_task &other) noexcept
+			{
+				if (m_coroutine != other.m_coroutine)
+				{
+					destroy();
+					m_coroutine = other.m_coroutine;
+					if (m_coroutine)
+						m_coroutine.promise().add_ref();
+				}
+				return *this;
+			}
+
+			void swap(shared_task &other) noexcept
+			{
+				std::swap(m_coroutine, other.m_coroutine);
+			}
+
+			/// \brief
+			/// Query if the task result is complete.
+			///
+			/// Awaiting a task that is ready will not block.
+			bool is_ready() const noexcept
+			{
+				return !m_coroutine || m_coroutine.promise().is_ready();
+			}
+
+			auto operator co_await() const noexcept
+			{
+				struct awaitable : awaitable_base
+				{
+					using awaitable_base::awaitable_base;
+
+					decltype(auto) await_resume()
+					{
+						if (!this->m_coroutine)
+							throw broken_promise{};
+
+						return this->m_coroutine.promise().result();
+					}
+				};
+
+				return awaitable{m_coroutine};
+			}
+
+			/// \brief
+			/// Returns an awaitable that will await completion of the task without
+			/// attempting to retrieve the result.
+			auto when_ready() const noexcept
+			{
+				struct awaitable : awaitable_base
+				{
+					using awaitable_base::awaitable_base;
+
+					void await_resume() const noexcept {}
+				};
+
+				return awaitable{m_coroutine};
+			}
+
+			friend bool operator==(const shared_task &lhs, const shared_task &rhs) noexcept
+			{
+				return lhs.m_coroutine == rhs.m_coroutine;
+			}
+
+		private:
+			void destroy() noexcept
+			{
+				if (m_coroutine && !m_coroutine.promise().try_detach())
+					m_coroutine.destroy();
+			}
+
+			std::coroutine_handle<promise_type> m_coroutine;
+		};
+
+		namespace detail
+		{
+			template <typename T>
+			shared_task<T> shared_task_promise<T>::get_return_object() noexcept
+			{
+				return shared_task<T>{std::coroutine_handle<shared_task_promise>::from_promise(*this)};
+			}
+
+			inline shared_task<void> shared_task_promise<void>::get_return_object() noexcept
+			{
+				return shared_task<void>{std::coroutine_handle<shared_task_promise>::from_promise(*this)};
+			}
+
+			template <typename T>
+			shared_task<T &> shared_task_promise<T &>::get_return_object() noexcept
+			{
+				return shared_task<T &>{std::coroutine_handle<shared_task_promise>::from_promise(*this)};
+			}
+		}
+
+		// Shares the result of a task, which runs on the first co_await of the returned shared_task
+		template <typename T>
+		shared_task<T> make_shared_task(task<T> operation)
+		{
+			co_return co_await std::move(operation);
+		}
+
+		inline shared_task<void> make_shared_task(task<void> operation)
+		{
+			co_await std::move(operation);
+		}
+	}
+}
@@ -4,8 +4,13 @@
 #include <cpputils/core.h>
 #include <cpputils/asyncio/coroutine_semantics.h>
 #include <cpputils/asyncio/reset_events.h>
+#include <cpputils/asyncio/frame_allocator.h>
 #include <cassert>
 #include <coroutine>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
 
 // source: https://github.com/lewissbaker/cppcoro/blob/master/include/cppcoro/sync_wait.hpp
 
@@ -20,7 +25,7 @@ namespace cpputils
 			class sync_wait_task;
 
 			template <typename RESULT>
-			class sync_wait_task_promise final
+			class sync_wait_task_promise final : public frame_allocated
 			{
 				using coroutine_handle_t = std::coroutine_handle<sync_wait_task_promise<RESULT>>;
 
@@ -137,7 +142,7 @@ namespace cpputils
 			};
 
 			template <>
-			class sync_wait_task_promise<void>
+			class sync_wait_task_promise<void> : public frame_allocated
 			{
 				using coroutine_handle_t = std::coroutine_handle<sync_wait_task_promise<void>>;
 
@@ -276,30 +281,70 @@ namespace cpputils
 #else
 			template <awaitable T, typename RESULT = awaitable_traits<T>::awaiter_return_type>
 				requires(!std::is_void_v<RESULT>)
-			sync_wait_task<RESULT> make_sync_wait_task(T awaitable)
+			sync_wait_task<RESULT> make_sync_wait_task(T &&awaitable)
 			{
-				co_yield co_await awaitable;
+				co_yield co_await std::forward<T>(awaitable);
 			}
 
 			template <awaitable T, typename RESULT = awaitable_traits<T>::awaiter_return_type>
 				requires(std::is_void_v<RESULT>)
-			sync_wait_task<void> make_sync_wait_task(T awaitable)
+			sync_wait_task<void> make_sync_wait_task(T &&awaitable)
 			{
-				co_await awaitable;
+				co_await std::forward<T>(awaitable);
 			}
 #endif
 		}
 
 		template <awaitable T>
-		auto sync_wait(T& value)
+		auto sync_wait(T &&value)
 		{
-			auto task = detail::make_sync_wait(value);
+			auto task = detail::make_sync_wait_task(std::forward<T>(value));
 			manual_reset_event event;
 			task.start(event);
 			event.wait();
 			return task.result();
 		}
 
+		namespace detail
+		{
+			template <typename RESULT>
+			auto sync_wait_value(sync_wait_task<RESULT> &task)
+			{
+				if constexpr (std::is_void_v<RESULT>)
+				{
+					task.result();
+					return std::monostate{};
+				}
+				else
+				{
+					return std::decay_t<RESULT>(task.result());
+				}
+			}
+		}
+
+		/// \brief
+		/// Starts every awaitable on the calling thread, then blocks until they all completed.
+		///
+		/// Returns a tuple of their results, std::monostate standing for void. Once all of them finished,
+		/// the exception of the first awaitable that threw is rethrown.
+		template <awaitable... T>
+			requires(sizeof...(T) > 0)
+		auto sync_wait_all(T &&...values)
+		{
+			std::tuple tasks{detail::make_sync_wait_task(std::forward<T>(values))...};
+			manual_reset_event events[sizeof...(T)];
+			std::apply([&events](auto &...task)
+					   {
+						   size_t index = 0;
+						   (task.start(events[index++]), ...); },
+					   tasks);
+			for (manual_reset_event &event : events)
+				event.wait();
+			return std::apply([](auto &...task)
+							  { return std::tuple{detail::sync_wait_value(task)...}; },
+							  tasks);
+		}
+
 	} // namespace asyncio
 
 } // namespace cpputils
@@ -0,0 +1,167 @@
+#pragma once
+
+#include <cpputils/asyncio/async_semaphore.h>
+#include <cpputils/asyncio/cancellation.h>
+#include <cpputils/asyncio/coroutine.h>
+#include <cpputils/asyncio/reset_events.h>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <optional>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		/// \brief
+		/// Nursery running child tasks with at most a fixed number in flight.
+		///
+		/// co_await spawn(child) waits for a free slot, then starts the child inline and returns once
+		/// it first suspends, so a loop spawning 50k children only ever holds max_concurrency of them.
+		/// Children are counted on a single atomic and their slots go through an async_semaphore, no
+		/// lock is taken. The first child to throw cancels the group's token, which every child
+		/// observes as its ambient token, and later spawns are dropped. Cancelling the token of the
+		/// first spawner or of the joiner cancels the group the same way. co_await join() waits for
+		/// every child and rethrows that first exception, or throws operation_cancelled if only the
+		/// joiner was cancelled. A group is used once and must be joined before it is destroyed.
+		class task_group
+		{
+		public:
+			static constexpr uint32_t unbounded = async_semaphore::max_available;
+
+			explicit task_group(uint32_t maxConcurrency = unbounded) noexcept
+				: m_slots(maxConcurrency == 0 ? 1 : maxConcurrency)
+			{
+			}
+
+			task_group(const task_group &) = delete;
+			task_group &operator=(const task_group &) = delete;
+
+			// Must be co_await'ed, the child's result is dropped
+			template <typename T>
+			task<void> spawn(task<T> child)
+			{
+				co_await m_slots.acquire();
+				if (m_failed.load(std::memory_order_acquire))
+				{
+					m_slots.release();
+					co_return;
+				}
+
+				// The child observes the group's token, which follows the spawner's
+				if (!m_linked.exchange(true, std::memory_order_acq_rel))
+				{
+					cancellation_token parent = co_await get_cancellation_token();
+					if (parent.can_be_cancelled())
+						m_parent.emplace(std::move(parent), [source = m_source]
+										 { cancel_source(source); });
+				}
+
+				child.set_cancellation_token(m_token);
+				m_pending.fetch_add(1, std::memory_order_relaxed);
+				run_child(*this, std::move(child));
+			}
+
+			// Waits for every child, then rethrows the first exception one of them threw
+			task<void> join()
+			{
+				// Cancelling the joiner cancels the children but still waits for them, they use the group
+				cancellation_token joiner = co_await get_cancellation_token();
+				std::optional<cancellation_registration> registration;
+				if (joiner.can_be_cancelled())
+					registration.emplace(joiner, [source = m_source]
+										 { cancel_source(source); });
+
+				if (m_pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+					co_await children_done{m_joined};
+				registration.reset();
+				if (m_exception)
+					std::rethrow_exception(m_exception);
+				joiner.throw_if_cancellation_requested();
+			}
+
+			// Cancels the running children, spawns still go ahead
+			void cancel()
+			{
+				m_source.request_cancellation();
+			}
+
+			// Token every child observes
+			const cancellation_token &token() const noexcept
+			{
+				return m_token;
+			}
+
+			// Children spawned and not finished yet
+			size_t running() const noexcept
+			{
+				size_t pending = m_pending.load(std::memory_order_relaxed);
+				return pending > 0 ? pending - 1 : 0;
+			}
+
+		private:
+			// Waits on m_joined without observing the joiner's token
+			struct children_done
+			{
+				async_manual_reset_event::awaiter m_event;
+
+				bool await_ready() const noexcept
+				{
+					return m_event.await_ready();
+				}
+
+				bool await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					return m_event.await_suspend(awaitingCoroutine);
+				}
+
+				void await_resume()
+				{
+					m_event.await_resume();
+				}
+			};
+
+			// The children may finish inline and the group go away, the copy keeps the source alive
+			static void cancel_source(cancellation_source source)
+			{
+				source.request_cancellation();
+			}
+
+			template <typename T>
+			static detail::detached_task run_child(task_group &group, task<T> child)
+			{
+				try
+				{
+					co_await child;
+				}
+				catch (...)
+				{
+					if (!group.m_failed.exchange(true, std::memory_order_acq_rel))
+					{
+						group.m_exception = std::current_exception();
+						group.m_source.request_cancellation();
+					}
+				}
+
+				group.m_slots.release();
+				if (group.m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+					group.m_joined.set();
+			}
+
+			async_semaphore m_slots;
+			cancellation_source m_source;
+			cancellation_token m_token = m_source.token();
+			// Forwards the first spawner's cancellation to m_source, destroyed before it
+			std::atomic<bool> m_linked{false};
+			std::optional<cancellation_registration> m_parent;
+
+			// Children running plus one held by join()
+			std::atomic<size_t> m_pending{1};
+			std::atomic<bool> m_failed{false};
+			std::exception_ptr m_exception;
+			async_manual_reset_event m_joined;
+		};
+	}
+}
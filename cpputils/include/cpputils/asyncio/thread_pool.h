@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core.h>
+#include <atomic>
+#include <coroutine>
+#include <thread>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		// Work stealing thread pool executor
+		// Each worker owns a Chase-Lev deque: coroutines scheduled from a worker are pushed onto its
+		// own deque, idle workers steal from the top of a random victim's deque. Coroutines scheduled
+		// from outside the pool go through a lock-free intrusive stack that workers drain in FIFO order.
+		// Idle workers park on an atomic wait (a futex on Linux) and are only woken when work arrives.
+		//
+		// Usage: co_await pool.schedule(); moves the current coroutine onto a worker thread.
+		class CPPUTILS_API thread_pool
+		{
+		public:
+			// Awaiter returned by schedule(), lives in the awaiting coroutine's frame
+			class schedule_operation
+			{
+			public:
+				schedule_operation(thread_pool &pool) noexcept : m_pool(pool) {}
+
+				bool await_ready() const noexcept { return false; }
+
+				void await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+					m_pool.schedule_impl(this);
+				}
+
+				void await_resume() const noexcept {}
+
+			private:
+				friend class thread_pool;
+				thread_pool &m_pool;
+				std::coroutine_handle<> m_awaitingCoroutine;
+				schedule_operation *m_next = nullptr;
+			};
+
+			// Starts thread_count workers, defaults to one per hardware thread
+			explicit thread_pool(uint32_t thread_count = std::thread::hardware_concurrency());
+
+			// Runs the remaining work then joins the workers
+			~thread_pool();
+
+			thread_pool(const thread_pool &) = delete;
+			thread_pool &operator=(const thread_pool &) = delete;
+
+			schedule_operation schedule() noexcept
+			{
+				return schedule_operation{*this};
+			}
+
+			uint32_t thread_count() const noexcept
+			{
+				return m_threadCount;
+			}
+
+			// Is the calling thread one of this pool's workers
+			bool is_worker_thread() const noexcept;
+
+			// Asks the workers to exit once the queues are empty, the destructor calls it
+			void shutdown();
+
+		private:
+			class local_deque;
+			struct worker_state;
+
+			void schedule_impl(schedule_operation *operation) noexcept;
+			void run_worker(uint32_t index);
+			schedule_operation *try_get_work(worker_state &state) noexcept;
+			schedule_operation *try_steal(worker_state &state) noexcept;
+			bool has_any_work() const noexcept;
+			void wake_one_worker() noexcept;
+
+			uint32_t m_threadCount;
+			uref<worker_state[]> m_workers;
+			array_list<std::thread> m_threads;
+
+			// Work scheduled from outside the pool, lock-free stack of operations
+			alignas(cache_line_size) std::atomic<schedule_operation *> m_remoteQueue{nullptr};
+
+			// Parking: workers wait on the epoch, schedulers bump it when somebody sleeps
+			alignas(cache_line_size) std::atomic<uint32_t> m_sleepingCount{0};
+			std::atomic<uint32_t> m_wakeEpoch{0};
+			std::atomic<bool> m_stopRequested{false};
+		};
+	}
+}
@@ -0,0 +1,368 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core.h>
+#include <cpputils/asyncio/cancellation.h>
+#include <cpputils/asyncio/coroutine.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		// Entry of a timer_wheel, intrusive so arming and cancelling never allocate
+		struct timer_node
+		{
+			// Called once the deadline passed, outside of any lock
+			void (*m_callback)(timer_node *) = nullptr;
+
+			// Private to the wheel
+			uint64_t m_deadline = 0;
+			timer_node *m_prev = nullptr;
+			timer_node *m_next = nullptr;
+			int32_t m_list = -1;
+		};
+
+		// Hierarchical timing wheel counting in ticks
+		// Six levels of 64 slots, level l spans 64^l ticks per slot. A timer goes into the level of the
+		// highest base 64 digit in which its deadline differs from the current tick and moves down a level
+		// whenever the current tick reaches its slot, so insert and cancel are O(1) and advancing only
+		// visits occupied slots, found through a bitmap per level. Deadlines more than 64^6 ticks away wait
+		// in an overflow list. Not thread safe, timer_service adds the locking.
+		class CPPUTILS_API timer_wheel
+		{
+		public:
+			static constexpr uint32_t slot_bits = 6;
+			static constexpr uint32_t slots = 1 << slot_bits;
+			static constexpr uint32_t levels = 6;
+
+			explicit timer_wheel(uint64_t now = 0) noexcept : m_now(now) {}
+
+			timer_wheel(const timer_wheel &) = delete;
+			timer_wheel &operator=(const timer_wheel &) = delete;
+
+			// Arms the node, a deadline not after now() expires on the next advance
+			void insert(timer_node *node, uint64_t deadline) noexcept;
+
+			// Disarms the node, returns false if it is not armed, e.g. because it already expired
+			bool cancel(timer_node *node) noexcept;
+
+			// Moves the current tick forward and returns the expired nodes linked through m_next
+			timer_node *advance(uint64_t now) noexcept;
+
+			// Earliest tick advance() has work at, a deadline or a cascade, nullopt when empty
+			std::optional<uint64_t> next_tick() const noexcept;
+
+			uint64_t now() const noexcept
+			{
+				return m_now;
+			}
+
+			size_t size() const noexcept
+			{
+				return m_size;
+			}
+
+		private:
+			// The last two lists hold due and overflowing nodes
+			static constexpr int32_t due_list = levels * slots;
+			static constexpr int32_t overflow_list = due_list + 1;
+
+			void push(int32_t list, timer_node *node) noexcept;
+			timer_node *detach(int32_t list) noexcept;
+			void place(timer_node *node) noexcept;
+
+			uint64_t m_now;
+			size_t m_size = 0;
+			uint64_t m_occupied[levels] = {};
+			timer_node *m_lists[overflow_list + 1] = {};
+		};
+
+		/// \brief
+		/// Exception thrown by with_timeout() when the deadline passes before the task completes.
+		class timeout_error : public std::runtime_error
+		{
+		public:
+			timeout_error() : std::runtime_error("operation timed out") {}
+		};
+
+		namespace detail
+		{
+			// Shared between the with_timeout awaiter, its timer and the coroutine running the task
+			// m_self keeps it alive while the timer is armed, whoever flips m_decided resumes the awaiter.
+			// The task observes m_source, cancelled on timeout and by the awaiting task's token.
+			template <typename T>
+			struct timeout_state : timer_node
+			{
+				cancellation_source m_source;
+				cancellation_token m_token = m_source.token();
+				std::optional<cancellation_registration> m_parent;
+				std::atomic<bool> m_decided{false};
+				bool m_timedOut = false;
+				std::coroutine_handle<> m_awaitingCoroutine;
+				std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> m_value;
+				std::exception_ptr m_exception;
+				std::shared_ptr<timeout_state> m_self;
+			};
+		}
+
+		// Timers driven by a dedicated thread sleeping on a condition variable until the next tick with work
+		// Expired coroutines resume on that thread, co_await an executor's schedule() to move elsewhere.
+		class CPPUTILS_API timer_service
+		{
+		public:
+			using clock = std::chrono::steady_clock;
+			using time_point = clock::time_point;
+			using duration = clock::duration;
+
+			// Awaiter resuming the awaiting coroutine on the timer thread once the deadline passed
+			// Observes the given token, or the awaiting task's, and throws operation_cancelled when it is
+			// cancelled first. The timer is then disarmed and the coroutine resumes on the cancelling thread.
+			class timer_operation : private timer_node
+			{
+			public:
+				timer_operation(timer_service &service, time_point deadline, cancellation_token token = {}) noexcept
+					: m_service(service), m_deadline(deadline), m_token(std::move(token))
+				{
+				}
+
+				bool await_ready() noexcept
+				{
+					m_cancelled = m_token.is_cancellation_requested();
+					return m_cancelled || m_deadline <= clock::now();
+				}
+
+				template <typename PROMISE>
+				bool await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine)
+				{
+					if constexpr (std::is_base_of_v<detail::task_promise_base, PROMISE>)
+					{
+						if (!m_token.can_be_cancelled())
+							m_token = detail::cancellation_access::token(awaitingCoroutine.promise().cancellation());
+					}
+
+					m_awaitingCoroutine = awaitingCoroutine;
+					if (!m_token.can_be_cancelled())
+					{
+						m_callback = [](timer_node *node)
+						{ static_cast<timer_operation *>(node)->m_awaitingCoroutine.resume(); };
+						m_service.arm(this, m_deadline);
+						return true;
+					}
+
+					// The timer and the cancellation each release the latch once they won the node,
+					// the awaiter releases it once registered, the last one resumes
+					m_callback = [](timer_node *node)
+					{ static_cast<timer_operation *>(node)->complete(); };
+					m_service.arm(this, m_deadline);
+					m_registration.emplace(m_token, [this]
+					{
+						if (m_service.cancel(this))
+						{
+							m_cancelled = true;
+							complete();
+						}
+					});
+					return m_latch.fetch_sub(1, std::memory_order_acq_rel) != 1;
+				}
+
+				void await_resume()
+				{
+					// Waits for a callback still running on another thread
+					m_registration.reset();
+					if (m_cancelled)
+						throw operation_cancelled{};
+				}
+
+			private:
+				void complete() noexcept
+				{
+					if (m_latch.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						m_awaitingCoroutine.resume();
+				}
+
+				timer_service &m_service;
+				time_point m_deadline;
+				std::coroutine_handle<> m_awaitingCoroutine;
+				cancellation_token m_token;
+				std::optional<cancellation_registration> m_registration;
+				std::atomic<int> m_latch{2};
+				bool m_cancelled = false;
+			};
+
+			// Ticks are resolution long, deadlines are rounded up to the next tick
+			explicit timer_service(duration resolution = std::chrono::milliseconds(1));
+
+			// Stops the timer thread, coroutines still sleeping are never resumed
+			~timer_service();
+
+			timer_service(const timer_service &) = delete;
+			timer_service &operator=(const timer_service &) = delete;
+
+			timer_operation sleep_until(time_point deadline, cancellation_token token = {}) noexcept
+			{
+				return timer_operation{*this, deadline, std::move(token)};
+			}
+
+			template <typename REP, typename PERIOD>
+			timer_operation sleep_for(std::chrono::duration<REP, PERIOD> delay, cancellation_token token = {}) noexcept
+			{
+				return timer_operation{*this, clock::now() + std::chrono::duration_cast<duration>(delay), std::move(token)};
+			}
+
+			// Completes with the task's result, or throws timeout_error once timeout elapsed first
+			// On timeout the task's token is cancelled, so its sleeps, I/O and waits stop early, and its
+			// result is dropped. The task gets a token of its own following the awaiting task's, one
+			// bound to it beforehand is replaced.
+			template <typename T, typename REP, typename PERIOD>
+			task<T> with_timeout(task<T> operation, std::chrono::duration<REP, PERIOD> timeout)
+			{
+				co_return co_await timeout_operation<T>{*this, std::move(operation), clock::now() + std::chrono::duration_cast<duration>(timeout)};
+			}
+
+			// Arms node to have its callback called on the timer thread at deadline
+			void arm(timer_node *node, time_point deadline);
+
+			// Disarms node, returns false if its callback already ran or is about to
+			bool cancel(timer_node *node);
+
+			// Number of armed timers
+			size_t size() const;
+
+			// Shared instance behind asyncio::sleep_for, sleep_until and with_timeout
+			static timer_service &global();
+
+		private:
+			template <typename T>
+			class timeout_operation
+			{
+			public:
+				timeout_operation(timer_service &service, task<T> &&operation, time_point deadline)
+					: m_service(service), m_operation(std::move(operation)), m_deadline(deadline),
+					  m_state(std::make_shared<detail::timeout_state<T>>())
+				{
+				}
+
+				bool await_ready() const noexcept { return false; }
+
+				// Only touches locals once the timer is armed, the awaiting coroutine may resume on the timer thread
+				template <typename PROMISE>
+				void await_suspend(std::coroutine_handle<PROMISE> awaitingCoroutine)
+				{
+					auto state = m_state;
+					timer_service &service = m_service;
+					task<T> operation = std::move(m_operation);
+					operation.set_cancellation_token(state->m_token);
+					if constexpr (std::is_base_of_v<detail::task_promise_base, PROMISE>)
+					{
+						detail::cancellation_state *parent = awaitingCoroutine.promise().cancellation();
+						if (parent != nullptr && parent->can_be_cancelled())
+						{
+							// The copy keeps the source alive should the cancelled task release the state
+							state->m_parent.emplace(detail::cancellation_access::token(parent), [source = state->m_source]
+													{
+														cancellation_source keep = source;
+														keep.request_cancellation(); });
+						}
+					}
+
+					state->m_awaitingCoroutine = awaitingCoroutine;
+					state->m_callback = [](timer_node *node)
+					{
+						auto self = std::move(static_cast<detail::timeout_state<T> *>(node)->m_self);
+						if (!self->m_decided.exchange(true, std::memory_order_acq_rel))
+						{
+							self->m_timedOut = true;
+							self->m_source.request_cancellation();
+							self->m_awaitingCoroutine.resume();
+						}
+					};
+					state->m_self = state;
+					service.arm(state.get(), m_deadline);
+
+					drive(service, std::move(operation), std::move(state));
+				}
+
+				T await_resume()
+				{
+					if (m_state->m_timedOut)
+						throw timeout_error{};
+					if (m_state->m_exception)
+						std::rethrow_exception(m_state->m_exception);
+					if constexpr (!std::is_void_v<T>)
+						return std::move(*m_state->m_value);
+				}
+
+			private:
+				static detail::detached_task drive(timer_service &service, task<T> operation, std::shared_ptr<detail::timeout_state<T>> state)
+				{
+					try
+					{
+						if constexpr (std::is_void_v<T>)
+							co_await operation;
+						else
+							state->m_value.emplace(co_await operation);
+					}
+					catch (...)
+					{
+						state->m_exception = std::current_exception();
+					}
+
+					if (!state->m_decided.exchange(true, std::memory_order_acq_rel))
+					{
+						if (service.cancel(state.get()))
+							state->m_self.reset();
+						state->m_awaitingCoroutine.resume();
+					}
+				}
+
+				timer_service &m_service;
+				task<T> m_operation;
+				time_point m_deadline;
+				std::shared_ptr<detail::timeout_state<T>> m_state;
+			};
+
+			void run();
+			uint64_t to_tick(time_point time, bool roundUp) const noexcept;
+
+			duration m_resolution;
+			time_point m_epoch;
+
+			mutable std::mutex m_mutex;
+			std::condition_variable m_condition;
+			timer_wheel m_wheel;
+
+			// Tick the timer thread sleeps until, arming an earlier deadline wakes it
+			uint64_t m_wakeTick = UINT64_MAX;
+			bool m_stopRequested = false;
+			std::thread m_thread;
+		};
+
+		// Sleeps on the global timer service, the coroutine resumes on its thread
+		inline timer_service::timer_operation sleep_until(timer_service::time_point deadline, cancellation_token token = {}) noexcept
+		{
+			return timer_service::global().sleep_until(deadline, std::move(token));
+		}
+
+		template <typename REP, typename PERIOD>
+		timer_service::timer_operation sleep_for(std::chrono::duration<REP, PERIOD> delay, cancellation_token token = {}) noexcept
+		{
+			return timer_service::global().sleep_for(delay, std::move(token));
+		}
+
+		template <typename T, typename REP, typename PERIOD>
+		task<T> with_timeout(task<T> operation, std::chrono::duration<REP, PERIOD> timeout)
+		{
+			return timer_service::global().with_timeout(std::move(operation), timeout);
+		}
+	}
+}
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core.h>
+#include <cpputils/asyncio/coroutine_semantics.h>
+#include <cpputils/asyncio/reset_events.h>
+#include <cpputils/asyncio/sync_wait_task.h>
+#include <chrono>
+#include <coroutine>
+#include <map>
+#include <stdexcept>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		// Simulated clock of a virtual_executor
+		// Time only moves when every coroutine on the executor is blocked, it then jumps straight
+		// to the next timer. Timer driven code runs deterministically and without sleeping.
+		struct virtual_clock
+		{
+			using rep = int64_t;
+			using period = std::nano;
+			using duration = std::chrono::duration<rep, period>;
+			using time_point = std::chrono::time_point<virtual_clock>;
+			static constexpr bool is_steady = true;
+		};
+
+		/// \brief
+		/// Exception thrown by virtual_executor::run() when the awaited task is blocked
+		/// but there is no ready coroutine and no timer left to advance to.
+		class virtual_deadlock : public std::logic_error
+		{
+		public:
+			virtual_deadlock()
+				: std::logic_error("virtual executor deadlock: the task waits on nothing the executor can run")
+			{
+			}
+		};
+
+		// Single threaded executor running on virtual time
+		// Coroutines enter it with co_await executor.schedule() and wait with sleep_for/sleep_until.
+		// run() drives a task to completion on the calling thread.
+		class virtual_executor
+		{
+		public:
+			using clock = virtual_clock;
+			using time_point = clock::time_point;
+			using duration = clock::duration;
+
+			virtual_executor() noexcept = default;
+
+			virtual_executor(const virtual_executor &) = delete;
+			virtual_executor &operator=(const virtual_executor &) = delete;
+
+			// Awaiter that queues the awaiting coroutine at the back of the ready queue
+			class schedule_operation
+			{
+			public:
+				schedule_operation(virtual_executor &executor) noexcept : m_executor(executor) {}
+
+				bool await_ready() const noexcept { return false; }
+
+				void await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+					m_executor.enqueue(this);
+				}
+
+				void await_resume() const noexcept {}
+
+			private:
+				friend class virtual_executor;
+				virtual_executor &m_executor;
+				std::coroutine_handle<> m_awaitingCoroutine;
+				schedule_operation *m_next = nullptr;
+			};
+
+			// Awaiter that resumes the awaiting coroutine once virtual time reaches the deadline
+			class timer_operation
+			{
+			public:
+				timer_operation(virtual_executor &executor, time_point deadline) noexcept
+					: m_executor(executor), m_deadline(deadline), m_schedule(executor)
+				{
+				}
+
+				bool await_ready() const noexcept
+				{
+					return m_deadline <= m_executor.now();
+				}
+
+				void await_suspend(std::coroutine_handle<> awaitingCoroutine)
+				{
+					m_schedule.m_awaitingCoroutine = awaitingCoroutine;
+					m_executor.m_timers.emplace(m_deadline, &m_schedule);
+				}
+
+				void await_resume() const noexcept {}
+
+			private:
+				virtual_executor &m_executor;
+				time_point m_deadline;
+				schedule_operation m_schedule;
+			};
+
+			// Current virtual time
+			time_point now() const noexcept
+			{
+				return m_now;
+			}
+
+			schedule_operation schedule() noexcept
+			{
+				return schedule_operation{*this};
+			}
+
+			timer_operation sleep_until(time_point deadline) noexcept
+			{
+				return timer_operation{*this, deadline};
+			}
+
+			template <typename REP, typename PERIOD>
+			timer_operation sleep_for(std::chrono::duration<REP, PERIOD> delay) noexcept
+			{
+				return timer_operation{*this, m_now + std::chrono::duration_cast<duration>(delay)};
+			}
+
+			// Resumes the next ready coroutine, returns false if none is ready
+			bool run_one()
+			{
+				schedule_operation *operation = m_head;
+				if (operation == nullptr)
+					return false;
+
+				m_head = operation->m_next;
+				if (m_head == nullptr)
+					m_tail = nullptr;
+
+				operation->m_awaitingCoroutine.resume();
+				return true;
+			}
+
+			// Runs ready coroutines and advances time through the timers until nothing is left
+			void run_until_idle()
+			{
+				while (run_one() || advance_to_next_timer())
+				{
+				}
+			}
+
+			// Moves time forward by delay, running everything that becomes due on the way
+			void advance(duration delay)
+			{
+				const time_point target = m_now + delay;
+				for (;;)
+				{
+					while (run_one())
+					{
+					}
+
+					if (m_timers.empty() || m_timers.begin()->first > target)
+						break;
+					advance_to_next_timer();
+				}
+				m_now = target;
+			}
+
+			// Runs the awaitable to completion on the calling thread and returns its result
+			// Throws virtual_deadlock if it blocks on something other than this executor.
+			template <awaitable T>
+			auto run(T &&value)
+			{
+				auto task = detail::make_sync_wait_task(std::forward<T>(value));
+				manual_reset_event event;
+				task.start(event);
+				while (!event.is_set())
+				{
+					if (!run_one() && !advance_to_next_timer())
+						throw virtual_deadlock{};
+				}
+				return task.result();
+			}
+
+		private:
+			void enqueue(schedule_operation *operation) noexcept
+			{
+				operation->m_next = nullptr;
+				if (m_tail)
+					m_tail->m_next = operation;
+				else
+					m_head = operation;
+				m_tail = operation;
+			}
+
+			// Jumps to the earliest deadline and readies every timer due at it
+			bool advance_to_next_timer()
+			{
+				if (m_timers.empty())
+					return false;
+
+				m_now = std::max(m_now, m_timers.begin()->first);
+				while (!m_timers.empty() && m_timers.begin()->first <= m_now)
+				{
+					enqueue(m_timers.begin()->second);
+					m_timers.erase(m_timers.begin());
+				}
+				return true;
+			}
+
+			time_point m_now{};
+
+			// Ready queue, intrusive FIFO through the awaiters
+			schedule_operation *m_head = nullptr;
+			schedule_operation *m_tail = nullptr;
+
+			// Pending timers, equal deadlines fire in insertion order
+			std::multimap<time_point, schedule_operation *> m_timers;
+		};
+	}
+}
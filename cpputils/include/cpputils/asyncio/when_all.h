@@ -0,0 +1,308 @@
+#pragma once
+
+#include <cpputils/asyncio/coroutine.h>
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <tuple>
+#include <variant>
+#include <vector>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		namespace detail
+		{
+			// Counts down the children of a when_all plus the awaiting coroutine itself
+			// Whoever brings it to zero continues the awaiting coroutine, so no mutex is needed.
+			class when_all_counter
+			{
+			public:
+				explicit when_all_counter(size_t count) noexcept : m_count(count + 1) {}
+
+				// Returns false if every child already completed and the awaiting coroutine should not suspend
+				bool try_await(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					m_awaitingCoroutine = awaitingCoroutine;
+					return m_count.fetch_sub(1, std::memory_order_acq_rel) > 1;
+				}
+
+				// Called by each child on completion, returns the coroutine to transfer to
+				std::coroutine_handle<> notify_completed() noexcept
+				{
+					if (m_count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						return m_awaitingCoroutine;
+					return std::noop_coroutine();
+				}
+
+			private:
+				std::atomic<size_t> m_count;
+				std::coroutine_handle<> m_awaitingCoroutine;
+			};
+
+			template <typename T>
+			class when_all_task;
+
+			// Promise of a child, keeps the result in its own frame
+			template <typename T>
+			class when_all_task_promise : public frame_allocated
+			{
+			public:
+				when_all_task<T> get_return_object() noexcept;
+
+				std::suspend_always initial_suspend() noexcept { return {}; }
+
+				auto final_suspend() noexcept
+				{
+					struct final_awaitable
+					{
+						bool await_ready() const noexcept { return false; }
+
+						std::coroutine_handle<> await_suspend(std::coroutine_handle<when_all_task_promise> coroutine) noexcept
+						{
+							return coroutine.promise().m_counter->notify_completed();
+						}
+
+						void await_resume() const noexcept {}
+					};
+					return final_awaitable{};
+				}
+
+				void unhandled_exception() noexcept
+				{
+					m_exception = std::current_exception();
+				}
+
+				template <typename VALUE>
+				void return_value(VALUE &&value)
+				{
+					m_value.emplace(std::forward<VALUE>(value));
+				}
+
+				void start(when_all_counter &counter) noexcept
+				{
+					m_counter = &counter;
+					std::coroutine_handle<when_all_task_promise>::from_promise(*this).resume();
+				}
+
+				T result()
+				{
+					if (m_exception)
+						std::rethrow_exception(m_exception);
+					return std::move(*m_value);
+				}
+
+			private:
+				when_all_counter *m_counter = nullptr;
+				std::exception_ptr m_exception;
+				std::optional<T> m_value;
+			};
+
+			template <>
+			class when_all_task_promise<void> : public frame_allocated
+			{
+			public:
+				when_all_task<void> get_return_object() noexcept;
+
+				std::suspend_always initial_suspend() noexcept { return {}; }
+
+				auto final_suspend() noexcept
+				{
+					struct final_awaitable
+					{
+						bool await_ready() const noexcept { return false; }
+
+						std::coroutine_handle<> await_suspend(std::coroutine_handle<when_all_task_promise> coroutine) noexcept
+						{
+							return coroutine.promise().m_counter->notify_completed();
+						}
+
+						void await_resume() const noexcept {}
+					};
+					return final_awaitable{};
+				}
+
+				void unhandled_exception() noexcept
+				{
+					m_exception = std::current_exception();
+				}
+
+				void return_void() noexcept {}
+
+				void start(when_all_counter &counter) noexcept
+				{
+					m_counter = &counter;
+					std::coroutine_handle<when_all_task_promise>::from_promise(*this).resume();
+				}
+
+				void result()
+				{
+					if (m_exception)
+						std::rethrow_exception(m_exception);
+				}
+
+			private:
+				when_all_counter *m_counter = nullptr;
+				std::exception_ptr m_exception;
+			};
+
+			// Child coroutine of a when_all, owns the frame of the wrapped task
+			template <typename T>
+			class when_all_task
+			{
+			public:
+				using promise_type = when_all_task_promise<T>;
+
+				explicit when_all_task(std::coroutine_handle<promise_type> coroutine) noexcept : m_coroutine(coroutine) {}
+
+				when_all_task(when_all_task &&other) noexcept : m_coroutine(std::exchange(other.m_coroutine, nullptr)) {}
+
+				when_all_task(const when_all_task &) = delete;
+				when_all_task &operator=(const when_all_task &) = delete;
+				when_all_task &operator=(when_all_task &&) = delete;
+
+				~when_all_task()
+				{
+					if (m_coroutine)
+						m_coroutine.destroy();
+				}
+
+				void start(when_all_counter &counter) noexcept
+				{
+					m_coroutine.promise().start(counter);
+				}
+
+				decltype(auto) result()
+				{
+					return m_coroutine.promise().result();
+				}
+
+			private:
+				std::coroutine_handle<promise_type> m_coroutine;
+			};
+
+			template <typename T>
+			when_all_task<T> when_all_task_promise<T>::get_return_object() noexcept
+			{
+				return when_all_task<T>{std::coroutine_handle<when_all_task_promise>::from_promise(*this)};
+			}
+
+			inline when_all_task<void> when_all_task_promise<void>::get_return_object() noexcept
+			{
+				return when_all_task<void>{std::coroutine_handle<when_all_task_promise>::from_promise(*this)};
+			}
+
+			template <typename T>
+			when_all_task<T> make_when_all_task(task<T> operation)
+			{
+				if constexpr (std::is_void_v<T>)
+					co_await std::move(operation);
+				else
+					co_return co_await std::move(operation);
+			}
+
+			// Starts every child then suspends until the counter reaches zero
+			template <typename START>
+			class when_all_awaiter
+			{
+			public:
+				when_all_awaiter(when_all_counter &counter, START start) noexcept
+					: m_counter(counter), m_start(std::move(start))
+				{
+				}
+
+				bool await_ready() const noexcept { return false; }
+
+				bool await_suspend(std::coroutine_handle<> awaitingCoroutine) noexcept
+				{
+					m_start();
+					return m_counter.try_await(awaitingCoroutine);
+				}
+
+				void await_resume() const noexcept {}
+
+			private:
+				when_all_counter &m_counter;
+				START m_start;
+			};
+
+			// Result type of a child in the tuple, void results become std::monostate
+			template <typename T>
+			using when_all_value_t = std::conditional_t<std::is_void_v<T>, std::monostate, T>;
+
+			template <typename T>
+			when_all_value_t<T> when_all_value(when_all_task<T> &child)
+			{
+				if constexpr (std::is_void_v<T>)
+				{
+					child.result();
+					return {};
+				}
+				else
+				{
+					return child.result();
+				}
+			}
+		}
+
+		/// \brief
+		/// Runs the tasks concurrently and completes once all of them did.
+		///
+		/// Each task starts on the awaiting thread and may continue wherever it resumes, the awaiting
+		/// coroutine continues on the thread that completes the last one. Results come back as a tuple
+		/// in argument order with void results as std::monostate. If tasks throw, the exception of the
+		/// first of them in argument order is rethrown once all completed. The tasks observe the
+		/// cancellation token of the awaiting task unless they were bound to one.
+		template <typename... T>
+		task<std::tuple<detail::when_all_value_t<T>...>> when_all(task<T>... operations)
+		{
+			// The children are not tasks, they cannot pass the token down themselves
+			cancellation_token token = co_await get_cancellation_token();
+			(operations.inherit_cancellation_token(token), ...);
+
+			std::tuple<detail::when_all_task<T>...> children{detail::make_when_all_task(std::move(operations))...};
+			detail::when_all_counter counter{sizeof...(T)};
+			co_await detail::when_all_awaiter{counter, [&]()
+											  { std::apply([&](auto &...child)
+														   { (child.start(counter), ...); }, children); }};
+
+			co_return std::apply([](auto &...child)
+								 { return std::tuple<detail::when_all_value_t<T>...>{detail::when_all_value(child)...}; }, children);
+		}
+
+		/// \brief
+		/// Runs a range of tasks concurrently, results come back in range order.
+		template <typename T>
+		task<std::conditional_t<std::is_void_v<T>, void, std::vector<T>>> when_all(std::vector<task<T>> operations)
+		{
+			cancellation_token token = co_await get_cancellation_token();
+			std::vector<detail::when_all_task<T>> children;
+			children.reserve(operations.size());
+			for (auto &operation : operations)
+			{
+				operation.inherit_cancellation_token(token);
+				children.push_back(detail::make_when_all_task(std::move(operation)));
+			}
+
+			detail::when_all_counter counter{children.size()};
+			co_await detail::when_all_awaiter{counter, [&]()
+											  { for (auto &child : children) child.start(counter); }};
+
+			if constexpr (std::is_void_v<T>)
+			{
+				for (auto &child : children)
+					child.result();
+			}
+			else
+			{
+				std::vector<T> results;
+				results.reserve(children.size());
+				for (auto &child : children)
+					results.push_back(child.result());
+				co_return results;
+			}
+		}
+	}
+}
@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cpputils/asyncio/coroutine.h>
+#include <atomic>
+#include <concepts>
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		// Result of when_any: which task completed first and its value
+		template <typename T>
+		struct when_any_result
+		{
+			size_t index;
+			T value;
+		};
+
+		template <>
+		struct when_any_result<void>
+		{
+			size_t index;
+		};
+
+		namespace detail
+		{
+			// Shared by a when_any and its children, one allocation for the whole group
+			// The children race on m_decided. The latch counts the winner and the awaiter still starting
+			// children, whoever comes last continues the awaiting coroutine.
+			template <typename T>
+			struct when_any_state
+			{
+				explicit when_any_state(size_t children) noexcept : m_references(children + 1) {}
+
+				void release() noexcept
+				{
+					if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						delete this;
+				}
+
+				std::atomic<size_t> m_references;
+				std::atomic<bool> m_decided{false};
+				std::atomic<int> m_latch{2};
+				std::coroutine_handle<> m_awaitingCoroutine;
+				size_t m_index = 0;
+				std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> m_value;
+				std::exception_ptr m_exception;
+			};
+
+			// The token lives in the child's frame, losers keep running after the when_any completed
+			template <typename T>
+			detached_task run_when_any_child(task<T> operation, size_t index, when_any_state<T> *state, cancellation_token token)
+			{
+				operation.inherit_cancellation_token(token);
+				std::exception_ptr exception;
+				std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> value;
+				try
+				{
+					if constexpr (std::is_void_v<T>)
+					{
+						co_await operation;
+						value.emplace(true);
+					}
+					else
+					{
+						value.emplace(co_await std::move(operation));
+					}
+				}
+				catch (...)
+				{
+					exception = std::current_exception();
+				}
+
+				if (!state->m_decided.exchange(true, std::memory_order_acq_rel))
+				{
+					state->m_index = index;
+					state->m_value = std::move(value);
+					state->m_exception = exception;
+					if (state->m_latch.fetch_sub(1, std::memory_order_acq_rel) == 1)
+						state->m_awaitingCoroutine.resume();
+				}
+				state->release();
+			}
+
+			template <typename T>
+			class when_any_awaiter
+			{
+			public:
+				when_any_awaiter(std::vector<task<T>> &operations, cancellation_token token)
+					: m_operations(operations), m_state(new when_any_state<T>(operations.size())), m_token(std::move(token))
+				{
+				}
+
+				~when_any_awaiter()
+				{
+					m_state->release();
+				}
+
+				when_any_awaiter(const when_any_awaiter &) = delete;
+				when_any_awaiter &operator=(const when_any_awaiter &) = delete;
+
+				bool await_ready() const noexcept { return false; }
+
+				bool await_suspend(std::coroutine_handle<> awaitingCoroutine)
+				{
+					m_state->m_awaitingCoroutine = awaitingCoroutine;
+					for (size_t i = 0; i < m_operations.size(); i++)
+						run_when_any_child(std::move(m_operations[i]), i, m_state, m_token);
+					return m_state->m_latch.fetch_sub(1, std::memory_order_acq_rel) > 1;
+				}
+
+				when_any_result<T> await_resume()
+				{
+					if (m_state->m_exception)
+						std::rethrow_exception(m_state->m_exception);
+					if constexpr (std::is_void_v<T>)
+						return {m_state->m_index};
+					else
+						return {m_state->m_index, std::move(*m_state->m_value)};
+				}
+
+			private:
+				std::vector<task<T>> &m_operations;
+				when_any_state<T> *m_state;
+				cancellation_token m_token;
+			};
+		}
+
+		/// \brief
+		/// Runs the tasks concurrently and completes with the first one to finish.
+		///
+		/// An exception thrown by the first task to finish is rethrown. The other tasks keep running
+		/// in the background until they complete, their results are dropped. The tasks observe the
+		/// cancellation token of the awaiting task unless they were bound to one.
+		template <typename T>
+		task<when_any_result<T>> when_any(std::vector<task<T>> operations)
+		{
+			if (operations.empty())
+				throw std::invalid_argument("when_any needs at least one task");
+
+			co_return co_await detail::when_any_awaiter<T>{operations, co_await get_cancellation_token()};
+		}
+
+		template <typename T, typename... REST>
+			requires(std::same_as<REST, task<T>> && ...)
+		task<when_any_result<T>> when_any(task<T> first, REST... rest)
+		{
+			std::vector<task<T>> operations;
+			operations.reserve(1 + sizeof...(REST));
+			operations.push_back(std::move(first));
+			(operations.push_back(std::move(rest)), ...);
+			return when_any(std::move(operations));
+		}
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cpputils/asyncio/cancellation.h>
+#include <cpputils/asyncio/coroutine.h>
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <type_traits>
+
+namespace cpputils
+{
+	namespace asyncio
+	{
+		namespace detail
+		{
+			// Shared between the with_cancellation awaiter, its registration and the coroutine running the task
+			// The registration and the task race on m_decided. The latch counts the winner and the awaiter
+			// still registering, whoever comes last resumes the awaiting coroutine.
+			template <typename T>
+			struct cancellable_state
+			{
+				explicit cancellable_state(cancellation_token token) noexcept : m_token(std::move(token)) {}
+
+				cancellation_token m_token;
+				std::optional<cancellation_registration> m_registration;
+				std::atomic<bool> m_decided{false};
+				std::atomic<int> m_latch{2};
+				bool m_cancelled = false;
+				std::coroutine_handle<> m_awaitingCoroutine;
+				std::optional<std::conditional_t<std::is_void_v<T>, bool, T>> m_value;
+				std::exception_ptr m_exception;
+			};
+
+			template <typename T>
+			class cancellable_operation
+			{
+			public:
+				cancellable_operation(task<T> &&operation, cancellation_token &&token)
+					: m_operation(std::move(operation)),
+					  m_state(std::make_shared<cancellable_state<T>>(std::move(token)))
+				{
+					m_operation.set_cancellation_token(m_state->m_token);
+				}
+
+				bool await_ready() const noexcept
+				{
+					return m_state->m_token.is_cancellation_requested();
+				}
+
+				bool await_suspend(std::coroutine_handle<> awaitingCoroutine)
+				{
+					auto state = m_state;
+					state->m_awaitingCoroutine = awaitingCoroutine;
+
+					// The callback cannot resume the awaiter before the latch is released below
+					state->m_registration.emplace(state->m_token, [raw = state.get()]
+					{
+						if (!raw->m_decided.exchange(true, std::memory_order_acq_rel))
+						{
+							raw->m_cancelled = true;
+							if (raw->m_latch.fetch_sub(1, std::memory_order_acq_rel) == 1)
+								raw->m_awaitingCoroutine.resume();
+						}
+					});
+
+					if (!state->m_decided.load(std::memory_order_acquire))
+						drive(std::move(m_operation), state);
+
+					return state->m_latch.fetch_sub(1, std::memory_order_acq_rel) != 1;
+				}
+
+				T await_resume()
+				{
+					// Waits for a callback still running on another thread
+					m_state->m_registration.reset();
+
+					// Undecided when await_ready() found the token cancelled already
+					if (m_state->m_cancelled || !m_state->m_decided.load(std::memory_order_relaxed))
+						throw operation_cancelled{};
+					if (m_state->m_exception)
+						std::rethrow_exception(m_state->m_exception);
+					if constexpr (!std::is_void_v<T>)
+						return std::move(*m_state->m_value);
+				}
+
+			private:
+				static detached_task drive(task<T> operation, std::shared_ptr<cancellable_state<T>> state)
+				{
+					try
+					{
+						if constexpr (std::is_void_v<T>)
+							co_await operation;
+						else
+							state->m_value.emplace(co_await operation);
+					}
+					catch (...)
+					{
+						state->m_exception = std::current_exception();
+					}
+
+					if (!state->m_decided.exchange(true, std::memory_order_acq_rel))
+					{
+						if (state->m_latch.fetch_sub(1, std::memory_order_acq_rel) == 1)
+							state->m_awaitingCoroutine.resume();
+					}
+				}
+
+				task<T> m_operation;
+				std::shared_ptr<cancellable_state<T>> m_state;
+			};
+		}
+
+		/// \brief
+		/// Completes with the task's result, or throws operation_cancelled as soon as token is cancelled.
+		///
+		/// token becomes the task's ambient token, sleeps, I/O, events, semaphores, mutexes and
+		/// channels awaited by it or its nested tasks stop early with operation_cancelled, as does
+		/// anything taking get_cancellation_token(). Anything else the task awaits is abandoned:
+		/// it runs to completion in the background and its result is dropped. A task that never
+		/// starts because the token was already cancelled is destroyed unrun. On cancellation the
+		/// awaiting coroutine resumes on the thread calling request_cancellation().
+		template <typename T>
+		task<T> with_cancellation(task<T> operation, cancellation_token token)
+		{
+			co_return co_await detail::cancellable_operation<T>{std::move(operation), std::move(token)};
+		}
+	}
+}
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core.h>
+#include <cstdint>
+#include <functional>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace cpputils
+{
+	// bench namespace
+	// Small microbenchmark harness. A benchmark is a function looping over its state:
+	//
+	//   CPPUTILS_BENCHMARK(format_int)
+	//   {
+	//       for (auto _ : state)
+	//           bench::do_not_optimize(to_string(42));
+	//   }
+	//
+	// The runner warms every benchmark up, picks an iteration count so that each sample takes
+	// at least min_time, then reports the median, median absolute deviation and minimum of the
+	// per iteration times of all samples. Timing uses chrono::steady_now(). Executables including
+	// cpputils/bench/count_allocations.h also get the mean number of allocations per iteration.
+	namespace bench
+	{
+		namespace detail
+		{
+			// Called by the operator new replacement of count_allocations.h
+			CPPUTILS_API void count_allocation() noexcept;
+
+			// Registers the replacement, returns true so it can initialize a static
+			CPPUTILS_API bool enable_allocation_counting() noexcept;
+		}
+
+		// Allocations made by all threads so far, 0 unless allocations are counted
+		CPPUTILS_API uint64_t allocation_count() noexcept;
+
+		// Whether the executable counts allocations
+		CPPUTILS_API bool allocations_counted() noexcept;
+
+		// Keeps the compiler from optimizing a value away
+		template <typename T>
+		inline void do_not_optimize(const T &value)
+		{
+#if defined(_MSC_VER)
+			volatile const char *sink = reinterpret_cast<volatile const char *>(&value);
+			(void)*sink;
+			_ReadWriteBarrier();
+#else
+			asm volatile("" : : "r,m"(value) : "memory");
+#endif
+		}
+
+		template <typename T>
+		inline void do_not_optimize(T &value)
+		{
+#if defined(_MSC_VER)
+			volatile char *sink = reinterpret_cast<volatile char *>(&value);
+			(void)*sink;
+			_ReadWriteBarrier();
+#else
+			asm volatile("" : "+r,m"(value) : : "memory");
+#endif
+		}
+
+		// Forces pending writes to memory to be considered observable
+		inline void clobber_memory()
+		{
+#if defined(_MSC_VER)
+			_ReadWriteBarrier();
+#else
+			asm volatile("" : : : "memory");
+#endif
+		}
+
+		// Class state: drives the iterations of one benchmark run
+		// Only the range-for loop over the state is timed, setup before it is free.
+		class state
+		{
+		public:
+			state(uint64_t iterations) noexcept : m_iterations(iterations) {}
+
+			state(const state &) = delete;
+			state &operator=(const state &) = delete;
+
+			struct iterator
+			{
+				state *m_state;
+				uint64_t m_remaining;
+
+				// Value of the loop variable
+				// Not trivial, so that an unused loop variable does not warn
+				struct value
+				{
+					value() noexcept {}
+					~value() {}
+				};
+
+				value operator*() const noexcept { return {}; }
+
+				iterator &operator++() noexcept
+				{
+					m_remaining--;
+					return *this;
+				}
+
+				bool operator!=(const iterator &) noexcept
+				{
+					if (m_remaining != 0)
+						return true;
+
+					m_state->m_end = chrono::steady_now();
+					m_state->m_allocationsEnd = allocation_count();
+					return false;
+				}
+			};
+
+			iterator begin() noexcept
+			{
+				m_allocationsStart = allocation_count();
+				m_start = chrono::steady_now();
+				return {this, m_iterations};
+			}
+
+			iterator end() noexcept
+			{
+				return {this, 0};
+			}
+
+			// Number of iterations of this run
+			uint64_t iterations() const noexcept { return m_iterations; }
+
+			// Nanoseconds spent in the loop
+			uint64_t elapsed_ns() const noexcept { return chrono::diff_ns(m_start, m_end); }
+
+			// Allocations made by all threads during the loop
+			uint64_t allocations() const noexcept { return m_allocationsEnd - m_allocationsStart; }
+
+		private:
+			uint64_t m_iterations;
+			chrono::steady_time_point m_start;
+			chrono::steady_time_point m_end;
+			uint64_t m_allocationsStart = 0;
+			uint64_t m_allocationsEnd = 0;
+		};
+
+		using benchmark_func = std::function<void(state &)>;
+
+		// Runner configuration
+		struct options
+		{
+			// Only run benchmarks whose name contains this
+			string filter;
+
+			// Time spent running each benchmark before measuring
+			chrono::milliseconds warmup{100};
+
+			// Minimum duration of a sample, decides the iteration count
+			chrono::milliseconds min_time{10};
+
+			// Number of measured samples
+			uint32_t samples = 15;
+
+			// Pin the runner thread to this CPU, -1 to leave it floating
+			int pin_cpu = -1;
+
+			// Write the results as JSON to this file
+			string json_output;
+
+			// Compare against results previously written with json_output
+			string baseline;
+		};
+
+		// Result of a benchmark, times are per iteration
+		struct result
+		{
+			string name;
+			uint64_t iterations;
+			uint32_t samples;
+			double median_ns;
+			double mad_ns;
+			double min_ns;
+
+			// Mean over the samples, negative if allocations are not counted
+			double allocations_per_op = -1;
+
+			// Median of the baseline run, negative if the baseline has no such benchmark
+			double baseline_median_ns = -1;
+		};
+
+		// Registers a benchmark, returns true so it can initialize a static
+		CPPUTILS_API bool register_benchmark(const string &name, benchmark_func func);
+
+		// Runs one benchmark
+		CPPUTILS_API result run_benchmark(const string &name, const benchmark_func &func, const options &options);
+
+		// Runs the registered benchmarks matching the options
+		CPPUTILS_API array_list<result> run_benchmarks(const options &options);
+
+		// Parses --filter=, --warmup-ms=, --min-time-ms=, --samples=, --pin=, --json= and --baseline=
+		CPPUTILS_API options parse_options(int argc, char **argv);
+
+		// Parses the options, runs the benchmarks and prints a report, returns the process exit code
+		CPPUTILS_API int run_main(int argc, char **argv);
+
+		// Writes results as JSON
+		CPPUTILS_API string to_json(const array_list<result> &results, const options &options);
+
+		// Reads the name -> median pairs out of a JSON report
+		CPPUTILS_API tree_map<string, double> read_baseline(const string &path);
+	}
+
+	// Define benchmark macros
+#define CPPUTILS_BENCHMARK(name)                                                                                              \
+	static void name(cpputils::bench::state &state);                                                                          \
+	static const bool CPPUTILS_CONCAT(name, _registered) = cpputils::bench::register_benchmark(#name, name);                  \
+	static void name(cpputils::bench::state &state)
+
+#define CPPUTILS_BENCHMARK_MAIN()                         \
+	int main(int argc, char **argv)                       \
+	{                                                     \
+		return cpputils::bench::run_main(argc, argv);     \
+	}
+}
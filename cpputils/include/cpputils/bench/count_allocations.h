@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cpputils/bench/bench.h>
+#include <cstdlib>
+#include <new>
+
+// Counts the allocations of a benchmark executable for the bench harness
+// Replaces the global operator new and delete, include it in exactly one source file of the
+// executable, next to CPPUTILS_BENCHMARK_MAIN(). The array, sized and nothrow forms forward to
+// these by default, so every allocation made through new is counted once. The count is a shared
+// relaxed atomic, a few nanoseconds per allocation.
+
+static const bool cpputils_allocations_counted = cpputils::bench::detail::enable_allocation_counting();
+
+void *operator new(std::size_t size)
+{
+	cpputils::bench::detail::count_allocation();
+	if (void *memory = std::malloc(size == 0 ? 1 : size))
+		return memory;
+	throw std::bad_alloc();
+}
+
+void *operator new(std::size_t size, std::align_val_t alignment)
+{
+	cpputils::bench::detail::count_allocation();
+	const std::size_t align = static_cast<std::size_t>(alignment);
+	const std::size_t rounded = size == 0 ? align : (size + align - 1) & ~(align - 1);
+#if defined(_MSC_VER)
+	if (void *memory = _aligned_malloc(rounded, align))
+		return memory;
+#else
+	if (void *memory = std::aligned_alloc(align, rounded))
+		return memory;
+#endif
+	throw std::bad_alloc();
+}
+
+void operator delete(void *memory) noexcept
+{
+	std::free(memory);
+}
+
+void operator delete(void *memory, std::align_val_t) noexcept
+{
+#if defined(_MSC_VER)
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+// The sized forms are replaced along with the unsized ones they forward to, as -Wsized-deallocation asks
+void operator delete(void *memory, std::size_t) noexcept
+{
+	operator delete(memory);
+}
+
+void operator delete(void *memory, std::size_t, std::align_val_t alignment) noexcept
+{
+	operator delete(memory, alignment);
+}
@@ -4,5 +4,9 @@
 #include <cpputils/core/collections.h>
 #include <cpputils/core/debug.h>
 #include <cpputils/core/format.h>
+#include <cpputils/core/histogram.h>
 #include <cpputils/core/memory.h>
+#include <cpputils/core/metrics.h>
+#include <cpputils/core/parallel.h>
 #include <cpputils/core/string.h>
+#include <cpputils/core/trace.h>
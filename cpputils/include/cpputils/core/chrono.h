@@ -3,6 +3,7 @@
 #include <cpputils/cpputils_api.h>
 #include <chrono>
 #include <cpputils/core/format.h>
+#include <cpputils/core/histogram.h>
 #include <sstream>
 #include <iomanip>
 
@@ -41,6 +42,44 @@ namespace cpputils
 
 		// Get the time difference in seconds
 		CPPUTILS_API double diff(const chrono::time_point &start, const chrono::time_point &end);
+
+		// Define the monotonic clock used for measuring latencies
+		using steady_clock = std::chrono::steady_clock;
+
+		using steady_time_point = steady_clock::time_point;
+
+		// Get the current monotonic time point
+		CPPUTILS_API chrono::steady_time_point steady_now();
+
+		// Get the nanoseconds elapsed between two monotonic time points
+		CPPUTILS_API uint64_t diff_ns(const chrono::steady_time_point &start, const chrono::steady_time_point &end);
+
+		// Records the lifetime of the scope in nanoseconds into a histogram
+		class scoped_timer
+		{
+		private:
+			histogram &m_histogram;
+			steady_time_point m_start;
+
+		public:
+			scoped_timer(histogram &histogram) : m_histogram(histogram), m_start(steady_now()) {}
+
+			~scoped_timer()
+			{
+				m_histogram.record(diff_ns(m_start, steady_now()));
+			}
+
+			scoped_timer(const scoped_timer &) = delete;
+			scoped_timer &operator=(const scoped_timer &) = delete;
+		};
+
+		// Calls the function and records how long it took in nanoseconds
+		template <typename Func, typename... Args>
+		decltype(auto) measure(histogram &histogram, Func &&func, Args &&...args)
+		{
+			scoped_timer timer(histogram);
+			return std::forward<Func>(func)(std::forward<Args>(args)...);
+		}
 	}
 	// Define the duration literals
 	using namespace std::chrono_literals;
@@ -56,4 +95,7 @@ namespace cpputils
 		ss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S");
 		return ss.str();
 	}
+
+	// Define timing macros
+#define TIME_SCOPE(histogram) cpputils::chrono::scoped_timer CPPUTILS_CONCAT(cpputils_scoped_timer_, __LINE__)(histogram)
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cpputils/cpputils_api.h>
+#include <cstddef>
 #include <vector>
 #include <list>
 #include <stack>
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core/string.h>
+#include <cpputils/core/format.h>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+
+namespace cpputils
+{
+	// High dynamic range histogram
+	// Values are bucketed log-linearly: every power of two is split into 2^(precision - 1)
+	// linear sub buckets, so the relative error of any reported value is below 2^(1 - precision).
+	// Recording is wait-free (a couple of relaxed atomic increments) so a single instance may be
+	// shared between threads, but the usual pattern is one histogram per thread merged on read.
+	class CPPUTILS_API histogram
+	{
+	public:
+		// Default precision gives < 1% relative error
+		static constexpr uint32_t default_precision = 8;
+
+		// Creates a histogram able to track values in [0, max_value] with the given precision (2..16 bits)
+		explicit histogram(uint32_t precision = default_precision, uint64_t max_value = UINT64_MAX);
+
+		// Copying takes a (relaxed) snapshot of the counts
+		histogram(const histogram &other);
+		histogram &operator=(const histogram &other);
+		histogram(histogram &&other) noexcept;
+		histogram &operator=(histogram &&other) noexcept;
+
+		~histogram() = default;
+
+		// Records a value, values above max_value are clamped
+		void record(uint64_t value) noexcept
+		{
+			record(value, 1);
+		}
+
+		// Records a value count times
+		void record(uint64_t value, uint64_t count) noexcept
+		{
+			if (value > m_maxValue)
+				value = m_maxValue;
+			m_counts[index_of(value)].fetch_add(count, std::memory_order_relaxed);
+			m_totalCount.fetch_add(count, std::memory_order_relaxed);
+			m_sum.fetch_add(value * count, std::memory_order_relaxed);
+		}
+
+		// Adds all counts of other into this histogram, both must share the same configuration
+		void merge(const histogram &other);
+
+		// Clears all counts
+		void reset() noexcept;
+
+		// Configuration
+		uint32_t precision() const noexcept { return m_precision; }
+		uint64_t max_value() const noexcept { return m_maxValue; }
+		size_t bucket_count() const noexcept { return m_bucketCount; }
+
+		// Statistics
+		uint64_t count() const noexcept { return m_totalCount.load(std::memory_order_relaxed); }
+		uint64_t sum() const noexcept { return m_sum.load(std::memory_order_relaxed); }
+		uint64_t min() const noexcept;
+		uint64_t max() const noexcept;
+		double mean() const noexcept;
+
+		// Gets the value at a quantile in [0, 1], e.g 0.99
+		uint64_t value_at_quantile(double quantile) const noexcept;
+
+		// Gets the value at a percentile in [0, 100], e.g 99.9
+		uint64_t value_at_percentile(double percentile) const noexcept
+		{
+			return value_at_quantile(percentile / 100.0);
+		}
+
+		// Compact binary snapshot: zero runs are collapsed and counts are zigzag varint encoded
+		string serialize() const;
+
+		// Restores a histogram from serialize(), throws std::runtime_error on malformed input
+		static histogram deserialize(const string &data);
+
+	private:
+		// Bucket index of a value
+		size_t index_of(uint64_t value) const noexcept
+		{
+			if (value < m_linearLimit)
+				return static_cast<size_t>(value);
+
+			// Number of bits below the precision window
+			const uint32_t shift = static_cast<uint32_t>(std::bit_width(value)) - m_precision;
+			return (static_cast<size_t>(shift) << (m_precision - 1)) + static_cast<size_t>(value >> shift);
+		}
+
+		// Smallest and largest values mapping to a bucket
+		uint64_t lowest_value_of(size_t index) const noexcept;
+		uint64_t highest_value_of(size_t index) const noexcept;
+
+		uint32_t m_precision;
+		uint64_t m_maxValue;
+		uint64_t m_linearLimit;
+		size_t m_bucketCount;
+		std::unique_ptr<std::atomic<uint64_t>[]> m_counts;
+		std::atomic<uint64_t> m_totalCount{0};
+		std::atomic<uint64_t> m_sum{0};
+	};
+
+	// converts to string
+	template <>
+	inline string to_string(const histogram &value)
+	{
+		return cformat("count=%llu min=%llu p50=%llu p90=%llu p99=%llu p99.9=%llu max=%llu mean=%.1f",
+					   (unsigned long long)value.count(),
+					   (unsigned long long)value.min(),
+					   (unsigned long long)value.value_at_percentile(50),
+					   (unsigned long long)value.value_at_percentile(90),
+					   (unsigned long long)value.value_at_percentile(99),
+					   (unsigned long long)value.value_at_percentile(99.9),
+					   (unsigned long long)value.max(),
+					   value.mean());
+	}
+}
@@ -5,6 +5,9 @@
 
 namespace cpputils
 {
+	// Size of a cache line, used to pad data written by different threads
+	inline constexpr size_t cache_line_size = 64;
+
 	template <typename T>
 	using ref = std::shared_ptr<T>;
 
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core/string.h>
+#include <cpputils/core/memory.h>
+#include <cpputils/core/collections.h>
+#include <cpputils/core/histogram.h>
+#include <cpputils/core/chrono.h>
+#include <cpputils/core/debug.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace cpputils
+{
+	// metrics namespace
+	// Named counters, gauges and histograms whose updates land in per thread shards padded to a
+	// cache line, so hot increments from many cores never share a line. Reads aggregate the shards.
+	namespace metrics
+	{
+		namespace detail
+		{
+			// Number of shards, the next power of two above the hardware concurrency
+			CPPUTILS_API size_t shard_count() noexcept;
+
+			// Assigns the calling thread a shard, threads are spread round robin
+			CPPUTILS_API size_t assign_thread_shard() noexcept;
+
+			inline size_t shard_index() noexcept
+			{
+				static thread_local size_t shard = assign_thread_shard();
+				return shard;
+			}
+
+			// Cache line padded cell
+			template <typename T>
+			struct alignas(cache_line_size) padded_atomic
+			{
+				std::atomic<T> value{0};
+			};
+
+			// Cache line padded histogram, keeps the totals of neighbouring shards apart
+			struct alignas(cache_line_size) padded_histogram
+			{
+				cpputils::histogram value;
+			};
+
+			// Shard slot, the histogram is allocated by the first thread recording into it
+			using histogram_slot = std::atomic<padded_histogram *>;
+		}
+
+		// Kind of metric
+		enum class metric_kind
+		{
+			counter,
+			gauge,
+			histogram
+		};
+
+		// Monotonic counter
+		class CPPUTILS_API counter
+		{
+		public:
+			counter();
+
+			counter(const counter &) = delete;
+			counter &operator=(const counter &) = delete;
+
+			// Increments the calling thread's shard
+			void inc(uint64_t amount = 1) noexcept
+			{
+				m_shards[detail::shard_index()].value.fetch_add(amount, std::memory_order_relaxed);
+			}
+
+			// Sums the shards
+			uint64_t value() const noexcept;
+
+		private:
+			uref<detail::padded_atomic<uint64_t>[]> m_shards;
+		};
+
+		// Value that can go up and down
+		class CPPUTILS_API gauge
+		{
+		public:
+			gauge();
+
+			gauge(const gauge &) = delete;
+			gauge &operator=(const gauge &) = delete;
+
+			// Adds to the calling thread's shard
+			void add(int64_t amount) noexcept
+			{
+				m_shards[detail::shard_index()].value.fetch_add(amount, std::memory_order_relaxed);
+			}
+
+			void sub(int64_t amount) noexcept
+			{
+				add(-amount);
+			}
+
+			// Sets the value, concurrent add() calls may or may not be included
+			void set(int64_t value) noexcept;
+
+			// Sums the shards
+			int64_t value() const noexcept;
+
+		private:
+			std::atomic<int64_t> m_base{0};
+			uref<detail::padded_atomic<int64_t>[]> m_shards;
+		};
+
+		// Distribution of values, e.g latencies in nanoseconds
+		// A shard histogram is several KB, shards are only allocated once a thread records into them.
+		class CPPUTILS_API histogram
+		{
+		public:
+			histogram(uint32_t precision = cpputils::histogram::default_precision, uint64_t max_value = UINT64_MAX);
+
+			~histogram();
+
+			histogram(const histogram &) = delete;
+			histogram &operator=(const histogram &) = delete;
+
+			// Records into the calling thread's shard
+			void record(uint64_t value)
+			{
+				detail::histogram_slot &slot = m_shards[detail::shard_index()];
+				detail::padded_histogram *shard = slot.load(std::memory_order_acquire);
+				if (shard == nullptr)
+					shard = create_shard(slot);
+				shard->value.record(value);
+			}
+
+			// Merges the shards
+			cpputils::histogram snapshot() const;
+
+		private:
+			detail::padded_histogram *create_shard(detail::histogram_slot &slot);
+
+			uint32_t m_precision;
+			uint64_t m_maxValue;
+			uref<detail::histogram_slot[]> m_shards;
+		};
+
+		// Class registry: owns named metrics
+		// Looking a metric up takes a lock, keep the returned reference around on hot paths.
+		class CPPUTILS_API registry
+		{
+		public:
+			registry() = default;
+
+			registry(const registry &) = delete;
+			registry &operator=(const registry &) = delete;
+
+			// Gets or creates a metric, throws std::invalid_argument if the name is taken by another kind
+			counter &get_counter(const string &name, const string &help = "");
+			gauge &get_gauge(const string &name, const string &help = "");
+			metrics::histogram &get_histogram(const string &name, const string &help = "",
+											  uint32_t precision = cpputils::histogram::default_precision);
+
+			// Writes all metrics in the Prometheus text exposition format
+			// Histograms are exposed as summaries with 0.5, 0.9, 0.99 and 0.999 quantiles.
+			string to_text() const;
+
+			// Process wide registry
+			static registry &global();
+
+		private:
+			struct entry
+			{
+				metric_kind kind;
+				string help;
+				uref<counter> counter_metric;
+				uref<gauge> gauge_metric;
+				uref<metrics::histogram> histogram_metric;
+			};
+
+			entry &get_entry(const string &name, const string &help, metric_kind kind);
+
+			mutable std::mutex m_mutex;
+			tree_map<string, entry> m_entries;
+		};
+
+		// Reads the samples of a text exposition back, as a local scraper would
+		// Keys are the sample names with their labels, e.g latency_ns{quantile="0.99"}. Comment and
+		// malformed lines are skipped.
+		CPPUTILS_API tree_map<string, double> parse_text(const string &text);
+
+		// Class reporter: periodically logs a snapshot of a registry
+		// Every exposition line is sent as its own log record with the "metrics" context.
+		class CPPUTILS_API reporter
+		{
+		public:
+			reporter(registry &registry, ref<logger> logger, chrono::milliseconds interval, log_level level = log_level::INFO);
+
+			// Stops the reporting thread
+			~reporter();
+
+			reporter(const reporter &) = delete;
+			reporter &operator=(const reporter &) = delete;
+
+			// Logs a snapshot immediately
+			void report_now();
+
+		private:
+			void run();
+
+			registry &m_registry;
+			ref<logger> m_logger;
+			chrono::milliseconds m_interval;
+			log_level m_level;
+			bool m_stop = false;
+			std::mutex m_mutex;
+			std::condition_variable m_cv;
+			std::thread m_thread;
+		};
+	}
+}
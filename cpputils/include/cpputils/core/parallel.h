@@ -0,0 +1,426 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core/collections.h>
+#include <cpputils/core/memory.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace cpputils
+{
+	// Fork-join pool behind the parallel algorithms
+	// A region splits its work into chunks that the calling thread and the workers claim with a
+	// fetch_add until none is left, so faster threads simply take more chunks. Idle workers wait
+	// on an epoch word (a futex on Linux) bumped by every region. Regions started by different
+	// threads run one after another, a region started from inside a chunk runs inline.
+	class CPPUTILS_API parallel_pool
+	{
+	public:
+		// Starts thread_count - 1 workers, the thread running a region makes up the last one
+		explicit parallel_pool(uint32_t thread_count = std::thread::hardware_concurrency());
+
+		// Joins the workers, no region may be running
+		~parallel_pool();
+
+		parallel_pool(const parallel_pool &) = delete;
+		parallel_pool &operator=(const parallel_pool &) = delete;
+
+		uint32_t thread_count() const noexcept
+		{
+			return m_threadCount;
+		}
+
+		// Calls body(chunk) for every chunk in [0, chunks) and returns once they all ran
+		// Rethrows the first exception a chunk threw, chunks not started by then are skipped.
+		template <typename FUNC>
+		void run(size_t chunks, FUNC &&body)
+		{
+			region job;
+			job.m_chunks = chunks;
+			job.m_body = std::addressof(body);
+			job.m_invoke = [](void *body, size_t chunk)
+			{ (*static_cast<std::remove_reference_t<FUNC> *>(body))(chunk); };
+			run(job);
+		}
+
+		// Pool the algorithms use when none is given, one thread per hardware thread
+		static parallel_pool &global();
+
+	private:
+		struct region
+		{
+			size_t m_chunks = 0;
+			void *m_body = nullptr;
+			void (*m_invoke)(void *, size_t) = nullptr;
+
+			alignas(cache_line_size) std::atomic<size_t> m_next{0};
+			alignas(cache_line_size) std::atomic<size_t> m_done{0};
+			std::atomic<bool> m_failed{false};
+			std::exception_ptr m_exception;
+		};
+
+		void run(region &job);
+		void run_worker();
+		static void work(region &job) noexcept;
+
+		uint32_t m_threadCount;
+		array_list<std::thread> m_threads;
+
+		// Serializes regions of different threads
+		std::mutex m_mutex;
+
+		// Region being run, workers count themselves in m_active before reading it
+		alignas(cache_line_size) std::atomic<region *> m_region{nullptr};
+		std::atomic<uint32_t> m_active{0};
+		alignas(cache_line_size) std::atomic<uint32_t> m_epoch{0};
+		std::atomic<bool> m_stopRequested{false};
+	};
+
+	namespace detail
+	{
+		// Chunks per thread, enough for the dynamic claiming to even out uneven chunks
+		inline constexpr size_t chunks_per_thread = 4;
+
+		// Items below which a chunk is not worth handing to another thread
+		inline constexpr size_t default_grain = 4096;
+
+		// Splits [0, count) into equal chunks of whole cache lines of T
+		// Neighbouring chunks never write to the same line, the last chunk takes the remainder.
+		struct chunk_plan
+		{
+			size_t m_count = 0;
+			size_t m_size = 0;
+			size_t m_chunks = 0;
+
+			template <typename T>
+			static chunk_plan make(size_t count, uint32_t threads, size_t grain)
+			{
+				constexpr size_t line = sizeof(T) >= cache_line_size ? 1 : cache_line_size / sizeof(T);
+				size_t target = std::max<size_t>(1, threads * chunks_per_thread);
+				size_t size = std::max((count + target - 1) / target, grain == 0 ? default_grain : grain);
+				size = (size + line - 1) / line * line;
+
+				chunk_plan plan;
+				plan.m_count = count;
+				plan.m_size = size;
+				plan.m_chunks = count == 0 ? 0 : (count + size - 1) / size;
+				return plan;
+			}
+
+			size_t begin(size_t chunk) const noexcept
+			{
+				return std::min(chunk * m_size, m_count);
+			}
+
+			size_t end(size_t chunk) const noexcept
+			{
+				return std::min(begin(chunk) + m_size, m_count);
+			}
+		};
+
+		// Value of one chunk, alone on its cache lines
+		template <typename T>
+		struct alignas(cache_line_size) padded_partial
+		{
+			std::optional<T> m_value;
+		};
+
+		// Index in a of the merge path split with k outputs: merging a[0, i) and b[0, k - i) gives
+		// the first k elements of the merge, taking a first on ties like std::merge
+		template <typename A, typename B, typename COMPARE>
+		size_t merge_split(A a, size_t aCount, B b, size_t bCount, size_t k, COMPARE &compare)
+		{
+			size_t low = k > bCount ? k - bCount : 0;
+			size_t high = std::min(k, aCount);
+			while (low < high)
+			{
+				size_t i = low + (high - low) / 2;
+				if (!compare(b[k - i - 1], a[i]))
+					low = i + 1;
+				else
+					high = i;
+			}
+			return low;
+		}
+
+		// Radix sortable view of an integer key, signed keys get their sign bit flipped
+		template <std::integral KEY>
+		std::make_unsigned_t<KEY> radix_key(KEY key) noexcept
+		{
+			using unsigned_type = std::make_unsigned_t<KEY>;
+			if constexpr (std::is_signed_v<KEY>)
+				return static_cast<unsigned_type>(key) ^ (unsigned_type(1) << (sizeof(KEY) * 8 - 1));
+			else
+				return key;
+		}
+	}
+
+	// Calls body(i) for every i in [first, last), grain is the smallest chunk worth a thread
+	template <typename FUNC>
+	void parallel_for(parallel_pool &pool, size_t first, size_t last, FUNC body, size_t grain = 0)
+	{
+		if (last <= first)
+			return;
+
+		auto plan = detail::chunk_plan::make<std::byte>(last - first, pool.thread_count(), grain);
+		pool.run(plan.m_chunks, [&](size_t chunk)
+				 {
+					 for (size_t i = first + plan.begin(chunk), end = first + plan.end(chunk); i < end; i++)
+						 body(i); });
+	}
+
+	template <typename FUNC>
+	void parallel_for(size_t first, size_t last, FUNC body, size_t grain = 0)
+	{
+		parallel_for(parallel_pool::global(), first, last, std::move(body), grain);
+	}
+
+	// Writes transform(*it) for every it in [first, last) to out, returns the end of the output
+	template <std::random_access_iterator INPUT, std::random_access_iterator OUTPUT, typename FUNC>
+	OUTPUT parallel_transform(parallel_pool &pool, INPUT first, INPUT last, OUTPUT out, FUNC transform)
+	{
+		size_t count = static_cast<size_t>(last - first);
+		auto plan = detail::chunk_plan::make<std::iter_value_t<OUTPUT>>(count, pool.thread_count(), 0);
+		pool.run(plan.m_chunks, [&](size_t chunk)
+				 {
+					 auto begin = static_cast<std::iter_difference_t<INPUT>>(plan.begin(chunk));
+					 auto end = static_cast<std::iter_difference_t<INPUT>>(plan.end(chunk));
+					 std::transform(first + begin, first + end, out + begin, transform); });
+		return out + static_cast<std::iter_difference_t<OUTPUT>>(count);
+	}
+
+	template <std::random_access_iterator INPUT, std::random_access_iterator OUTPUT, typename FUNC>
+	OUTPUT parallel_transform(INPUT first, INPUT last, OUTPUT out, FUNC transform)
+	{
+		return parallel_transform(parallel_pool::global(), first, last, out, std::move(transform));
+	}
+
+	// Folds transform(*it) over [first, last) into init with reduce, which must be associative
+	// Chunks are folded in order, so reduce need not be commutative.
+	template <std::random_access_iterator ITERATOR, typename T, typename REDUCE, typename TRANSFORM = std::identity>
+	T parallel_reduce(parallel_pool &pool, ITERATOR first, ITERATOR last, T init, REDUCE reduce, TRANSFORM transform = {})
+	{
+		auto plan = detail::chunk_plan::make<std::iter_value_t<ITERATOR>>(static_cast<size_t>(last - first), pool.thread_count(), 0);
+		array_list<detail::padded_partial<T>> partials(plan.m_chunks);
+		pool.run(plan.m_chunks, [&](size_t chunk)
+				 {
+					 auto begin = static_cast<std::iter_difference_t<ITERATOR>>(plan.begin(chunk));
+					 auto end = static_cast<std::iter_difference_t<ITERATOR>>(plan.end(chunk));
+					 T value = transform(first[begin]);
+					 for (auto i = begin + 1; i < end; i++)
+						 value = reduce(std::move(value), transform(first[i]));
+					 partials[chunk].m_value.emplace(std::move(value)); });
+
+		for (auto &partial : partials)
+			init = reduce(std::move(init), std::move(*partial.m_value));
+		return init;
+	}
+
+	template <std::random_access_iterator ITERATOR, typename T, typename REDUCE, typename TRANSFORM = std::identity>
+	T parallel_reduce(ITERATOR first, ITERATOR last, T init, REDUCE reduce, TRANSFORM transform = {})
+	{
+		return parallel_reduce(parallel_pool::global(), first, last, std::move(init), std::move(reduce), std::move(transform));
+	}
+
+	// Unstable sort, the chunks are sorted in parallel then merged pairwise into a buffer and back
+	// Every merge round is split along merge paths into pieces of about a chunk, so the last rounds
+	// with few runs left still keep every thread busy. Needs a default constructible value type.
+	template <std::random_access_iterator ITERATOR, typename COMPARE = std::less<>>
+	void parallel_sort(parallel_pool &pool, ITERATOR first, ITERATOR last, COMPARE compare = {})
+	{
+		using value_type = std::iter_value_t<ITERATOR>;
+		using difference_type = std::iter_difference_t<ITERATOR>;
+
+		size_t count = static_cast<size_t>(last - first);
+		auto plan = detail::chunk_plan::make<value_type>(count, pool.thread_count(), 0);
+		if (plan.m_chunks <= 1 || pool.thread_count() == 1)
+		{
+			std::sort(first, last, compare);
+			return;
+		}
+
+		pool.run(plan.m_chunks, [&](size_t chunk)
+				 { std::sort(first + static_cast<difference_type>(plan.begin(chunk)), first + static_cast<difference_type>(plan.end(chunk)), compare); });
+
+		// Run boundaries, run r is [bounds[r], bounds[r + 1])
+		array_list<size_t> bounds;
+		for (size_t chunk = 0; chunk < plan.m_chunks; chunk++)
+			bounds.push_back(plan.begin(chunk));
+		bounds.push_back(count);
+
+		auto buffer = std::make_unique_for_overwrite<value_type[]>(count);
+		struct piece
+		{
+			size_t m_run;
+			size_t m_begin;
+			size_t m_end;
+		};
+		array_list<piece> pieces;
+
+		// Merges pairs of runs of source into destination
+		auto mergeRound = [&](auto source, auto destination)
+		{
+			pieces.clear();
+			for (size_t run = 0; run + 1 < bounds.size(); run += 2)
+			{
+				size_t end = bounds[std::min(run + 2, bounds.size() - 1)];
+				for (size_t begin = bounds[run]; begin < end; begin += plan.m_size)
+					pieces.push_back({run, begin, std::min(begin + plan.m_size, end)});
+			}
+
+			pool.run(pieces.size(), [&](size_t index)
+					 {
+						 const piece &p = pieces[index];
+						 size_t aBegin = bounds[p.m_run];
+						 size_t bBegin = bounds[std::min(p.m_run + 1, bounds.size() - 1)];
+						 size_t bEnd = bounds[std::min(p.m_run + 2, bounds.size() - 1)];
+						 auto a = source + static_cast<difference_type>(aBegin);
+						 auto b = source + static_cast<difference_type>(bBegin);
+						 size_t aCount = bBegin - aBegin;
+						 size_t bCount = bEnd - bBegin;
+
+						 size_t i = detail::merge_split(a, aCount, b, bCount, p.m_begin - aBegin, compare);
+						 size_t iEnd = detail::merge_split(a, aCount, b, bCount, p.m_end - aBegin, compare);
+						 size_t j = p.m_begin - aBegin - i;
+						 size_t jEnd = p.m_end - aBegin - iEnd;
+						 std::merge(std::make_move_iterator(a + static_cast<difference_type>(i)), std::make_move_iterator(a + static_cast<difference_type>(iEnd)),
+									std::make_move_iterator(b + static_cast<difference_type>(j)), std::make_move_iterator(b + static_cast<difference_type>(jEnd)),
+									destination + static_cast<difference_type>(p.m_begin), compare); });
+
+			array_list<size_t> merged;
+			for (size_t run = 0; run < bounds.size() - 1; run += 2)
+				merged.push_back(bounds[run]);
+			merged.push_back(count);
+			bounds = std::move(merged);
+		};
+
+		bool inBuffer = false;
+		while (bounds.size() > 2)
+		{
+			if (inBuffer)
+				mergeRound(buffer.get(), first);
+			else
+				mergeRound(first, buffer.get());
+			inBuffer = !inBuffer;
+		}
+
+		if (inBuffer)
+		{
+			pool.run(plan.m_chunks, [&](size_t chunk)
+					 { std::move(buffer.get() + plan.begin(chunk), buffer.get() + plan.end(chunk), first + static_cast<difference_type>(plan.begin(chunk))); });
+		}
+	}
+
+	template <std::random_access_iterator ITERATOR, typename COMPARE = std::less<>>
+	void parallel_sort(ITERATOR first, ITERATOR last, COMPARE compare = {})
+	{
+		parallel_sort(parallel_pool::global(), first, last, std::move(compare));
+	}
+
+	// Stable LSD radix sort on an integer key, one byte per pass
+	// Each pass counts the digits of every chunk, turns the counts into per chunk offsets and
+	// scatters the chunks in parallel. Passes where all keys share the digit are skipped.
+	template <std::random_access_iterator ITERATOR, typename KEY>
+		requires std::integral<std::remove_cvref_t<std::invoke_result_t<KEY &, const std::iter_value_t<ITERATOR> &>>>
+	void parallel_radix_sort(parallel_pool &pool, ITERATOR first, ITERATOR last, KEY key)
+	{
+		using value_type = std::iter_value_t<ITERATOR>;
+		using difference_type = std::iter_difference_t<ITERATOR>;
+		using key_type = std::remove_cvref_t<std::invoke_result_t<KEY &, const value_type &>>;
+		constexpr size_t radix = 256;
+
+		size_t count = static_cast<size_t>(last - first);
+		if (count < 2)
+			return;
+
+		auto plan = detail::chunk_plan::make<value_type>(count, pool.thread_count(), 0);
+		array_list<std::array<size_t, radix>> counts(plan.m_chunks);
+		auto buffer = std::make_unique_for_overwrite<value_type[]>(count);
+
+		// Sorts source into destination on the digit at shift, false if the pass is skipped
+		auto pass = [&](auto source, auto destination, uint32_t shift)
+		{
+			auto digit = [&](const value_type &value)
+			{ return static_cast<size_t>((detail::radix_key(static_cast<key_type>(key(value))) >> shift) & (radix - 1)); };
+
+			pool.run(plan.m_chunks, [&](size_t chunk)
+					 {
+						 std::array<size_t, radix> &chunkCounts = counts[chunk];
+						 chunkCounts.fill(0);
+						 for (size_t i = plan.begin(chunk), end = plan.end(chunk); i < end; i++)
+							 chunkCounts[digit(source[static_cast<difference_type>(i)])]++; });
+
+			size_t offset = 0;
+			for (size_t d = 0; d < radix; d++)
+			{
+				size_t total = 0;
+				for (auto &chunkCounts : counts)
+				{
+					size_t n = chunkCounts[d];
+					chunkCounts[d] = offset + total;
+					total += n;
+				}
+				if (total == count)
+					return false;
+				offset += total;
+			}
+
+			pool.run(plan.m_chunks, [&](size_t chunk)
+					 {
+						 std::array<size_t, radix> &offsets = counts[chunk];
+						 for (size_t i = plan.begin(chunk), end = plan.end(chunk); i < end; i++)
+						 {
+							 auto &value = source[static_cast<difference_type>(i)];
+							 destination[static_cast<difference_type>(offsets[digit(value)]++)] = std::move(value);
+						 } });
+			return true;
+		};
+
+		bool inBuffer = false;
+		for (uint32_t shift = 0; shift < sizeof(key_type) * 8; shift += 8)
+		{
+			if (inBuffer ? pass(buffer.get(), first, shift) : pass(first, buffer.get(), shift))
+				inBuffer = !inBuffer;
+		}
+
+		if (inBuffer)
+		{
+			pool.run(plan.m_chunks, [&](size_t chunk)
+					 { std::move(buffer.get() + plan.begin(chunk), buffer.get() + plan.end(chunk), first + static_cast<difference_type>(plan.begin(chunk))); });
+		}
+	}
+
+	template <std::random_access_iterator ITERATOR, typename KEY>
+	void parallel_radix_sort(ITERATOR first, ITERATOR last, KEY key)
+	{
+		parallel_radix_sort(parallel_pool::global(), first, last, std::move(key));
+	}
+
+	// Sorts integers by value
+	template <std::random_access_iterator ITERATOR>
+		requires std::integral<std::iter_value_t<ITERATOR>>
+	void parallel_radix_sort(parallel_pool &pool, ITERATOR first, ITERATOR last)
+	{
+		parallel_radix_sort(pool, first, last, std::identity{});
+	}
+
+	template <std::random_access_iterator ITERATOR>
+		requires std::integral<std::iter_value_t<ITERATOR>>
+	void parallel_radix_sort(ITERATOR first, ITERATOR last)
+	{
+		parallel_radix_sort(parallel_pool::global(), first, last, std::identity{});
+	}
+}
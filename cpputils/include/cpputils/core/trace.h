@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cpputils/cpputils_api.h>
+#include <cpputils/core/string.h>
+#include <atomic>
+#include <cstdint>
+#include <ostream>
+
+namespace cpputils
+{
+	// trace namespace
+	// Records begin/end/instant events into per thread buffers and exports them as Chrome
+	// trace-event JSON, which opens offline in Perfetto (ui.perfetto.dev) or chrome://tracing.
+	namespace trace
+	{
+		// Static description of a trace callsite, events only carry a pointer to it
+		struct descriptor
+		{
+			// Event name
+			icstring name;
+
+			// Event category
+			icstring category;
+
+			// Source location
+			icstring file;
+			int line;
+		};
+
+		// Kind of trace event
+		enum class event_type : uint8_t
+		{
+			// Duration events, must nest per thread
+			begin,
+			end,
+			// Point in time event
+			instant,
+			// Async events, matched by id across threads
+			async_begin,
+			async_end
+		};
+
+		// Recorded event
+		struct event
+		{
+			// Callsite
+			const descriptor *desc;
+
+			// Optional name overriding the descriptor name, must have static storage
+			icstring name;
+
+			// Nanoseconds since the trace session started
+			uint64_t timestamp;
+
+			// Identifier for async events
+			uint64_t id;
+
+			event_type type;
+		};
+
+		namespace detail
+		{
+			// Whether a session is recording, checked inline so disabled tracing is a single load
+			inline std::atomic<bool> g_enabled{false};
+		}
+
+		// Is tracing enabled
+		inline bool enabled() noexcept
+		{
+			return detail::g_enabled.load(std::memory_order_relaxed);
+		}
+
+		// Starts a new session, discarding previously recorded events
+		// Each thread records into its own buffer of events_per_thread events, events beyond that are dropped
+		CPPUTILS_API void start(size_t events_per_thread = 1 << 16);
+
+		// Stops recording, the events stay available for export
+		CPPUTILS_API void stop();
+
+		// Names the calling thread in the exported trace
+		CPPUTILS_API void set_thread_name(const string &name);
+
+		// Records an event on the calling thread's buffer
+		CPPUTILS_API void emit(const descriptor *desc, event_type type, uint64_t id = 0, icstring name = nullptr) noexcept;
+
+		// Number of events that did not fit in the thread buffers
+		CPPUTILS_API uint64_t dropped_events();
+
+		// Writes the recorded events as Chrome trace-event JSON
+		CPPUTILS_API void write_chrome_json(std::ostream &out);
+
+		// Writes the recorded events as Chrome trace-event JSON to a file
+		CPPUTILS_API void save(const string &path);
+
+		// Class zone: emits a begin event now and the matching end event on destruction
+		class zone
+		{
+		private:
+			const descriptor *m_desc;
+
+		public:
+			zone(const descriptor *desc) noexcept : m_desc(enabled() ? desc : nullptr)
+			{
+				if (m_desc)
+					emit(m_desc, event_type::begin);
+			}
+
+			~zone()
+			{
+				if (m_desc)
+					emit(m_desc, event_type::end);
+			}
+
+			zone(const zone &) = delete;
+			zone &operator=(const zone &) = delete;
+		};
+	}
+
+	// Define trace macros
+#define TRACE_ZONE(name)                                                                                                                       \
+	static constexpr cpputils::trace::descriptor CPPUTILS_CONCAT(cpputils_trace_desc_, __LINE__){name, "zone", __FILE__, __LINE__}; \
+	cpputils::trace::zone CPPUTILS_CONCAT(cpputils_trace_zone_, __LINE__)(&CPPUTILS_CONCAT(cpputils_trace_desc_, __LINE__))
+
+#define TRACE_INSTANT(name)                                                                                                       \
+	do                                                                                                                            \
+	{                                                                                                                             \
+		static constexpr cpputils::trace::descriptor cpputils_trace_desc{name, "instant", __FILE__, __LINE__};                    \
+		if (cpputils::trace::enabled())                                                                                           \
+			cpputils::trace::emit(&cpputils_trace_desc, cpputils::trace::event_type::instant);                                    \
+	} while (0)
+}
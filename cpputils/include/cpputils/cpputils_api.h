@@ -18,4 +18,8 @@
 // Define the version code
 #define CPPUTILS_VERSION_CODE CPPUTILS_VERSION(CPPUTILS_VERSION_MAJOR, CPPUTILS_VERSION_MINOR, CPPUTILS_VERSION_PATCH)
 
+// Define token pasting helpers for macros declaring unique locals
+#define CPPUTILS_CONCAT_IMPL(a, b) a##b
+#define CPPUTILS_CONCAT(a, b) CPPUTILS_CONCAT_IMPL(a, b)
+
 // #define EXPERIMENTAL
\ No newline at end of file
@@ -0,0 +1,354 @@
+#include <cpputils/bench/bench.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace cpputils;
+using namespace cpputils::bench;
+
+namespace
+{
+    struct registered_benchmark
+    {
+        string name;
+        benchmark_func func;
+    };
+
+    array_list<registered_benchmark> &get_registry()
+    {
+        static array_list<registered_benchmark> registry;
+        return registry;
+    }
+
+    // Constant initialized, operator new may run before any dynamic initializer
+    std::atomic<uint64_t> g_allocations{0};
+    std::atomic<bool> g_allocationsCounted{false};
+
+    struct run_result
+    {
+        uint64_t elapsed_ns;
+        uint64_t allocations;
+    };
+
+    // Runs the benchmark once with the given iteration count and returns what the loop cost
+    run_result run_once(const benchmark_func &func, uint64_t iterations)
+    {
+        state s(iterations);
+        func(s);
+        return {s.elapsed_ns(), s.allocations()};
+    }
+
+    double median_of(array_list<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2.0;
+    }
+
+    // Pins the calling thread to a CPU
+    void pin_thread(int cpu)
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            LOG_WARNING("Unable to pin the benchmark thread to cpu {}", cpu);
+#else
+        LOG_WARNING("CPU pinning is not supported on this platform, ignoring cpu {}", cpu);
+#endif
+    }
+
+    // Writes a JSON string literal
+    string json_string(const string &value)
+    {
+        string out = "\"";
+        for (char c : value)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    // Finds "key": in a JSON object and returns the position of its value
+    size_t find_value(const string &object, const string &key)
+    {
+        size_t pos = object.find("\"" + key + "\"");
+        if (pos == string::npos)
+            return pos;
+        pos = object.find(':', pos);
+        if (pos == string::npos)
+            return pos;
+        return object.find_first_not_of(" \t\r\n", pos + 1);
+    }
+}
+
+void cpputils::bench::detail::count_allocation() noexcept
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool cpputils::bench::detail::enable_allocation_counting() noexcept
+{
+    g_allocationsCounted.store(true, std::memory_order_relaxed);
+    return true;
+}
+
+uint64_t cpputils::bench::allocation_count() noexcept
+{
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+bool cpputils::bench::allocations_counted() noexcept
+{
+    return g_allocationsCounted.load(std::memory_order_relaxed);
+}
+
+bool cpputils::bench::register_benchmark(const string &name, benchmark_func func)
+{
+    get_registry().push_back({name, std::move(func)});
+    return true;
+}
+
+// Warms up, calibrates the iteration count and measures the samples
+result cpputils::bench::run_benchmark(const string &name, const benchmark_func &func, const options &options)
+{
+    const uint64_t min_time = std::chrono::duration_cast<chrono::nanoseconds>(options.min_time).count();
+    const uint64_t warmup_time = std::chrono::duration_cast<chrono::nanoseconds>(options.warmup).count();
+
+    // Grow the iteration count until one run takes at least min_time
+    uint64_t iterations = 1;
+    uint64_t elapsed = 0;
+    for (;;)
+    {
+        elapsed = run_once(func, iterations).elapsed_ns;
+        if (elapsed >= min_time || iterations >= (uint64_t(1) << 40))
+            break;
+
+        double factor = elapsed == 0 ? 10.0 : std::clamp(1.4 * min_time / elapsed, 2.0, 10.0);
+        iterations = static_cast<uint64_t>(iterations * factor);
+    }
+
+    // Warm up caches, branch predictors and the allocator
+    for (auto start = chrono::steady_now(); chrono::diff_ns(start, chrono::steady_now()) < warmup_time;)
+        run_once(func, iterations);
+
+    array_list<double> per_iteration;
+    per_iteration.reserve(options.samples);
+    uint64_t allocations = 0;
+    for (uint32_t i = 0; i < std::max(1u, options.samples); i++)
+    {
+        run_result sample = run_once(func, iterations);
+        per_iteration.push_back(static_cast<double>(sample.elapsed_ns) / iterations);
+        allocations += sample.allocations;
+    }
+
+    double median = median_of(per_iteration);
+    array_list<double> deviations;
+    for (double value : per_iteration)
+        deviations.push_back(std::abs(value - median));
+
+    result r;
+    r.name = name;
+    r.iterations = iterations;
+    r.samples = static_cast<uint32_t>(per_iteration.size());
+    r.median_ns = median;
+    r.mad_ns = median_of(deviations);
+    r.min_ns = *std::min_element(per_iteration.begin(), per_iteration.end());
+    if (allocations_counted())
+        r.allocations_per_op = static_cast<double>(allocations) / (static_cast<double>(iterations) * per_iteration.size());
+    return r;
+}
+
+array_list<result> cpputils::bench::run_benchmarks(const options &options)
+{
+    if (options.pin_cpu >= 0)
+        pin_thread(options.pin_cpu);
+
+    tree_map<string, double> baseline;
+    if (!options.baseline.empty())
+        baseline = read_baseline(options.baseline);
+
+    array_list<result> results;
+    for (auto &benchmark : get_registry())
+    {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == string::npos)
+            continue;
+
+        result r = run_benchmark(benchmark.name, benchmark.func, options);
+        auto it = baseline.find(r.name);
+        if (it != baseline.end())
+            r.baseline_median_ns = it->second;
+        results.push_back(r);
+    }
+    return results;
+}
+
+options cpputils::bench::parse_options(int argc, char **argv)
+{
+    options result;
+    for (int i = 1; i < argc; i++)
+    {
+        string arg = argv[i];
+        auto value_of = [&](const string &prefix, string &value)
+        {
+            if (arg.rfind(prefix, 0) != 0)
+                return false;
+            value = arg.substr(prefix.size());
+            return true;
+        };
+
+        string value;
+        if (value_of("--filter=", value))
+            result.filter = value;
+        else if (value_of("--warmup-ms=", value))
+            result.warmup = chrono::milliseconds(std::stoll(value));
+        else if (value_of("--min-time-ms=", value))
+            result.min_time = chrono::milliseconds(std::stoll(value));
+        else if (value_of("--samples=", value))
+            result.samples = static_cast<uint32_t>(std::stoul(value));
+        else if (value_of("--pin=", value))
+            result.pin_cpu = std::stoi(value);
+        else if (value_of("--json=", value))
+            result.json_output = value;
+        else if (value_of("--baseline=", value))
+            result.baseline = value;
+        else
+            throw std::invalid_argument("Unknown benchmark option: " + arg);
+    }
+    return result;
+}
+
+string cpputils::bench::to_json(const array_list<result> &results, const options &options)
+{
+    std::stringstream out;
+    out << "{\n  \"context\": {\"samples\": " << options.samples
+        << ", \"min_time_ms\": " << options.min_time.count()
+        << ", \"warmup_ms\": " << options.warmup.count()
+        << ", \"pin_cpu\": " << options.pin_cpu
+        << ", \"baseline\": " << json_string(options.baseline) << "},\n  \"benchmarks\": [";
+
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const result &r = results[i];
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": " << json_string(r.name)
+            << ", \"iterations\": " << r.iterations
+            << ", \"samples\": " << r.samples
+            << ", \"median_ns\": " << cformat("%.3f", r.median_ns)
+            << ", \"mad_ns\": " << cformat("%.3f", r.mad_ns)
+            << ", \"min_ns\": " << cformat("%.3f", r.min_ns);
+        if (r.allocations_per_op >= 0)
+            out << ", \"allocations_per_op\": " << cformat("%.3f", r.allocations_per_op);
+        if (r.baseline_median_ns >= 0)
+        {
+            out << ", \"baseline_median_ns\": " << cformat("%.3f", r.baseline_median_ns)
+                << ", \"change_pct\": " << cformat("%.2f", 100.0 * (r.median_ns - r.baseline_median_ns) / r.baseline_median_ns);
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+// Reads the benchmark objects back, only the fields written by to_json are understood
+tree_map<string, double> cpputils::bench::read_baseline(const string &path)
+{
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("Unable to open baseline " + path);
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    string text = buffer.str();
+
+    tree_map<string, double> baseline;
+    size_t pos = text.find("\"benchmarks\"");
+    while (pos != string::npos)
+    {
+        size_t begin = text.find('{', pos);
+        size_t end = begin == string::npos ? string::npos : text.find('}', begin);
+        if (end == string::npos)
+            break;
+
+        string object = text.substr(begin, end - begin + 1);
+        size_t name = find_value(object, "name");
+        size_t median = find_value(object, "median_ns");
+        if (name != string::npos && median != string::npos && object[name] == '"')
+        {
+            size_t name_end = object.find('"', name + 1);
+            baseline[object.substr(name + 1, name_end - name - 1)] = std::stod(object.substr(median));
+        }
+        pos = end + 1;
+    }
+    return baseline;
+}
+
+int cpputils::bench::run_main(int argc, char **argv)
+{
+    options options;
+    try
+    {
+        options = parse_options(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    // Cost of the loop itself, every result includes it
+    result overhead = run_benchmark("harness_overhead", [](state &s)
+                                    { for (auto _ : s) clobber_memory(); }, options);
+    std::printf("harness overhead: %.3f ns/iteration\n\n", overhead.median_ns);
+
+    // A missing or malformed baseline file throws
+    array_list<result> results;
+    try
+    {
+        results = run_benchmarks(options);
+    }
+    catch (const std::exception &e)
+    {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    std::printf("%-40s %14s %12s %12s %12s %14s\n", "benchmark", "median ns/op", "mad ns", "min ns", "allocs/op", "iterations");
+    for (auto &r : results)
+    {
+        string allocations = r.allocations_per_op >= 0 ? cformat("%.2f", r.allocations_per_op) : string("-");
+        std::printf("%-40s %14.3f %12.3f %12.3f %12s %14llu", r.name.c_str(), r.median_ns, r.mad_ns, r.min_ns, allocations.c_str(), (unsigned long long)r.iterations);
+        if (r.baseline_median_ns >= 0)
+            std::printf("   %+.2f%% vs baseline", 100.0 * (r.median_ns - r.baseline_median_ns) / r.baseline_median_ns);
+        std::printf("\n");
+    }
+
+    if (!options.json_output.empty())
+    {
+        std::ofstream file(options.json_output);
+        if (!file)
+        {
+            std::fprintf(stderr, "Unable to write %s\n", options.json_output.c_str());
+            return 1;
+        }
+        file << to_json(results, options);
+    }
+    else if (!options.baseline.empty())
+    {
+        // A comparison is only useful in machine readable form
+        std::printf("\n%s", to_json(results, options).c_str());
+    }
+    return 0;
+}
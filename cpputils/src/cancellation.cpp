@@ -0,0 +1,242 @@
+#include <cpputils/asyncio/cancellation.h>
+
+using namespace cpputils;
+using namespace cpputils::asyncio;
+using namespace cpputils::asyncio::detail;
+
+namespace
+{
+    // Slots of the first chunk, every new chunk doubles
+    constexpr size_t initial_chunk_size = 8;
+}
+
+cancellation_state::~cancellation_state()
+{
+    chunk *current = m_chunks.load(std::memory_order_relaxed);
+    while (current != nullptr)
+    {
+        chunk *next = current->m_next;
+        delete current;
+        current = next;
+    }
+}
+
+void cancellation_state::add_token_ref() noexcept
+{
+    m_references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void cancellation_state::release_token_ref() noexcept
+{
+    release();
+}
+
+void cancellation_state::add_source_ref() noexcept
+{
+    m_sources.fetch_add(1, std::memory_order_relaxed);
+    m_references.fetch_add(1, std::memory_order_relaxed);
+}
+
+void cancellation_state::release_source_ref() noexcept
+{
+    m_sources.fetch_sub(1, std::memory_order_acq_rel);
+    release();
+}
+
+void cancellation_state::release() noexcept
+{
+    if (m_references.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete this;
+}
+
+bool cancellation_state::can_be_cancelled() const noexcept
+{
+    return m_sources.load(std::memory_order_acquire) != 0 || is_cancellation_requested();
+}
+
+bool cancellation_state::is_cancellation_requested() const noexcept
+{
+    return m_cancelled.load(std::memory_order_acquire) != not_requested;
+}
+
+void cancellation_state::request_cancellation()
+{
+    int expected = not_requested;
+    if (!m_cancelled.compare_exchange_strong(expected, notifying, std::memory_order_seq_cst))
+        return;
+
+    m_notifyingThread = std::this_thread::get_id();
+    for (chunk *current = m_chunks.load(std::memory_order_seq_cst); current != nullptr; current = current->m_next)
+    {
+        for (size_t i = 0; i < current->m_size; i++)
+        {
+            std::atomic<cancellation_registration *> &slot = current->m_slots[i];
+            cancellation_registration *registration = slot.load(std::memory_order_seq_cst);
+            if (registration == nullptr)
+                continue;
+
+            // Published before taking the slot, a deregistration losing the slot to us then waits on it
+            m_running.store(registration, std::memory_order_seq_cst);
+            if (slot.compare_exchange_strong(registration, nullptr, std::memory_order_acq_rel))
+            {
+                // The registration may be destroyed by its own callback, don't touch it afterwards
+                registration->m_callback();
+            }
+            m_running.store(nullptr, std::memory_order_release);
+            m_running.notify_all();
+        }
+    }
+
+    m_cancelled.store(notified, std::memory_order_release);
+}
+
+bool cancellation_state::try_register(cancellation_registration *registration)
+{
+    if (is_cancellation_requested())
+        return false;
+
+    std::atomic<cancellation_registration *> *claimed = nullptr;
+    chunk *head = m_chunks.load(std::memory_order_acquire);
+    for (chunk *current = head; current != nullptr && claimed == nullptr; current = current->m_next)
+    {
+        for (size_t i = 0; i < current->m_size; i++)
+        {
+            cancellation_registration *expected = nullptr;
+            std::atomic<cancellation_registration *> &slot = current->m_slots[i];
+            if (slot.load(std::memory_order_relaxed) == nullptr && slot.compare_exchange_strong(expected, registration, std::memory_order_seq_cst))
+            {
+                claimed = &slot;
+                break;
+            }
+        }
+    }
+
+    if (claimed == nullptr)
+    {
+        // Every slot is taken, publish a bigger chunk holding the registration
+        chunk *fresh = new chunk(head != nullptr ? head->m_size * 2 : initial_chunk_size);
+        fresh->m_slots[0].store(registration, std::memory_order_relaxed);
+        claimed = &fresh->m_slots[0];
+        do
+        {
+            fresh->m_next = head;
+        } while (!m_chunks.compare_exchange_weak(head, fresh, std::memory_order_seq_cst, std::memory_order_acquire));
+    }
+    registration->m_slot = claimed;
+
+    // request_cancellation() may have passed the slot before it was claimed
+    if (is_cancellation_requested())
+    {
+        cancellation_registration *expected = registration;
+        if (claimed->compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel))
+        {
+            registration->m_slot = nullptr;
+            return false;
+        }
+    }
+    return true;
+}
+
+void cancellation_state::deregister(cancellation_registration *registration) noexcept
+{
+    cancellation_registration *expected = registration;
+    if (registration->m_slot->compare_exchange_strong(expected, nullptr, std::memory_order_acq_rel))
+        return;
+
+    // request_cancellation() took the slot, wait until the callback returned unless we're inside it
+    if (m_notifyingThread == std::this_thread::get_id())
+        return;
+    while (m_running.load(std::memory_order_acquire) == registration)
+        m_running.wait(registration, std::memory_order_acquire);
+}
+
+cancellation_token::cancellation_token(cancellation_state *state) noexcept : m_state(state)
+{
+    if (m_state != nullptr)
+        m_state->add_token_ref();
+}
+
+cancellation_token::cancellation_token(const cancellation_token &other) noexcept : cancellation_token(other.m_state)
+{
+}
+
+cancellation_token::~cancellation_token()
+{
+    if (m_state != nullptr)
+        m_state->release_token_ref();
+}
+
+cancellation_token &cancellation_token::operator=(const cancellation_token &other) noexcept
+{
+    cancellation_token copy(other);
+    swap(copy);
+    return *this;
+}
+
+cancellation_token &cancellation_token::operator=(cancellation_token &&other) noexcept
+{
+    cancellation_token moved(std::move(other));
+    swap(moved);
+    return *this;
+}
+
+cancellation_source::cancellation_source() : m_state(cancellation_state::create())
+{
+}
+
+cancellation_source::cancellation_source(const cancellation_source &other) noexcept : m_state(other.m_state)
+{
+    if (m_state != nullptr)
+        m_state->add_source_ref();
+}
+
+cancellation_source::~cancellation_source()
+{
+    if (m_state != nullptr)
+        m_state->release_source_ref();
+}
+
+cancellation_source &cancellation_source::operator=(const cancellation_source &other) noexcept
+{
+    cancellation_source copy(other);
+    std::swap(m_state, copy.m_state);
+    return *this;
+}
+
+cancellation_source &cancellation_source::operator=(cancellation_source &&other) noexcept
+{
+    cancellation_source moved(std::move(other));
+    std::swap(m_state, moved.m_state);
+    return *this;
+}
+
+void cancellation_source::request_cancellation()
+{
+    if (m_state != nullptr)
+        m_state->request_cancellation();
+}
+
+void cancellation_registration::register_callback(cancellation_token &&token)
+{
+    cancellation_state *state = token.m_state;
+    if (state == nullptr || !state->can_be_cancelled())
+        return;
+
+    if (!state->try_register(this))
+    {
+        m_callback();
+        return;
+    }
+
+    // Keep the token's reference for the registration's lifetime
+    m_state = std::exchange(token.m_state, nullptr);
+}
+
+cancellation_registration::~cancellation_registration()
+{
+    if (m_state != nullptr)
+    {
+        m_state->deregister(this);
+        m_state->release_token_ref();
+    }
+}
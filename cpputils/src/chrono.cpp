@@ -8,4 +8,14 @@ cpputils::chrono::time_point cpputils::chrono::now()
 double cpputils::chrono::diff(const cpputils::chrono::time_point &start, const cpputils::chrono::time_point &end)
 {
     return std::chrono::duration_cast<duration>(end - start).count();
+}
+
+cpputils::chrono::steady_time_point cpputils::chrono::steady_now()
+{
+    return std::chrono::steady_clock::now();
+}
+
+uint64_t cpputils::chrono::diff_ns(const cpputils::chrono::steady_time_point &start, const cpputils::chrono::steady_time_point &end)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<nanoseconds>(end - start).count());
 }
\ No newline at end of file
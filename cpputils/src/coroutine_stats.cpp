@@ -0,0 +1,202 @@
+#include <cpputils/asyncio/coroutine_stats.h>
+#include <cpputils/core/format.h>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <unordered_map>
+
+using namespace cpputils;
+using namespace cpputils::asyncio;
+
+namespace
+{
+    // A source location, the compiler hands out one function name per function
+    struct site_key
+    {
+        const char *function;
+        const char *file;
+        uint32_t line;
+
+        bool operator==(const site_key &other) const noexcept
+        {
+            return function == other.function && file == other.file && line == other.line;
+        }
+    };
+
+    struct site_key_hash
+    {
+        size_t operator()(const site_key &key) const noexcept
+        {
+            return std::hash<const void *>{}(key.function) ^ (size_t(key.line) * 0x9e3779b97f4a7c15ull);
+        }
+    };
+
+    using site_table = std::unordered_map<site_key, coroutine_stats::entry, site_key_hash>;
+
+    void merge_into(site_table &table, const site_key &key, const coroutine_stats::entry &totals)
+    {
+        coroutine_stats::entry &merged = table[key];
+        merged.completions += totals.completions;
+        merged.resumes += totals.resumes;
+        merged.running_ns += totals.running_ns;
+        merged.suspended_ns += totals.suspended_ns;
+        merged.waits += totals.waits;
+        merged.waiting_ns += totals.waiting_ns;
+    }
+
+    // Entries recorded by a single thread
+    // Only the owning thread writes, the mutex is taken against reports and resets.
+    struct thread_table
+    {
+        std::mutex mutex;
+        site_table sites;
+    };
+
+    // Tables of the running threads plus the totals of the threads that exited
+    struct stats_registry
+    {
+        std::mutex mutex;
+        array_list<thread_table *> tables;
+        site_table retired;
+    };
+
+    stats_registry &get_registry()
+    {
+        static stats_registry instance;
+        return instance;
+    }
+
+    // Registers the calling thread's table on first use and retires it when the thread exits
+    struct thread_table_owner
+    {
+        thread_table table;
+
+        thread_table_owner()
+        {
+            stats_registry &registry = get_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            registry.tables.push_back(&table);
+        }
+
+        ~thread_table_owner()
+        {
+            stats_registry &registry = get_registry();
+            std::lock_guard<std::mutex> lock(registry.mutex);
+            for (auto &[key, totals] : table.sites)
+                merge_into(registry.retired, key, totals);
+            registry.tables.erase(std::find(registry.tables.begin(), registry.tables.end(), &table));
+        }
+    };
+
+    thread_local thread_table_owner t_table;
+
+    uint64_t sort_key(const coroutine_stats::entry &entry, coroutine_stats::order by)
+    {
+        switch (by)
+        {
+        case coroutine_stats::order::suspended:
+            return entry.suspended_ns;
+        case coroutine_stats::order::resumes:
+            return entry.resumes;
+        case coroutine_stats::order::waiting:
+            return entry.waiting_ns;
+        default:
+            return entry.running_ns;
+        }
+    }
+}
+
+void cpputils::asyncio::coroutine_stats::detail::record(const std::source_location &location, uint64_t completions, uint64_t resumes,
+                                                        uint64_t runningNs, uint64_t suspendedNs) noexcept
+{
+    site_key key{location.function_name(), location.file_name(), location.line()};
+    std::lock_guard<std::mutex> lock(t_table.table.mutex);
+    entry &totals = t_table.table.sites[key];
+    totals.completions += completions;
+    totals.resumes += resumes;
+    totals.running_ns += runningNs;
+    totals.suspended_ns += suspendedNs;
+}
+
+void cpputils::asyncio::coroutine_stats::detail::record_wait(const std::source_location &location, uint64_t waitingNs) noexcept
+{
+    site_key key{location.function_name(), location.file_name(), location.line()};
+    std::lock_guard<std::mutex> lock(t_table.table.mutex);
+    entry &totals = t_table.table.sites[key];
+    totals.waits++;
+    totals.waiting_ns += waitingNs;
+}
+
+// Merges the thread tables, sites of the same function seen through different pointers end up in one entry
+array_list<coroutine_stats::entry> cpputils::asyncio::coroutine_stats::top(size_t count, order by)
+{
+    site_table sites;
+    {
+        stats_registry &registry = get_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        sites = registry.retired;
+        for (thread_table *table : registry.tables)
+        {
+            std::lock_guard<std::mutex> tableLock(table->mutex);
+            for (auto &[key, totals] : table->sites)
+                merge_into(sites, key, totals);
+        }
+    }
+
+    array_list<entry> entries;
+    hash_map<string, size_t> indices;
+    for (auto &[key, totals] : sites)
+    {
+        string name = cformat("%s:%s:%u", key.function, key.file, key.line);
+        auto [it, inserted] = indices.try_emplace(name, entries.size());
+        if (inserted)
+        {
+            entries.push_back(totals);
+            entries.back().function = key.function;
+            entries.back().file = key.file;
+            entries.back().line = key.line;
+            continue;
+        }
+
+        entry &merged = entries[it->second];
+        merged.completions += totals.completions;
+        merged.resumes += totals.resumes;
+        merged.running_ns += totals.running_ns;
+        merged.suspended_ns += totals.suspended_ns;
+        merged.waits += totals.waits;
+        merged.waiting_ns += totals.waiting_ns;
+    }
+
+    count = std::min(count, entries.size());
+    std::partial_sort(entries.begin(), entries.begin() + count, entries.end(), [by](const entry &a, const entry &b)
+                      { return sort_key(a, by) > sort_key(b, by); });
+    entries.resize(count);
+    return entries;
+}
+
+string cpputils::asyncio::coroutine_stats::report(size_t count, order by)
+{
+    std::stringstream out;
+    out << cformat("%12s %12s %14s %14s %10s %14s  %s\n", "completions", "resumes", "running ms", "suspended ms",
+                   "waits", "waiting ms", "function");
+    for (const entry &e : top(count, by))
+    {
+        out << cformat("%12lu %12lu %14.3f %14.3f %10lu %14.3f  %s (%s:%u)\n", e.completions, e.resumes,
+                       e.running_ns / 1e6, e.suspended_ns / 1e6, e.waits, e.waiting_ns / 1e6, e.function.c_str(),
+                       e.file.c_str(), e.line);
+    }
+    return out.str();
+}
+
+void cpputils::asyncio::coroutine_stats::reset()
+{
+    stats_registry &registry = get_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.retired.clear();
+    for (thread_table *table : registry.tables)
+    {
+        std::lock_guard<std::mutex> tableLock(table->mutex);
+        table->sites.clear();
+    }
+}
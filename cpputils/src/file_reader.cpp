@@ -0,0 +1,334 @@
+#include <cpputils/asyncio/file_reader.h>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <system_error>
+
+using namespace cpputils;
+using namespace cpputils::asyncio;
+
+// Descriptor shared by the reader and the reads in flight, closed once the last of them is gone
+struct cpputils::asyncio::detail::file_handle
+{
+    int fd = -1;
+    uint64_t size = 0;
+    bool direct = false;
+
+    ~file_handle()
+    {
+        if (fd >= 0)
+            ::close(fd);
+    }
+};
+
+namespace
+{
+    // Buffer aligned to the block size
+    struct aligned_buffer_deleter
+    {
+        void operator()(char *buffer) const noexcept
+        {
+            ::operator delete[](buffer, std::align_val_t(async_file_reader::block_size));
+        }
+    };
+
+    using aligned_buffer = std::unique_ptr<char[], aligned_buffer_deleter>;
+
+    // A buffer and the read filling it, from offset for length bytes
+    struct read_slot
+    {
+        aligned_buffer data;
+        uint64_t offset = 0;
+        size_t length = 0;
+        int64_t result = 0;
+        std::exception_ptr error;
+        async_manual_reset_event ready;
+    };
+
+    // Buffers of one generator, shared with its reads in flight so that a dropped generator leaves
+    // them something to complete into
+    struct read_pipeline
+    {
+        io_context &context;
+        std::shared_ptr<asyncio::detail::file_handle> file;
+        size_t bufferSize;
+        uref<read_slot[]> slots;
+        uint32_t slotCount;
+        uint64_t nextOffset = 0;
+
+        read_pipeline(io_context &context, std::shared_ptr<asyncio::detail::file_handle> file, size_t bufferSize, uint32_t slotCount)
+            : context(context), file(std::move(file)), bufferSize(bufferSize),
+              slots(std::make_unique<read_slot[]>(slotCount)), slotCount(slotCount)
+        {
+            for (uint32_t i = 0; i < slotCount; i++)
+                slots[i].data.reset(new (std::align_val_t(async_file_reader::block_size)) char[bufferSize]);
+        }
+    };
+
+    asyncio::detail::detached_task fill(std::shared_ptr<read_pipeline> pipeline, read_slot &slot)
+    {
+        try
+        {
+            slot.result = static_cast<int64_t>(co_await pipeline->context.read(pipeline->file->fd, slot.data.get(), slot.length, static_cast<int64_t>(slot.offset)));
+        }
+        catch (...)
+        {
+            slot.error = std::current_exception();
+        }
+        slot.ready.set();
+    }
+
+    // Starts the read of the next block of the file into slot
+    void issue(const std::shared_ptr<read_pipeline> &pipeline, read_slot &slot)
+    {
+        const uint64_t offset = pipeline->nextOffset;
+        pipeline->nextOffset += pipeline->bufferSize;
+        slot.offset = offset;
+        slot.length = pipeline->bufferSize;
+        if (offset >= pipeline->file->size && offset > 0)
+        {
+            // Past the end, nothing to wait for
+            slot.result = 0;
+            slot.ready.set();
+            return;
+        }
+
+        // Ask the kernel to prefetch the window past the reads in flight
+        if (!pipeline->file->direct)
+            ::posix_fadvise(pipeline->file->fd, static_cast<off_t>(pipeline->nextOffset), static_cast<off_t>(pipeline->bufferSize), POSIX_FADV_WILLNEED);
+
+        slot.ready.reset();
+        fill(pipeline, slot);
+    }
+
+    // Cuts records of a known size out of consecutive chunks, copying only those split between two
+    class record_cutter
+    {
+    public:
+        // Sets record to the next size bytes from pos, false when the chunk ran out first
+        // A record returned from the carry stays valid until release().
+        bool next(std::string_view chunk, size_t &pos, size_t size, std::string_view &record)
+        {
+            if (m_carry.empty() && chunk.size() - pos >= size)
+            {
+                record = chunk.substr(pos, size);
+                pos += size;
+                return true;
+            }
+
+            const size_t take = std::min(size - m_carry.size(), chunk.size() - pos);
+            m_carry.append(chunk.substr(pos, take));
+            pos += take;
+            if (m_carry.size() < size)
+                return false;
+            record = m_carry;
+            return true;
+        }
+
+        void release() noexcept
+        {
+            m_carry.clear();
+        }
+
+        bool pending() const noexcept
+        {
+            return !m_carry.empty();
+        }
+
+    private:
+        std::string m_carry;
+    };
+
+    uint64_t decode_length(std::string_view prefix, std::endian order) noexcept
+    {
+        uint64_t length = 0;
+        for (size_t i = 0; i < prefix.size(); i++)
+        {
+            const size_t byte = order == std::endian::little ? i : prefix.size() - 1 - i;
+            length |= uint64_t(static_cast<unsigned char>(prefix[byte])) << (8 * i);
+        }
+        return length;
+    }
+}
+
+async_file_reader::async_file_reader(io_context &context, const string &path, file_reader_options options)
+    : m_context(context), m_options(options), m_file(std::make_shared<asyncio::detail::file_handle>())
+{
+    m_options.buffer_size = std::max<size_t>((options.buffer_size + block_size - 1) / block_size, 1) * block_size;
+    m_options.buffer_count = std::max<uint32_t>(options.buffer_count, 2);
+
+    int fd = -1;
+    if (options.direct)
+    {
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+        m_file->direct = fd >= 0;
+    }
+    if (fd < 0)
+        fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        throw std::system_error(errno, std::system_category(), "open " + path);
+    m_file->fd = fd;
+
+    struct stat status;
+    if (::fstat(fd, &status) != 0)
+        throw std::system_error(errno, std::system_category(), "fstat " + path);
+    m_file->size = static_cast<uint64_t>(status.st_size);
+
+    // Doubles the kernel's read-ahead window on the page cache path
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+uint64_t async_file_reader::size() const noexcept
+{
+    return m_file->size;
+}
+
+bool async_file_reader::direct() const noexcept
+{
+    return m_file->direct;
+}
+
+// Reads up to the size the file had when it was opened, or until a read comes back empty
+// A short read before that reads the rest of its block into the same slot before moving on, the
+// reads issued past the end complete empty.
+async_generator<std::string_view> async_file_reader::chunks()
+{
+    auto pipeline = std::make_shared<read_pipeline>(m_context, m_file, m_options.buffer_size, m_options.buffer_count);
+    for (uint32_t i = 0; i < pipeline->slotCount; i++)
+        issue(pipeline, pipeline->slots[i]);
+
+    for (uint64_t chunk = 0;;)
+    {
+        read_slot &slot = pipeline->slots[chunk % pipeline->slotCount];
+        co_await slot.ready;
+        if (slot.error)
+            std::rethrow_exception(slot.error);
+
+        const size_t bytes = static_cast<size_t>(slot.result);
+        if (bytes > 0)
+            co_yield std::string_view(slot.data.get(), bytes);
+
+        const uint64_t end = slot.offset + bytes;
+        if (bytes == 0 || end >= pipeline->file->size)
+            break;
+
+        // The consumer is done with the buffer
+        if (bytes < slot.length)
+        {
+            slot.offset = end;
+            slot.length -= bytes;
+            slot.ready.reset();
+            fill(pipeline, slot);
+            continue;
+        }
+        issue(pipeline, slot);
+        chunk++;
+    }
+}
+
+async_generator<std::string_view> async_file_reader::lines()
+{
+    auto source = chunks();
+    std::string carry;
+    for (auto it = co_await source.begin(); it != source.end(); co_await ++it)
+    {
+        std::string_view chunk = *it;
+        size_t pos = 0;
+        if (!carry.empty())
+        {
+            const size_t newline = chunk.find('\n');
+            if (newline == std::string_view::npos)
+            {
+                carry.append(chunk);
+                continue;
+            }
+            carry.append(chunk.substr(0, newline));
+            co_yield std::string_view(carry);
+            carry.clear();
+            pos = newline + 1;
+        }
+
+        for (size_t newline = chunk.find('\n', pos); newline != std::string_view::npos; newline = chunk.find('\n', pos))
+        {
+            co_yield chunk.substr(pos, newline - pos);
+            pos = newline + 1;
+        }
+        carry.assign(chunk.substr(pos));
+    }
+
+    if (!carry.empty())
+        co_yield std::string_view(carry);
+}
+
+async_generator<std::string_view> async_file_reader::fixed_records(size_t length)
+{
+    if (length == 0)
+        throw std::invalid_argument("Fixed length records cannot be empty");
+
+    auto source = chunks();
+    record_cutter cutter;
+    for (auto it = co_await source.begin(); it != source.end(); co_await ++it)
+    {
+        std::string_view chunk = *it;
+        size_t pos = 0;
+        std::string_view record;
+        while (pos < chunk.size() && cutter.next(chunk, pos, length, record))
+        {
+            co_yield record;
+            cutter.release();
+        }
+    }
+
+    if (cutter.pending())
+        throw std::runtime_error("File ends inside a fixed length record");
+}
+
+async_generator<std::string_view> async_file_reader::length_prefixed(uint32_t prefix_bytes, std::endian order)
+{
+    if (prefix_bytes != 1 && prefix_bytes != 2 && prefix_bytes != 4 && prefix_bytes != 8)
+        throw std::invalid_argument("Length prefixes are 1, 2, 4 or 8 bytes long");
+    return length_prefixed_records(prefix_bytes, order);
+}
+
+async_generator<std::string_view> async_file_reader::length_prefixed_records(uint32_t prefix_bytes, std::endian order)
+{
+    auto source = chunks();
+    record_cutter cutter;
+    bool haveLength = false;
+    uint64_t length = 0;
+    for (auto it = co_await source.begin(); it != source.end(); co_await ++it)
+    {
+        std::string_view chunk = *it;
+        size_t pos = 0;
+        std::string_view record;
+        while (pos < chunk.size() || (haveLength && length == 0))
+        {
+            if (!haveLength)
+            {
+                if (!cutter.next(chunk, pos, prefix_bytes, record))
+                    break;
+                length = decode_length(record, order);
+                cutter.release();
+                haveLength = true;
+            }
+
+            if (!cutter.next(chunk, pos, length, record))
+                break;
+            haveLength = false;
+            co_yield record;
+            cutter.release();
+        }
+    }
+
+    if (haveLength || cutter.pending())
+        throw std::runtime_error("File ends inside a length prefixed record");
+}
+#endif
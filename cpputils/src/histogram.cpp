@@ -0,0 +1,263 @@
+#include <cpputils/core/histogram.h>
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace cpputils;
+
+// Serialization header and version
+static constexpr char histogram_magic[] = {'H', 'D', 'R', 1};
+
+// Writes an unsigned LEB128 varint
+static void write_varint(string &out, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        out.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+// Reads an unsigned LEB128 varint
+static uint64_t read_varint(const string &in, size_t &pos)
+{
+    uint64_t value = 0;
+    for (uint32_t shift = 0; shift < 64; shift += 7)
+    {
+        if (pos >= in.size())
+            throw std::runtime_error("Truncated histogram data");
+
+        uint8_t byte = static_cast<uint8_t>(in[pos++]);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return value;
+    }
+    throw std::runtime_error("Invalid varint in histogram data");
+}
+
+// Zigzag encoding so that negative zero-run lengths stay small
+static uint64_t zigzag_encode(int64_t value)
+{
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t zigzag_decode(uint64_t value)
+{
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+histogram::histogram(uint32_t precision, uint64_t max_value)
+    : m_precision(precision), m_maxValue(max_value)
+{
+    if (precision < 2 || precision > 16)
+        throw std::invalid_argument("Histogram precision must be between 2 and 16 bits");
+
+    m_linearLimit = uint64_t(1) << precision;
+    m_bucketCount = index_of(max_value) + 1;
+    m_counts = std::make_unique<std::atomic<uint64_t>[]>(m_bucketCount);
+    reset();
+}
+
+histogram::histogram(const histogram &other)
+    : m_precision(other.m_precision), m_maxValue(other.m_maxValue), m_linearLimit(other.m_linearLimit), m_bucketCount(other.m_bucketCount)
+{
+    m_counts = std::make_unique<std::atomic<uint64_t>[]>(m_bucketCount);
+    for (size_t i = 0; i < m_bucketCount; i++)
+        m_counts[i].store(other.m_counts[i].load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_totalCount.store(other.m_totalCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_sum.store(other.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+histogram &histogram::operator=(const histogram &other)
+{
+    if (this != &other)
+    {
+        histogram copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+histogram::histogram(histogram &&other) noexcept
+    : m_precision(other.m_precision), m_maxValue(other.m_maxValue), m_linearLimit(other.m_linearLimit), m_bucketCount(other.m_bucketCount), m_counts(std::move(other.m_counts))
+{
+    m_totalCount.store(other.m_totalCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_sum.store(other.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    other.m_bucketCount = 0;
+}
+
+histogram &histogram::operator=(histogram &&other) noexcept
+{
+    if (this != &other)
+    {
+        m_precision = other.m_precision;
+        m_maxValue = other.m_maxValue;
+        m_linearLimit = other.m_linearLimit;
+        m_bucketCount = other.m_bucketCount;
+        m_counts = std::move(other.m_counts);
+        m_totalCount.store(other.m_totalCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        m_sum.store(other.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        other.m_bucketCount = 0;
+    }
+    return *this;
+}
+
+// Merges the counts of another histogram
+void histogram::merge(const histogram &other)
+{
+    if (other.m_precision != m_precision || other.m_maxValue != m_maxValue)
+        throw std::invalid_argument("Cannot merge histograms with different configurations");
+
+    for (size_t i = 0; i < m_bucketCount; i++)
+    {
+        uint64_t count = other.m_counts[i].load(std::memory_order_relaxed);
+        if (count != 0)
+            m_counts[i].fetch_add(count, std::memory_order_relaxed);
+    }
+    m_totalCount.fetch_add(other.m_totalCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    m_sum.fetch_add(other.m_sum.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+// Clears the counts
+void histogram::reset() noexcept
+{
+    for (size_t i = 0; i < m_bucketCount; i++)
+        m_counts[i].store(0, std::memory_order_relaxed);
+    m_totalCount.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+}
+
+uint64_t histogram::lowest_value_of(size_t index) const noexcept
+{
+    if (index < m_linearLimit)
+        return index;
+
+    const size_t shift = (index >> (m_precision - 1)) - 1;
+    const uint64_t sub = index - (shift << (m_precision - 1));
+    return sub << shift;
+}
+
+uint64_t histogram::highest_value_of(size_t index) const noexcept
+{
+    if (index < m_linearLimit)
+        return index;
+
+    const size_t shift = (index >> (m_precision - 1)) - 1;
+    const uint64_t highest = lowest_value_of(index) + ((uint64_t(1) << shift) - 1);
+    return std::min(highest, m_maxValue);
+}
+
+uint64_t histogram::min() const noexcept
+{
+    for (size_t i = 0; i < m_bucketCount; i++)
+    {
+        if (m_counts[i].load(std::memory_order_relaxed) != 0)
+            return lowest_value_of(i);
+    }
+    return 0;
+}
+
+uint64_t histogram::max() const noexcept
+{
+    for (size_t i = m_bucketCount; i > 0; i--)
+    {
+        if (m_counts[i - 1].load(std::memory_order_relaxed) != 0)
+            return highest_value_of(i - 1);
+    }
+    return 0;
+}
+
+double histogram::mean() const noexcept
+{
+    uint64_t total = count();
+    if (total == 0)
+        return 0.0;
+    return static_cast<double>(m_sum.load(std::memory_order_relaxed)) / static_cast<double>(total);
+}
+
+// Walks the buckets until the requested rank is reached
+uint64_t histogram::value_at_quantile(double quantile) const noexcept
+{
+    // Sum the buckets rather than trusting the total, recorders may be running concurrently
+    uint64_t total = 0;
+    for (size_t i = 0; i < m_bucketCount; i++)
+        total += m_counts[i].load(std::memory_order_relaxed);
+    if (total == 0)
+        return 0;
+
+    quantile = std::clamp(quantile, 0.0, 1.0);
+    uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total)));
+    rank = std::clamp<uint64_t>(rank, 1, total);
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < m_bucketCount; i++)
+    {
+        seen += m_counts[i].load(std::memory_order_relaxed);
+        if (seen >= rank)
+            return highest_value_of(i);
+    }
+    return max();
+}
+
+// Format: magic, precision, max value, total count, sum, then the buckets up to the last
+// non empty one. Positive entries are counts, negative entries are runs of empty buckets.
+string histogram::serialize() const
+{
+    string out(histogram_magic, sizeof(histogram_magic));
+    write_varint(out, m_precision);
+    write_varint(out, m_maxValue);
+    write_varint(out, m_totalCount.load(std::memory_order_relaxed));
+    write_varint(out, m_sum.load(std::memory_order_relaxed));
+
+    int64_t zeros = 0;
+    for (size_t i = 0; i < m_bucketCount; i++)
+    {
+        uint64_t count = m_counts[i].load(std::memory_order_relaxed);
+        if (count == 0)
+        {
+            zeros++;
+            continue;
+        }
+
+        if (zeros != 0)
+        {
+            write_varint(out, zigzag_encode(-zeros));
+            zeros = 0;
+        }
+        write_varint(out, zigzag_encode(static_cast<int64_t>(count)));
+    }
+    return out;
+}
+
+histogram histogram::deserialize(const string &data)
+{
+    if (data.size() < sizeof(histogram_magic) || !std::equal(histogram_magic, histogram_magic + sizeof(histogram_magic), data.begin()))
+        throw std::runtime_error("Invalid histogram header");
+
+    size_t pos = sizeof(histogram_magic);
+    uint64_t precision = read_varint(data, pos);
+    uint64_t max_value = read_varint(data, pos);
+    if (precision < 2 || precision > 16)
+        throw std::runtime_error("Invalid histogram precision");
+
+    histogram result(static_cast<uint32_t>(precision), max_value);
+    result.m_totalCount.store(read_varint(data, pos), std::memory_order_relaxed);
+    result.m_sum.store(read_varint(data, pos), std::memory_order_relaxed);
+
+    size_t index = 0;
+    while (pos < data.size())
+    {
+        int64_t entry = zigzag_decode(read_varint(data, pos));
+        if (entry < 0)
+        {
+            index += static_cast<size_t>(-entry);
+            continue;
+        }
+
+        if (index >= result.m_bucketCount)
+            throw std::runtime_error("Histogram data exceeds bucket range");
+        result.m_counts[index++].store(static_cast<uint64_t>(entry), std::memory_order_relaxed);
+    }
+    return result;
+}
@@ -0,0 +1,815 @@
+#include <cpputils/asyncio/io_context.h>
+
+#if defined(__linux__)
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <system_error>
+#include <unordered_map>
+
+using namespace cpputils;
+using namespace cpputils::asyncio;
+
+namespace
+{
+    // Throws the errno of a failed system call
+    [[noreturn]] void throw_errno(const char *what)
+    {
+        throw std::system_error(errno, std::system_category(), what);
+    }
+
+    // Operations waiting for the descriptor to become readable, the others wait for writable
+    bool waits_readable(io_opcode opcode) noexcept
+    {
+        return opcode == io_opcode::read || opcode == io_opcode::readv || opcode == io_opcode::recv || opcode == io_opcode::accept;
+    }
+
+    // user_data of the read keeping the wake eventfd armed, operations are never null
+    constexpr uint64_t wake_tag = 0;
+
+    // user_data of the cancel requests, whose completions carry nothing to resume
+    constexpr uint64_t cancel_tag = 1;
+}
+
+// io_uring through the raw system calls
+// The submission array maps slot i to sqe i once at setup, after that submitting is writing the
+// sqe at the local tail and publishing the tail. Queued sqes reach the kernel in one io_uring_enter
+// per reactor poll, or earlier when the submission ring fills up. Completions go onto the context's
+// ready list, also from get_sqe() when the kernel refuses submissions until the completion ring is
+// drained.
+class io_context::uring
+{
+public:
+    explicit uring(io_context *context) noexcept : m_context(*context) {}
+
+    // Returns null if io_uring is unavailable or too old to offer fast poll on sockets and pipes
+    static uref<uring> create(io_context &context, uint32_t entries)
+    {
+        io_uring_params params{};
+        params.flags = IORING_SETUP_CQSIZE;
+        params.cq_entries = entries * 4;
+        int fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd < 0)
+            return nullptr;
+
+        auto ring = make_uref<uring>(&context);
+        ring->m_fd = fd;
+        if ((params.features & IORING_FEAT_FAST_POLL) == 0 || !ring->map(params))
+            return nullptr;
+        return ring;
+    }
+
+    ~uring()
+    {
+        if (m_sqes != nullptr)
+            munmap(m_sqes, m_sqesSize);
+        if (m_cqRing != nullptr && m_cqRing != m_sqRing)
+            munmap(m_cqRing, m_cqRingSize);
+        if (m_sqRing != nullptr)
+            munmap(m_sqRing, m_sqRingSize);
+        if (m_fd >= 0)
+            close(m_fd);
+    }
+
+    // Next free submission entry, cleared, submits the queued ones when the ring is full
+    io_uring_sqe *get_sqe()
+    {
+        while (m_sqTail - std::atomic_ref<uint32_t>(*m_sqHead).load(std::memory_order_acquire) >= m_sqEntries)
+        {
+            // Refused while the completion ring is full, draining it lets the next enter through
+            if (!enter(0))
+                reap();
+        }
+
+        io_uring_sqe *sqe = &m_sqes[m_sqTail & m_sqMask];
+        std::memset(sqe, 0, sizeof(*sqe));
+        m_sqTail++;
+        std::atomic_ref<uint32_t>(*m_sqTailShared).store(m_sqTail, std::memory_order_release);
+        m_queued++;
+        return sqe;
+    }
+
+    // Submits the queued entries and waits for at least waitCount completions
+    // Returns false if the kernel wants the completion ring drained first.
+    bool enter(uint32_t waitCount)
+    {
+        if (m_queued == 0 && waitCount == 0)
+            return true;
+
+        for (;;)
+        {
+            unsigned flags = waitCount > 0 ? IORING_ENTER_GETEVENTS : 0;
+            int submitted = static_cast<int>(syscall(__NR_io_uring_enter, m_fd, m_queued, waitCount, flags, nullptr, 0));
+            if (submitted >= 0)
+            {
+                m_queued -= static_cast<uint32_t>(submitted);
+                return true;
+            }
+
+            // EBUSY and EAGAIN mean the completion queue has to be drained first, the caller reaps it
+            if (errno == EBUSY || errno == EAGAIN)
+                return false;
+            if (errno != EINTR)
+                throw_errno("io_uring_enter");
+        }
+    }
+
+    // Moves every completion onto the context's ready list
+    // Submits nothing, a completed wake read is only noted and rearmed by arm_wake().
+    size_t reap() noexcept
+    {
+        uint32_t head = *m_cqHead;
+        uint32_t tail = std::atomic_ref<uint32_t>(*m_cqTail).load(std::memory_order_acquire);
+        for (uint32_t i = head; i != tail; i++)
+        {
+            const io_uring_cqe &cqe = m_cqes[i & m_cqMask];
+            if (cqe.user_data == wake_tag)
+            {
+                m_wakeArmed = false;
+                continue;
+            }
+            if (cqe.user_data == cancel_tag)
+                continue;
+
+            io_operation_base *operation = reinterpret_cast<io_operation_base *>(cqe.user_data);
+            operation->m_result = cqe.res;
+            m_context.complete(operation);
+        }
+        std::atomic_ref<uint32_t>(*m_cqHead).store(tail, std::memory_order_release);
+        return tail - head;
+    }
+
+    // Queues the read keeping the wake eventfd armed unless one is in flight
+    void arm_wake()
+    {
+        if (m_wakeArmed)
+            return;
+
+        io_uring_sqe *sqe = get_sqe();
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = m_context.m_wakeFd;
+        sqe->addr = reinterpret_cast<uint64_t>(&m_wakeValue);
+        sqe->len = sizeof(m_wakeValue);
+        sqe->user_data = wake_tag;
+        m_wakeArmed = true;
+    }
+
+private:
+    bool map(const io_uring_params &params)
+    {
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single)
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+        void *sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        if (sqRing == MAP_FAILED)
+            return false;
+        m_sqRing = static_cast<char *>(sqRing);
+
+        if (single)
+        {
+            m_cqRing = m_sqRing;
+        }
+        else
+        {
+            void *cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+            if (cqRing == MAP_FAILED)
+                return false;
+            m_cqRing = static_cast<char *>(cqRing);
+        }
+
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED)
+            return false;
+        m_sqes = static_cast<io_uring_sqe *>(sqes);
+
+        m_sqHead = reinterpret_cast<uint32_t *>(m_sqRing + params.sq_off.head);
+        m_sqTailShared = reinterpret_cast<uint32_t *>(m_sqRing + params.sq_off.tail);
+        m_sqMask = *reinterpret_cast<uint32_t *>(m_sqRing + params.sq_off.ring_mask);
+        m_sqEntries = *reinterpret_cast<uint32_t *>(m_sqRing + params.sq_off.ring_entries);
+        m_sqTail = *m_sqTailShared;
+        uint32_t *array = reinterpret_cast<uint32_t *>(m_sqRing + params.sq_off.array);
+        for (uint32_t i = 0; i < m_sqEntries; i++)
+            array[i] = i;
+
+        m_cqHead = reinterpret_cast<uint32_t *>(m_cqRing + params.cq_off.head);
+        m_cqTail = reinterpret_cast<uint32_t *>(m_cqRing + params.cq_off.tail);
+        m_cqMask = *reinterpret_cast<uint32_t *>(m_cqRing + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe *>(m_cqRing + params.cq_off.cqes);
+        return true;
+    }
+
+    io_context &m_context;
+    int m_fd = -1;
+
+    // Target of the read keeping the wake eventfd armed
+    uint64_t m_wakeValue = 0;
+    bool m_wakeArmed = false;
+
+    char *m_sqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    char *m_cqRing = nullptr;
+    size_t m_cqRingSize = 0;
+    io_uring_sqe *m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    uint32_t *m_sqHead = nullptr;
+    uint32_t *m_sqTailShared = nullptr;
+    uint32_t m_sqTail = 0;
+    uint32_t m_sqMask = 0;
+    uint32_t m_sqEntries = 0;
+    uint32_t m_queued = 0;
+
+    uint32_t *m_cqHead = nullptr;
+    uint32_t *m_cqTail = nullptr;
+    uint32_t m_cqMask = 0;
+    io_uring_cqe *m_cqes = nullptr;
+};
+
+// epoll fallback
+// Operations are attempted directly, on EAGAIN they queue on their descriptor and the descriptor is
+// armed one-shot for the directions somebody waits on. When it fires the queued operations are
+// retried in FIFO order until one would block again.
+class io_context::epoll_reactor
+{
+public:
+    explicit epoll_reactor(int wakeFd) : m_wakeFd(wakeFd)
+    {
+        m_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (m_fd < 0)
+            throw_errno("epoll_create1");
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = wakeFd;
+        if (epoll_ctl(m_fd, EPOLL_CTL_ADD, wakeFd, &event) < 0)
+        {
+            close(m_fd);
+            throw_errno("epoll_ctl");
+        }
+    }
+
+    ~epoll_reactor()
+    {
+        close(m_fd);
+    }
+
+    // Attempts the operation or queues it on its descriptor, returns false if it completed
+    bool start(io_operation_base *operation)
+    {
+        if (attempt(operation, false))
+            return false;
+
+        fd_state &state = m_fds[operation->m_fd];
+        waiter_list &list = waits_readable(operation->m_opcode) ? state.readers : state.writers;
+        list.push(operation);
+        if (!arm(operation->m_fd, state))
+        {
+            operation->m_result = -errno;
+            list.remove_last(operation);
+            if (state.readers.empty() && state.writers.empty())
+                m_fds.erase(operation->m_fd);
+            return false;
+        }
+        return true;
+    }
+
+    // Takes a waiting operation off its descriptor, returns false if it is not waiting
+    bool cancel(io_operation_base *operation)
+    {
+        auto it = m_fds.find(operation->m_fd);
+        if (it == m_fds.end())
+            return false;
+
+        fd_state &state = it->second;
+        waiter_list &list = waits_readable(operation->m_opcode) ? state.readers : state.writers;
+        if (!list.remove(operation))
+            return false;
+
+        // The descriptor stays armed, a readiness event without waiters is ignored
+        if (state.readers.empty() && state.writers.empty())
+            m_fds.erase(it);
+        return true;
+    }
+
+    // Waits up to timeout milliseconds and hands every operation that completes to onComplete
+    template <typename FUNC>
+    void wait(int timeout, FUNC &&onComplete)
+    {
+        epoll_event events[256];
+        int count = epoll_wait(m_fd, events, 256, timeout);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+                return;
+            throw_errno("epoll_wait");
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int fd = events[i].data.fd;
+            if (fd == m_wakeFd)
+            {
+                uint64_t value;
+                [[maybe_unused]] ssize_t ignored = ::read(m_wakeFd, &value, sizeof(value));
+                continue;
+            }
+
+            auto it = m_fds.find(fd);
+            if (it == m_fds.end())
+                continue;
+
+            fd_state &state = it->second;
+            uint32_t ready = events[i].events;
+            if (ready & (EPOLLIN | EPOLLERR | EPOLLHUP))
+                retry(state.readers, onComplete);
+            if (ready & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+                retry(state.writers, onComplete);
+
+            if (state.readers.empty() && state.writers.empty())
+            {
+                m_fds.erase(it);
+            }
+            else if (!arm(fd, state))
+            {
+                // The descriptor went away under the waiting operations
+                int error = errno;
+                for (waiter_list *list : {&state.readers, &state.writers})
+                {
+                    while (io_operation_base *operation = list->pop())
+                    {
+                        operation->m_result = -error;
+                        onComplete(operation);
+                    }
+                }
+                m_fds.erase(it);
+            }
+        }
+    }
+
+private:
+    // Intrusive FIFO of operations through m_next
+    struct waiter_list
+    {
+        io_operation_base *head = nullptr;
+        io_operation_base *tail = nullptr;
+
+        bool empty() const noexcept { return head == nullptr; }
+
+        void push(io_operation_base *operation) noexcept
+        {
+            operation->m_next = nullptr;
+            if (tail)
+                tail->m_next = operation;
+            else
+                head = operation;
+            tail = operation;
+        }
+
+        io_operation_base *pop() noexcept
+        {
+            io_operation_base *operation = head;
+            if (operation)
+            {
+                head = operation->m_next;
+                if (head == nullptr)
+                    tail = nullptr;
+            }
+            return operation;
+        }
+
+        bool remove(io_operation_base *operation) noexcept
+        {
+            io_operation_base *previous = nullptr;
+            for (io_operation_base *current = head; current != nullptr; previous = current, current = current->m_next)
+            {
+                if (current != operation)
+                    continue;
+
+                if (previous)
+                    previous->m_next = current->m_next;
+                else
+                    head = current->m_next;
+                if (tail == current)
+                    tail = previous;
+                return true;
+            }
+            return false;
+        }
+
+        // Undoes the push of operation
+        void remove_last(io_operation_base *operation) noexcept
+        {
+            if (head == operation)
+            {
+                head = tail = nullptr;
+                return;
+            }
+            io_operation_base *previous = head;
+            while (previous->m_next != operation)
+                previous = previous->m_next;
+            previous->m_next = nullptr;
+            tail = previous;
+        }
+    };
+
+    struct fd_state
+    {
+        waiter_list readers;
+        waiter_list writers;
+    };
+
+    // Arms the descriptor one-shot for the directions with waiters
+    bool arm(int fd, const fd_state &state)
+    {
+        epoll_event event{};
+        event.events = EPOLLONESHOT | (state.readers.empty() ? 0u : uint32_t(EPOLLIN)) | (state.writers.empty() ? 0u : uint32_t(EPOLLOUT));
+        event.data.fd = fd;
+        if (epoll_ctl(m_fd, EPOLL_CTL_MOD, fd, &event) == 0)
+            return true;
+        return errno == ENOENT && epoll_ctl(m_fd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    template <typename FUNC>
+    void retry(waiter_list &list, FUNC &&onComplete)
+    {
+        while (!list.empty() && attempt(list.head, true))
+            onComplete(list.pop());
+    }
+
+    // Runs the system call, returns false if it would block
+    static bool attempt(io_operation_base *operation, bool retry)
+    {
+        for (;;)
+        {
+            ssize_t result = call(operation, retry);
+            if (result >= 0)
+            {
+                operation->m_result = result;
+                return true;
+            }
+
+            int error = errno;
+            if (error == EINTR)
+                continue;
+            if (error == EAGAIN || error == EWOULDBLOCK || (error == EINPROGRESS && operation->m_opcode == io_opcode::connect))
+                return false;
+
+            operation->m_result = -error;
+            return true;
+        }
+    }
+
+    static ssize_t call(io_operation_base *operation, bool retry)
+    {
+        int fd = operation->m_fd;
+        switch (operation->m_opcode)
+        {
+        case io_opcode::read:
+            return operation->m_offset < 0 ? ::read(fd, operation->m_buffer, operation->m_length)
+                                           : ::pread(fd, operation->m_buffer, operation->m_length, operation->m_offset);
+        case io_opcode::write:
+            return operation->m_offset < 0 ? ::write(fd, operation->m_buffer, operation->m_length)
+                                           : ::pwrite(fd, operation->m_buffer, operation->m_length, operation->m_offset);
+        case io_opcode::readv:
+        {
+            const iovec *buffers = static_cast<const iovec *>(operation->m_buffer);
+            int count = static_cast<int>(operation->m_length);
+            return operation->m_offset < 0 ? ::readv(fd, buffers, count) : ::preadv(fd, buffers, count, operation->m_offset);
+        }
+        case io_opcode::writev:
+        {
+            const iovec *buffers = static_cast<const iovec *>(operation->m_buffer);
+            int count = static_cast<int>(operation->m_length);
+            return operation->m_offset < 0 ? ::writev(fd, buffers, count) : ::pwritev(fd, buffers, count, operation->m_offset);
+        }
+        case io_opcode::accept:
+            return ::accept4(fd, operation->m_address, operation->m_addressLength, operation->m_flags);
+        case io_opcode::connect:
+        {
+            if (!retry)
+                return ::connect(fd, operation->m_address, static_cast<socklen_t>(operation->m_length));
+
+            // Writable after EINPROGRESS, the outcome is in SO_ERROR
+            int error = 0;
+            socklen_t length = sizeof(error);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length) < 0)
+                return -1;
+            errno = error;
+            return error == 0 ? 0 : -1;
+        }
+        case io_opcode::recv:
+            return ::recv(fd, operation->m_buffer, operation->m_length, operation->m_flags);
+        case io_opcode::send:
+            return ::send(fd, operation->m_buffer, operation->m_length, operation->m_flags);
+        }
+        errno = EINVAL;
+        return -1;
+    }
+
+    int m_fd = -1;
+    int m_wakeFd;
+    std::unordered_map<int, fd_state> m_fds;
+};
+
+io_operation_base::io_operation_base(const io_operation_base &other) noexcept
+    : m_context(other.m_context), m_opcode(other.m_opcode), m_fd(other.m_fd),
+      m_buffer(other.m_buffer), m_length(other.m_length), m_offset(other.m_offset), m_flags(other.m_flags),
+      m_address(other.m_address), m_addressLength(other.m_addressLength), m_token(other.m_token)
+{
+}
+
+bool io_operation_base::suspend(std::coroutine_handle<> awaitingCoroutine)
+{
+    m_awaitingCoroutine = awaitingCoroutine;
+    if (m_token.is_cancellation_requested())
+    {
+        m_result = -ECANCELED;
+        return false;
+    }
+
+    if (!m_context.start(this))
+        return false;
+
+    // Registered once pending, the operation cannot complete before the reactor polls again
+    if (m_token.can_be_cancelled())
+        m_registration.emplace(m_token, [this]
+                               { m_context.cancel_impl(this); });
+    return true;
+}
+
+int64_t io_operation_base::get_result()
+{
+    // Waits for a callback still running on another thread
+    m_registration.reset();
+
+    if (m_result == -ECANCELED)
+        throw operation_cancelled{};
+    if (m_result < 0)
+        throw std::system_error(static_cast<int>(-m_result), std::system_category());
+    return m_result;
+}
+
+io_context::io_context(uint32_t entries, bool force_epoll)
+{
+    m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wakeFd < 0)
+        throw_errno("eventfd");
+
+    if (!force_epoll)
+        m_uring = uring::create(*this, entries);
+
+    if (m_uring)
+    {
+        m_backend = backend::io_uring;
+        m_uring->arm_wake();
+    }
+    else
+    {
+        m_backend = backend::epoll;
+        try
+        {
+            m_epoll = make_uref<epoll_reactor>(m_wakeFd);
+        }
+        catch (...)
+        {
+            close(m_wakeFd);
+            throw;
+        }
+    }
+}
+
+io_context::~io_context()
+{
+    m_uring.reset();
+    m_epoll.reset();
+    close(m_wakeFd);
+}
+
+bool io_context::start(io_operation_base *operation)
+{
+    if (m_epoll)
+        return m_epoll->start(operation);
+
+    io_uring_sqe *sqe = m_uring->get_sqe();
+    sqe->fd = operation->m_fd;
+    sqe->user_data = reinterpret_cast<uint64_t>(operation);
+    sqe->addr = reinterpret_cast<uint64_t>(operation->m_buffer);
+    sqe->len = static_cast<uint32_t>(operation->m_length);
+    sqe->off = static_cast<uint64_t>(operation->m_offset);
+    switch (operation->m_opcode)
+    {
+    case io_opcode::read:
+        sqe->opcode = IORING_OP_READ;
+        break;
+    case io_opcode::write:
+        sqe->opcode = IORING_OP_WRITE;
+        break;
+    case io_opcode::readv:
+        sqe->opcode = IORING_OP_READV;
+        break;
+    case io_opcode::writev:
+        sqe->opcode = IORING_OP_WRITEV;
+        break;
+    case io_opcode::accept:
+        sqe->opcode = IORING_OP_ACCEPT;
+        sqe->addr = reinterpret_cast<uint64_t>(operation->m_address);
+        sqe->addr2 = reinterpret_cast<uint64_t>(operation->m_addressLength);
+        sqe->len = 0;
+        sqe->accept_flags = static_cast<uint32_t>(operation->m_flags);
+        break;
+    case io_opcode::connect:
+        sqe->opcode = IORING_OP_CONNECT;
+        sqe->addr = reinterpret_cast<uint64_t>(operation->m_address);
+        sqe->len = 0;
+        sqe->off = operation->m_length;
+        break;
+    case io_opcode::recv:
+        sqe->opcode = IORING_OP_RECV;
+        sqe->off = 0;
+        sqe->msg_flags = static_cast<uint32_t>(operation->m_flags);
+        break;
+    case io_opcode::send:
+        sqe->opcode = IORING_OP_SEND;
+        sqe->off = 0;
+        sqe->msg_flags = static_cast<uint32_t>(operation->m_flags);
+        break;
+    }
+    return true;
+}
+
+void io_context::schedule_impl(schedule_operation *operation) noexcept
+{
+    schedule_operation *head = m_remoteQueue.load(std::memory_order_relaxed);
+    do
+    {
+        operation->m_next = head;
+    } while (!m_remoteQueue.compare_exchange_weak(head, operation, std::memory_order_release, std::memory_order_relaxed));
+
+    // Whoever makes the stack non-empty wakes the reactor, it always takes the whole stack
+    if (head == nullptr)
+        wake();
+}
+
+void io_context::cancel_impl(io_operation_base *operation) noexcept
+{
+    uint8_t expected = io_operation_base::pending;
+    if (!operation->m_cancelState.compare_exchange_strong(expected, io_operation_base::cancel_queued, std::memory_order_acq_rel))
+        return;
+
+    io_operation_base *head = m_cancelQueue.load(std::memory_order_relaxed);
+    do
+    {
+        operation->m_cancelNext = head;
+    } while (!m_cancelQueue.compare_exchange_weak(head, operation, std::memory_order_release, std::memory_order_relaxed));
+
+    if (head == nullptr)
+        wake();
+}
+
+void io_context::process_cancellations()
+{
+    if (m_cancelQueue.load(std::memory_order_relaxed) == nullptr)
+        return;
+
+    io_operation_base *operation = m_cancelQueue.exchange(nullptr, std::memory_order_acquire);
+    while (operation != nullptr)
+    {
+        // Read before the operation may resume
+        io_operation_base *next = operation->m_cancelNext;
+        if (operation->m_cancelState.load(std::memory_order_relaxed) == io_operation_base::completed_while_queued)
+        {
+            complete(operation);
+        }
+        else
+        {
+            operation->m_cancelState.store(io_operation_base::cancel_issued, std::memory_order_relaxed);
+            if (m_uring)
+            {
+                // The operation completes with -ECANCELED, or with its result if it was too late
+                io_uring_sqe *sqe = m_uring->get_sqe();
+                sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                sqe->fd = -1;
+                sqe->addr = reinterpret_cast<uint64_t>(operation);
+                sqe->user_data = cancel_tag;
+            }
+            else if (m_epoll->cancel(operation))
+            {
+                operation->m_result = -ECANCELED;
+                complete(operation);
+            }
+        }
+        operation = next;
+    }
+}
+
+void io_context::complete(io_operation_base *operation) noexcept
+{
+    operation->m_next = nullptr;
+    if (m_readyTail)
+        m_readyTail->m_next = operation;
+    else
+        m_readyHead = operation;
+    m_readyTail = operation;
+}
+
+void io_context::wake() noexcept
+{
+    uint64_t one = 1;
+    [[maybe_unused]] ssize_t ignored = ::write(m_wakeFd, &one, sizeof(one));
+}
+
+// Resumes the coroutines scheduled from other threads in the order they were scheduled
+size_t io_context::resume_scheduled()
+{
+    if (m_remoteQueue.load(std::memory_order_relaxed) == nullptr)
+        return 0;
+
+    schedule_operation *head = m_remoteQueue.exchange(nullptr, std::memory_order_acquire);
+    schedule_operation *reversed = nullptr;
+    while (head != nullptr)
+    {
+        schedule_operation *next = head->m_next;
+        head->m_next = reversed;
+        reversed = head;
+        head = next;
+    }
+
+    size_t count = 0;
+    while (reversed != nullptr)
+    {
+        schedule_operation *next = reversed->m_next;
+        reversed->m_awaitingCoroutine.resume();
+        reversed = next;
+        count++;
+    }
+    return count;
+}
+
+size_t io_context::process(bool wait)
+{
+    size_t count = resume_scheduled();
+    process_cancellations();
+    bool block = wait && count == 0 && m_readyHead == nullptr;
+
+    if (m_uring)
+    {
+        // Hand the queued submissions over and reap, the eventfd read makes remote wakes visible
+        // The wake read reaped last time is rearmed first, so a blocking enter always has one in
+        // flight. A refused enter does not block, the reap makes room and the next poll submits.
+        m_uring->arm_wake();
+        m_uring->enter(block ? 1 : 0);
+        m_uring->reap();
+    }
+    else
+    {
+        m_epoll->wait(block ? -1 : 0, [this](io_operation_base *operation)
+                      { complete(operation); });
+    }
+
+    // Resuming may queue new operations, they go out with the next poll
+    while (io_operation_base *operation = m_readyHead)
+    {
+        m_readyHead = operation->m_next;
+        if (m_readyHead == nullptr)
+            m_readyTail = nullptr;
+
+        uint8_t state = io_operation_base::pending;
+        if (operation->m_registration && !operation->m_cancelState.compare_exchange_strong(state, io_operation_base::completed, std::memory_order_acq_rel) && state == io_operation_base::cancel_queued)
+        {
+            // Still on the cancel stack, process_cancellations() resumes it once it took it off
+            operation->m_cancelState.store(io_operation_base::completed_while_queued, std::memory_order_relaxed);
+            continue;
+        }
+        operation->m_awaitingCoroutine.resume();
+        count++;
+    }
+
+    return count + resume_scheduled();
+}
+
+void io_context::run()
+{
+    while (!m_stopRequested.exchange(false, std::memory_order_acquire))
+        process(true);
+}
+
+size_t io_context::poll()
+{
+    return process(false);
+}
+
+void io_context::stop()
+{
+    m_stopRequested.store(true, std::memory_order_release);
+    wake();
+}
+#endif
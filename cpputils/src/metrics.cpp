@@ -0,0 +1,260 @@
+#include <cpputils/core/metrics.h>
+#include <algorithm>
+#include <bit>
+#include <sstream>
+#include <stdexcept>
+
+using namespace cpputils;
+using namespace cpputils::metrics;
+
+// Number of shards
+size_t cpputils::metrics::detail::shard_count() noexcept
+{
+    static const size_t count = std::bit_ceil<size_t>(std::max(1u, std::thread::hardware_concurrency()));
+    return count;
+}
+
+// Hands out shards round robin so that the first shard_count() threads never share one
+size_t cpputils::metrics::detail::assign_thread_shard() noexcept
+{
+    static std::atomic<size_t> next_slot{0};
+    return next_slot.fetch_add(1, std::memory_order_relaxed) & (shard_count() - 1);
+}
+
+counter::counter()
+    : m_shards(std::make_unique<detail::padded_atomic<uint64_t>[]>(detail::shard_count()))
+{
+}
+
+uint64_t counter::value() const noexcept
+{
+    uint64_t total = 0;
+    for (size_t i = 0; i < detail::shard_count(); i++)
+        total += m_shards[i].value.load(std::memory_order_relaxed);
+    return total;
+}
+
+gauge::gauge()
+    : m_shards(std::make_unique<detail::padded_atomic<int64_t>[]>(detail::shard_count()))
+{
+}
+
+// The shards keep their deltas, the base is chosen so that the sum becomes value
+void gauge::set(int64_t value) noexcept
+{
+    int64_t deltas = 0;
+    for (size_t i = 0; i < detail::shard_count(); i++)
+        deltas += m_shards[i].value.load(std::memory_order_relaxed);
+    m_base.store(value - deltas, std::memory_order_relaxed);
+}
+
+int64_t gauge::value() const noexcept
+{
+    int64_t total = m_base.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < detail::shard_count(); i++)
+        total += m_shards[i].value.load(std::memory_order_relaxed);
+    return total;
+}
+
+metrics::histogram::histogram(uint32_t precision, uint64_t max_value)
+    : m_precision(precision), m_maxValue(max_value),
+      m_shards(std::make_unique<detail::histogram_slot[]>(detail::shard_count()))
+{
+    // Fails on a bad configuration here rather than on the first record
+    cpputils::histogram(precision, max_value);
+}
+
+metrics::histogram::~histogram()
+{
+    for (size_t i = 0; i < detail::shard_count(); i++)
+        delete m_shards[i].load(std::memory_order_relaxed);
+}
+
+// Threads sharing a shard may race to create it, the loser frees its copy
+detail::padded_histogram *metrics::histogram::create_shard(detail::histogram_slot &slot)
+{
+    auto *created = new detail::padded_histogram{cpputils::histogram(m_precision, m_maxValue)};
+    detail::padded_histogram *expected = nullptr;
+    if (slot.compare_exchange_strong(expected, created, std::memory_order_acq_rel, std::memory_order_acquire))
+        return created;
+
+    delete created;
+    return expected;
+}
+
+cpputils::histogram metrics::histogram::snapshot() const
+{
+    cpputils::histogram result(m_precision, m_maxValue);
+    for (size_t i = 0; i < detail::shard_count(); i++)
+    {
+        if (const detail::padded_histogram *shard = m_shards[i].load(std::memory_order_acquire))
+            result.merge(shard->value);
+    }
+    return result;
+}
+
+// Checks the name against the Prometheus metric name grammar
+static void validate_name(const string &name)
+{
+    bool valid = !name.empty() && !(name[0] >= '0' && name[0] <= '9');
+    for (char c : name)
+        valid = valid && ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_' || c == ':');
+
+    if (!valid)
+        throw std::invalid_argument("Invalid metric name: " + name);
+}
+
+registry::entry &registry::get_entry(const string &name, const string &help, metric_kind kind)
+{
+    auto it = m_entries.find(name);
+    if (it != m_entries.end())
+    {
+        if (it->second.kind != kind)
+            throw std::invalid_argument("Metric " + name + " is already registered with another kind");
+        return it->second;
+    }
+
+    validate_name(name);
+    entry &created = m_entries[name];
+    created.kind = kind;
+    created.help = help;
+    return created;
+}
+
+counter &registry::get_counter(const string &name, const string &help)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    entry &e = get_entry(name, help, metric_kind::counter);
+    if (!e.counter_metric)
+        e.counter_metric = make_uref<counter>();
+    return *e.counter_metric;
+}
+
+gauge &registry::get_gauge(const string &name, const string &help)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    entry &e = get_entry(name, help, metric_kind::gauge);
+    if (!e.gauge_metric)
+        e.gauge_metric = make_uref<gauge>();
+    return *e.gauge_metric;
+}
+
+metrics::histogram &registry::get_histogram(const string &name, const string &help, uint32_t precision)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    entry &e = get_entry(name, help, metric_kind::histogram);
+    if (!e.histogram_metric)
+        e.histogram_metric = make_uref<metrics::histogram>(precision);
+    return *e.histogram_metric;
+}
+
+// Writes the metrics in the Prometheus text exposition format
+string registry::to_text() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::stringstream out;
+
+    for (auto &[name, e] : m_entries)
+    {
+        if (!e.help.empty())
+            out << "# HELP " << name << " " << e.help << "\n";
+
+        switch (e.kind)
+        {
+        case metric_kind::counter:
+            out << "# TYPE " << name << " counter\n";
+            out << name << " " << e.counter_metric->value() << "\n";
+            break;
+        case metric_kind::gauge:
+            out << "# TYPE " << name << " gauge\n";
+            out << name << " " << e.gauge_metric->value() << "\n";
+            break;
+        case metric_kind::histogram:
+        {
+            cpputils::histogram snapshot = e.histogram_metric->snapshot();
+            out << "# TYPE " << name << " summary\n";
+            for (const char *quantile : {"0.5", "0.9", "0.99", "0.999"})
+                out << name << "{quantile=\"" << quantile << "\"} " << snapshot.value_at_quantile(std::stod(quantile)) << "\n";
+            out << name << "_sum " << snapshot.sum() << "\n";
+            out << name << "_count " << snapshot.count() << "\n";
+            break;
+        }
+        }
+    }
+    return out.str();
+}
+
+// Splits every sample line at its last space, the labels may contain spaces inside quotes
+tree_map<string, double> cpputils::metrics::parse_text(const string &text)
+{
+    tree_map<string, double> samples;
+    std::stringstream lines(text);
+    string line;
+    while (std::getline(lines, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        size_t space = line.rfind(' ');
+        if (space == string::npos || space == 0)
+            continue;
+
+        try
+        {
+            samples[line.substr(0, space)] = std::stod(line.substr(space + 1));
+        }
+        catch (const std::exception &)
+        {
+        }
+    }
+    return samples;
+}
+
+// Gets the global registry
+registry &registry::global()
+{
+    static registry instance;
+    return instance;
+}
+
+reporter::reporter(registry &registry, ref<logger> logger, chrono::milliseconds interval, log_level level)
+    : m_registry(registry), m_logger(logger), m_interval(interval), m_level(level)
+{
+    m_thread = std::thread(&reporter::run, this);
+}
+
+reporter::~reporter()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_cv.notify_one();
+    m_thread.join();
+}
+
+// Logs every exposition line except the comments
+void reporter::report_now()
+{
+    std::stringstream text(m_registry.to_text());
+    string line;
+    while (std::getline(text, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        m_logger->log({m_level, line, chrono::now(), "metrics"});
+    }
+}
+
+// Reporting loop
+void reporter::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_cv.wait_for(lock, m_interval, [this]
+                          { return m_stop; }))
+    {
+        lock.unlock();
+        report_now();
+        lock.lock();
+    }
+}
@@ -0,0 +1,121 @@
+#include <cpputils/core/parallel.h>
+
+using namespace cpputils;
+
+namespace
+{
+    // Set on workers and on a thread running a region, nested regions run inline
+    thread_local bool t_inRegion = false;
+
+    // Rounds a waiting thread spins before sleeping on the futex
+    constexpr int spin_rounds = 256;
+}
+
+parallel_pool::parallel_pool(uint32_t thread_count) : m_threadCount(std::max<uint32_t>(thread_count, 1))
+{
+    m_threads.reserve(m_threadCount - 1);
+    for (uint32_t i = 1; i < m_threadCount; i++)
+        m_threads.emplace_back([this]
+                               { run_worker(); });
+}
+
+parallel_pool::~parallel_pool()
+{
+    m_stopRequested.store(true, std::memory_order_relaxed);
+    m_epoch.fetch_add(1, std::memory_order_release);
+    m_epoch.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+parallel_pool &parallel_pool::global()
+{
+    static parallel_pool pool;
+    return pool;
+}
+
+void parallel_pool::work(region &job) noexcept
+{
+    for (;;)
+    {
+        size_t chunk = job.m_next.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= job.m_chunks)
+            return;
+
+        if (!job.m_failed.load(std::memory_order_relaxed))
+        {
+            try
+            {
+                job.m_invoke(job.m_body, chunk);
+            }
+            catch (...)
+            {
+                if (!job.m_failed.exchange(true, std::memory_order_relaxed))
+                    job.m_exception = std::current_exception();
+            }
+        }
+
+        // The last chunk wakes the thread running the region
+        if (job.m_done.fetch_add(1, std::memory_order_acq_rel) + 1 == job.m_chunks)
+            job.m_done.notify_one();
+    }
+}
+
+void parallel_pool::run(region &job)
+{
+    if (job.m_chunks == 0)
+        return;
+
+    if (t_inRegion || m_threadCount == 1 || job.m_chunks == 1)
+    {
+        for (size_t chunk = 0; chunk < job.m_chunks; chunk++)
+            job.m_invoke(job.m_body, chunk);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    t_inRegion = true;
+
+    m_region.store(&job, std::memory_order_seq_cst);
+    m_epoch.fetch_add(1, std::memory_order_release);
+    m_epoch.notify_all();
+
+    work(job);
+
+    size_t done = job.m_done.load(std::memory_order_acquire);
+    for (int spin = 0; done != job.m_chunks; spin++)
+    {
+        if (spin < spin_rounds)
+            std::this_thread::yield();
+        else
+            job.m_done.wait(done, std::memory_order_acquire);
+        done = job.m_done.load(std::memory_order_acquire);
+    }
+
+    // A worker that saw the region is counted in m_active, wait until it let go of it
+    m_region.store(nullptr, std::memory_order_seq_cst);
+    while (m_active.load(std::memory_order_seq_cst) != 0)
+        std::this_thread::yield();
+
+    t_inRegion = false;
+    if (job.m_exception)
+        std::rethrow_exception(job.m_exception);
+}
+
+void parallel_pool::run_worker()
+{
+    t_inRegion = true;
+    uint32_t epoch = m_epoch.load(std::memory_order_acquire);
+    for (;;)
+    {
+        m_epoch.wait(epoch, std::memory_order_acquire);
+        epoch = m_epoch.load(std::memory_order_acquire);
+        if (m_stopRequested.load(std::memory_order_relaxed))
+            return;
+
+        m_active.fetch_add(1, std::memory_order_seq_cst);
+        if (region *job = m_region.load(std::memory_order_seq_cst))
+            work(*job);
+        m_active.fetch_sub(1, std::memory_order_release);
+    }
+}
@@ -0,0 +1,135 @@
+#include <cpputils/asyncio/priority_executor.h>
+#include <algorithm>
+
+using namespace cpputils;
+using namespace cpputils::asyncio;
+
+namespace
+{
+    // What the calling worker is running, set each time it resumes a coroutine
+    struct running_slice
+    {
+        task_priority priority = task_priority::normal;
+        int64_t deadline = priority_executor::no_deadline;
+        int64_t key = priority_executor::no_deadline;
+        int64_t start = 0;
+    };
+
+    thread_local priority_executor *t_currentExecutor = nullptr;
+    thread_local running_slice t_slice;
+
+    int64_t now_ns() noexcept
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(priority_executor::clock::now().time_since_epoch()).count();
+    }
+}
+
+priority_executor::priority_executor(uint32_t thread_count, priority_executor_options options)
+    : m_threadCount(thread_count == 0 ? 1 : thread_count), m_options(options)
+{
+    m_threads.reserve(m_threadCount);
+    for (uint32_t i = 0; i < m_threadCount; i++)
+        m_threads.emplace_back(&priority_executor::run_worker, this);
+}
+
+priority_executor::~priority_executor()
+{
+    shutdown();
+    for (auto &thread : m_threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+bool priority_executor::is_worker_thread() const noexcept
+{
+    return t_currentExecutor == this;
+}
+
+priority_executor *priority_executor::current() noexcept
+{
+    return t_currentExecutor;
+}
+
+void priority_executor::shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopRequested = true;
+    }
+    m_condition.notify_all();
+}
+
+// Earlier work is waiting, or the running coroutine used up its quantum while anything waits
+bool priority_executor::should_yield() const noexcept
+{
+    if (m_queued.load(std::memory_order_relaxed) == 0)
+        return false;
+    if (m_earliestKey.load(std::memory_order_relaxed) < t_slice.key)
+        return true;
+    return now_ns() - t_slice.start >= m_options.quantum.count();
+}
+
+// A yielding coroutine is requeued with the priority or deadline of the slice it runs in
+void priority_executor::schedule_impl(schedule_operation *operation) noexcept
+{
+    if (operation->m_conditional)
+    {
+        operation->m_priority = t_slice.priority;
+        operation->m_deadline = t_slice.deadline;
+    }
+
+    const int64_t now = now_ns();
+    operation->m_key = operation->m_deadline != no_deadline
+                           ? operation->m_deadline
+                           : now + m_options.slack[static_cast<size_t>(operation->m_priority)].count();
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        operation->m_sequence = m_nextSequence++;
+        m_heap.push_back(operation);
+        std::push_heap(m_heap.begin(), m_heap.end(), later);
+        m_queued.store(m_heap.size(), std::memory_order_relaxed);
+        m_earliestKey.store(m_heap.front()->m_key, std::memory_order_relaxed);
+        wake = m_sleepingCount != 0;
+    }
+
+    if (wake)
+        m_condition.notify_one();
+}
+
+void priority_executor::run_worker()
+{
+    t_currentExecutor = this;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;)
+    {
+        if (m_heap.empty())
+        {
+            if (m_stopRequested)
+                break;
+            m_sleepingCount++;
+            m_condition.wait(lock);
+            m_sleepingCount--;
+            continue;
+        }
+
+        std::pop_heap(m_heap.begin(), m_heap.end(), later);
+        schedule_operation *operation = m_heap.back();
+        m_heap.pop_back();
+        m_queued.store(m_heap.size(), std::memory_order_relaxed);
+        m_earliestKey.store(m_heap.empty() ? no_deadline : m_heap.front()->m_key, std::memory_order_relaxed);
+        lock.unlock();
+
+        // Copy the slice out first, resuming the coroutine may destroy the operation
+        t_slice = {operation->m_priority, operation->m_deadline, operation->m_key, now_ns()};
+        operation->m_awaitingCoroutine.resume();
+
+        lock.lock();
+    }
+
+    t_currentExecutor = nullptr;
+}
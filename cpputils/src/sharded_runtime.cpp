@@ -0,0 +1,409 @@
+#include <cpputils/asyncio/sharded_runtime.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace cpputils;
+using namespace cpputils::asyncio;
+
+// Bounded single producer single consumer ring of operations
+// Each side caches the other side's index and only reloads it when the ring looks full or empty,
+// so a steady stream of hops touches the shared indices about once per lap.
+class sharded_runtime::spsc_ring
+{
+public:
+    static constexpr size_t capacity = 256;
+
+    // Producer only, false when the ring is full
+    bool try_push(schedule_operation *operation) noexcept
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead == capacity)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead == capacity)
+                return false;
+        }
+
+        m_slots[tail & (capacity - 1)] = operation;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer only
+    schedule_operation *try_pop() noexcept
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_cachedTail)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (head == m_cachedTail)
+                return nullptr;
+        }
+
+        schedule_operation *operation = m_slots[head & (capacity - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return operation;
+    }
+
+    bool empty() const noexcept
+    {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+private:
+    // Producer side
+    alignas(cache_line_size) std::atomic<size_t> m_tail{0};
+    size_t m_cachedHead = 0;
+
+    // Consumer side
+    alignas(cache_line_size) std::atomic<size_t> m_head{0};
+    size_t m_cachedTail = 0;
+
+    alignas(cache_line_size) schedule_operation *m_slots[capacity];
+};
+
+// Per shard state, padded so shards never share a line
+struct alignas(cache_line_size) sharded_runtime::shard_state
+{
+    uint32_t index = 0;
+
+    // Coroutines the shard scheduled onto itself, intrusive FIFO only the shard touches
+    schedule_operation *localHead = nullptr;
+    schedule_operation *localTail = nullptr;
+
+    timer_wheel wheel;
+
+    // Work from threads outside the runtime and from shards whose ring was full, lock-free stack
+    alignas(cache_line_size) std::atomic<schedule_operation *> remoteQueue{nullptr};
+
+    // Parking: the shard raises sleeping before its last look at the queues, producers notify
+    // when they see it raised
+    alignas(cache_line_size) std::atomic<bool> sleeping{false};
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool notified = false;
+
+    // Counted in m_parkedShards, under m_exitMutex
+    bool parked = false;
+};
+
+namespace
+{
+    // Shard the calling thread runs
+    thread_local sharded_runtime *t_currentRuntime = nullptr;
+    thread_local uint32_t t_currentShard = sharded_runtime::no_shard;
+
+    // Rounds an idle shard polls its queues before sleeping
+    constexpr int spin_rounds = 64;
+
+    // Pins the calling thread to a CPU
+    void pin_thread(uint32_t cpu)
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+            LOG_WARNING("Unable to pin shard thread to cpu {}", cpu);
+#else
+        LOG_WARNING("CPU pinning is not supported on this platform, ignoring cpu {}", cpu);
+#endif
+    }
+}
+
+sharded_runtime::sharded_runtime(uint32_t shard_count, bool pin_threads, timer_service::duration resolution)
+    : m_shardCount(shard_count == 0 ? 1 : shard_count),
+      m_resolution(resolution.count() > 0 ? resolution : timer_service::duration(1)),
+      m_epoch(timer_service::clock::now()),
+      m_shards(std::make_unique<shard_state[]>(m_shardCount)),
+      m_rings(std::make_unique<spsc_ring[]>(size_t(m_shardCount) * m_shardCount))
+{
+    m_threads.reserve(m_shardCount);
+    for (uint32_t i = 0; i < m_shardCount; i++)
+    {
+        m_shards[i].index = i;
+        m_threads.emplace_back(&sharded_runtime::run_shard, this, i, pin_threads);
+    }
+}
+
+sharded_runtime::~sharded_runtime()
+{
+    shutdown();
+    for (auto &thread : m_threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+uint32_t sharded_runtime::current_shard() const noexcept
+{
+    return t_currentRuntime == this ? t_currentShard : no_shard;
+}
+
+sharded_runtime *sharded_runtime::current() noexcept
+{
+    return t_currentRuntime;
+}
+
+void sharded_runtime::shutdown()
+{
+    m_stopRequested.store(true, std::memory_order_seq_cst);
+    for (uint32_t i = 0; i < m_shardCount; i++)
+        wake(m_shards[i]);
+}
+
+// Queues locally on the same shard, on the ring from the calling shard or else on the remote stack
+void sharded_runtime::schedule_impl(uint32_t shard, schedule_operation *operation) noexcept
+{
+    shard_state &target = m_shards[shard % m_shardCount];
+    if (t_currentRuntime == this)
+    {
+        if (t_currentShard == target.index)
+        {
+            operation->m_next = nullptr;
+            if (target.localTail != nullptr)
+                target.localTail->m_next = operation;
+            else
+                target.localHead = operation;
+            target.localTail = operation;
+            return;
+        }
+
+        if (m_rings[size_t(t_currentShard) * m_shardCount + target.index].try_push(operation))
+        {
+            wake(target);
+            return;
+        }
+    }
+
+    schedule_operation *head = target.remoteQueue.load(std::memory_order_relaxed);
+    do
+    {
+        operation->m_next = head;
+    } while (!target.remoteQueue.compare_exchange_weak(head, operation, std::memory_order_release, std::memory_order_relaxed));
+    wake(target);
+}
+
+// Pairs with the fence in run_shard: either we see the sleeper or it sees our work
+void sharded_runtime::wake(shard_state &shard) noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (shard.sleeping.load(std::memory_order_relaxed))
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.notified = true;
+        shard.condition.notify_one();
+    }
+}
+
+uint64_t sharded_runtime::to_tick(timer_service::time_point time, bool roundUp) const noexcept
+{
+    if (time <= m_epoch)
+        return 0;
+
+    auto elapsed = (time - m_epoch).count();
+    auto resolution = m_resolution.count();
+    return static_cast<uint64_t>(roundUp ? (elapsed + resolution - 1) / resolution : elapsed / resolution);
+}
+
+void sharded_runtime::arm(timer_node *node, timer_service::time_point deadline)
+{
+    if (t_currentRuntime != this)
+        throw std::logic_error("sharded_runtime timers must be awaited on one of its shards");
+    m_shards[t_currentShard].wheel.insert(node, to_tick(deadline, true));
+}
+
+bool sharded_runtime::has_work(const shard_state &shard) const noexcept
+{
+    return shard.localHead != nullptr || has_queued_work(shard);
+}
+
+// The queues other threads fill, safe to look at from any shard
+bool sharded_runtime::has_queued_work(const shard_state &shard) const noexcept
+{
+    if (shard.remoteQueue.load(std::memory_order_acquire) != nullptr)
+        return true;
+
+    for (uint32_t i = 0; i < m_shardCount; i++)
+    {
+        if (!m_rings[size_t(i) * m_shardCount + shard.index].empty())
+            return true;
+    }
+    return false;
+}
+
+// Parks the idle shard after shutdown(), true once every shard is parked with nothing queued
+// A parked shard runs no coroutine and so queues nothing, with all of them parked no more hops can
+// arrive. The last one to park checks the queues of all shards and releases the others.
+bool sharded_runtime::drained(shard_state &shard)
+{
+    std::lock_guard<std::mutex> lock(m_exitMutex);
+    if (!shard.parked)
+    {
+        shard.parked = true;
+        m_parkedShards++;
+    }
+    if (m_drained)
+        return true;
+    if (m_parkedShards != m_shardCount)
+        return false;
+
+    for (uint32_t i = 0; i < m_shardCount; i++)
+    {
+        if (has_queued_work(m_shards[i]))
+            return false;
+    }
+    m_drained = true;
+    for (uint32_t i = 0; i < m_shardCount; i++)
+    {
+        if (i != shard.index)
+            wake(m_shards[i]);
+    }
+    return true;
+}
+
+// False once the runtime drained, the shard then exits without running its expired timers
+bool sharded_runtime::unpark(shard_state &shard)
+{
+    std::lock_guard<std::mutex> lock(m_exitMutex);
+    if (m_drained)
+        return false;
+    shard.parked = false;
+    m_parkedShards--;
+    return true;
+}
+
+// Resumes what was queued when the round started: the rings, the remote stack, the expired timers
+// and the local queue. Work queued meanwhile waits for the next round so no source starves.
+size_t sharded_runtime::run_once(shard_state &shard)
+{
+    size_t resumed = 0;
+
+    schedule_operation *local = shard.localHead;
+    shard.localHead = nullptr;
+    shard.localTail = nullptr;
+
+    for (uint32_t i = 0; i < m_shardCount; i++)
+    {
+        spsc_ring &ring = m_rings[size_t(i) * m_shardCount + shard.index];
+        for (size_t budget = spsc_ring::capacity; budget > 0; budget--)
+        {
+            schedule_operation *operation = ring.try_pop();
+            if (operation == nullptr)
+                break;
+            operation->m_awaitingCoroutine.resume();
+            resumed++;
+        }
+    }
+
+    if (shard.remoteQueue.load(std::memory_order_relaxed) != nullptr)
+    {
+        // Reverse the stack into FIFO order
+        schedule_operation *stack = shard.remoteQueue.exchange(nullptr, std::memory_order_acquire);
+        schedule_operation *fifo = nullptr;
+        while (stack != nullptr)
+        {
+            schedule_operation *next = stack->m_next;
+            stack->m_next = fifo;
+            fifo = stack;
+            stack = next;
+        }
+        while (fifo != nullptr)
+        {
+            schedule_operation *next = fifo->m_next;
+            fifo->m_awaitingCoroutine.resume();
+            fifo = next;
+            resumed++;
+        }
+    }
+
+    if (shard.wheel.size() != 0)
+    {
+        timer_node *expired = shard.wheel.advance(to_tick(timer_service::clock::now(), false));
+        while (expired != nullptr)
+        {
+            timer_node *next = expired->m_next;
+            expired->m_callback(expired);
+            expired = next;
+            resumed++;
+        }
+    }
+
+    while (local != nullptr)
+    {
+        // Read m_next first, resuming the coroutine may destroy the operation
+        schedule_operation *next = local->m_next;
+        local->m_awaitingCoroutine.resume();
+        local = next;
+        resumed++;
+    }
+    return resumed;
+}
+
+void sharded_runtime::run_shard(uint32_t index, bool pin)
+{
+    if (pin)
+        pin_thread(index % std::max(1u, std::thread::hardware_concurrency()));
+
+    t_currentRuntime = this;
+    t_currentShard = index;
+    shard_state &shard = m_shards[index];
+
+    for (int idle = 0;;)
+    {
+        if (run_once(shard) != 0)
+        {
+            idle = 0;
+            continue;
+        }
+        if (++idle < spin_rounds)
+        {
+            if (idle >= spin_rounds / 2)
+                std::this_thread::yield();
+            continue;
+        }
+        idle = 0;
+
+        // Sleep until new work, shutdown or the next timer
+        shard.sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (has_work(shard))
+        {
+            shard.sleeping.store(false, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (m_stopRequested.load(std::memory_order_acquire) && drained(shard))
+        {
+            shard.sleeping.store(false, std::memory_order_relaxed);
+            break;
+        }
+
+        std::optional<uint64_t> next = shard.wheel.next_tick();
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            if (next)
+                shard.condition.wait_until(lock, m_epoch + m_resolution * static_cast<int64_t>(*next), [&shard]
+                                           { return shard.notified; });
+            else
+                shard.condition.wait(lock, [&shard]
+                                     { return shard.notified; });
+            shard.notified = false;
+        }
+        shard.sleeping.store(false, std::memory_order_relaxed);
+
+        // Woken for work, drained() must not count it as idle any more
+        if (shard.parked && !unpark(shard))
+            break;
+    }
+
+    t_currentRuntime = nullptr;
+    t_currentShard = no_shard;
+}
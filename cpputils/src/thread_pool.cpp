@@ -0,0 +1,297 @@
+#include <cpputils/asyncio/thread_pool.h>
+
+using namespace cpputils;
+using namespace cpputils::asyncio;
+
+// Chase-Lev work stealing deque
+// "Correct and Efficient Work-Stealing for Weak Memory Models", Le et al. 2013
+// The owner pushes and takes at the bottom, thieves steal from the top. Grown buffers are kept
+// until the deque is destroyed since a thief may still be reading from an old one.
+class thread_pool::local_deque
+{
+public:
+    local_deque()
+    {
+        m_buffer.store(grow(nullptr, 0, 0), std::memory_order_relaxed);
+    }
+
+    // Owner only
+    void push(schedule_operation *operation) noexcept
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+        int64_t top = m_top.load(std::memory_order_acquire);
+        buffer *b = m_buffer.load(std::memory_order_relaxed);
+        if (bottom - top > b->mask)
+        {
+            b = grow(b, top, bottom);
+            m_buffer.store(b, std::memory_order_release);
+        }
+
+        b->slots[bottom & b->mask].store(operation, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_release);
+    }
+
+    // Owner only
+    schedule_operation *take() noexcept
+    {
+        int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+        buffer *b = m_buffer.load(std::memory_order_relaxed);
+        m_bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t top = m_top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            // Empty
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        schedule_operation *operation = b->slots[bottom & b->mask].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            // Last element, race the thieves for it
+            if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                operation = nullptr;
+            m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+        return operation;
+    }
+
+    // Any thread
+    schedule_operation *steal() noexcept
+    {
+        int64_t top = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t bottom = m_bottom.load(std::memory_order_acquire);
+        if (top >= bottom)
+            return nullptr;
+
+        buffer *b = m_buffer.load(std::memory_order_acquire);
+        schedule_operation *operation = b->slots[top & b->mask].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return operation;
+    }
+
+    bool empty() const noexcept
+    {
+        return m_top.load(std::memory_order_acquire) >= m_bottom.load(std::memory_order_acquire);
+    }
+
+private:
+    struct buffer
+    {
+        int64_t mask;
+        uref<std::atomic<schedule_operation *>[]> slots;
+    };
+
+    // Allocates a buffer twice the size of the old one holding its [top, bottom) elements
+    buffer *grow(buffer *old, int64_t top, int64_t bottom)
+    {
+        int64_t capacity = old ? (old->mask + 1) * 2 : 256;
+        auto created = make_uref<buffer>();
+        created->mask = capacity - 1;
+        created->slots = std::make_unique<std::atomic<schedule_operation *>[]>(capacity);
+        for (int64_t i = top; i < bottom; i++)
+            created->slots[i & created->mask].store(old->slots[i & old->mask].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+        m_buffers.push_back(std::move(created));
+        return m_buffers.back().get();
+    }
+
+    alignas(cache_line_size) std::atomic<int64_t> m_top{0};
+    alignas(cache_line_size) std::atomic<int64_t> m_bottom{0};
+    std::atomic<buffer *> m_buffer{nullptr};
+    array_list<uref<buffer>> m_buffers;
+};
+
+// Per worker state, padded so workers never share a line
+struct alignas(cache_line_size) thread_pool::worker_state
+{
+    local_deque deque;
+    uint64_t random = 0;
+};
+
+namespace
+{
+    // Worker the calling thread belongs to
+    thread_local thread_pool *t_currentPool = nullptr;
+    thread_local uint32_t t_currentWorker = 0;
+
+    // Number of steal rounds before a worker parks
+    constexpr int spin_rounds = 64;
+}
+
+thread_pool::thread_pool(uint32_t thread_count)
+    : m_threadCount(thread_count == 0 ? 1 : thread_count),
+      m_workers(std::make_unique<worker_state[]>(m_threadCount))
+{
+    m_threads.reserve(m_threadCount);
+    for (uint32_t i = 0; i < m_threadCount; i++)
+    {
+        m_workers[i].random = 0x9E3779B97F4A7C15ull * (i + 1);
+        m_threads.emplace_back(&thread_pool::run_worker, this, i);
+    }
+}
+
+thread_pool::~thread_pool()
+{
+    shutdown();
+    for (auto &thread : m_threads)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+}
+
+bool thread_pool::is_worker_thread() const noexcept
+{
+    return t_currentPool == this;
+}
+
+void thread_pool::shutdown()
+{
+    m_stopRequested.store(true, std::memory_order_seq_cst);
+    m_wakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+    m_wakeEpoch.notify_all();
+}
+
+// Queues the operation on the local deque when called from a worker, else on the remote stack
+void thread_pool::schedule_impl(schedule_operation *operation) noexcept
+{
+    if (t_currentPool == this)
+    {
+        m_workers[t_currentWorker].deque.push(operation);
+    }
+    else
+    {
+        schedule_operation *head = m_remoteQueue.load(std::memory_order_relaxed);
+        do
+        {
+            operation->m_next = head;
+        } while (!m_remoteQueue.compare_exchange_weak(head, operation, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    wake_one_worker();
+}
+
+// Pairs with the fence in run_worker: either we see the sleeper or it sees our work
+void thread_pool::wake_one_worker() noexcept
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleepingCount.load(std::memory_order_relaxed) != 0)
+    {
+        m_wakeEpoch.fetch_add(1, std::memory_order_seq_cst);
+        m_wakeEpoch.notify_one();
+    }
+}
+
+bool thread_pool::has_any_work() const noexcept
+{
+    if (m_remoteQueue.load(std::memory_order_acquire) != nullptr)
+        return true;
+
+    for (uint32_t i = 0; i < m_threadCount; i++)
+    {
+        if (!m_workers[i].deque.empty())
+            return true;
+    }
+    return false;
+}
+
+thread_pool::schedule_operation *thread_pool::try_get_work(worker_state &state) noexcept
+{
+    if (schedule_operation *operation = state.deque.take())
+        return operation;
+
+    // Take the whole remote stack, keep the oldest operation and queue the rest locally
+    if (m_remoteQueue.load(std::memory_order_relaxed) != nullptr)
+    {
+        schedule_operation *head = m_remoteQueue.exchange(nullptr, std::memory_order_acquire);
+        if (head != nullptr)
+        {
+            // Pushing newest first lets thieves, which take from the top, start with the newest
+            // while the owner works through the oldest
+            schedule_operation *oldest = head;
+            while (oldest->m_next != nullptr)
+            {
+                schedule_operation *next = oldest->m_next;
+                state.deque.push(oldest);
+                oldest = next;
+            }
+            if (!state.deque.empty())
+                wake_one_worker();
+            return oldest;
+        }
+    }
+
+    return try_steal(state);
+}
+
+// Tries every other worker once starting at a random victim
+thread_pool::schedule_operation *thread_pool::try_steal(worker_state &state) noexcept
+{
+    // xorshift64
+    state.random ^= state.random << 13;
+    state.random ^= state.random >> 7;
+    state.random ^= state.random << 17;
+
+    uint32_t start = static_cast<uint32_t>(state.random % m_threadCount);
+    for (uint32_t i = 0; i < m_threadCount; i++)
+    {
+        worker_state &victim = m_workers[(start + i) % m_threadCount];
+        if (&victim == &state)
+            continue;
+
+        if (schedule_operation *operation = victim.deque.steal())
+            return operation;
+    }
+    return nullptr;
+}
+
+void thread_pool::run_worker(uint32_t index)
+{
+    t_currentPool = this;
+    t_currentWorker = index;
+    worker_state &state = m_workers[index];
+
+    for (;;)
+    {
+        schedule_operation *operation = nullptr;
+        for (int round = 0; operation == nullptr && round < spin_rounds; round++)
+        {
+            operation = try_get_work(state);
+            if (operation == nullptr && round >= spin_rounds / 2)
+                std::this_thread::yield();
+        }
+
+        if (operation != nullptr)
+        {
+            operation->m_awaitingCoroutine.resume();
+            continue;
+        }
+
+        // Park until new work or shutdown bumps the epoch
+        m_sleepingCount.fetch_add(1, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint32_t epoch = m_wakeEpoch.load(std::memory_order_seq_cst);
+
+        if (has_any_work())
+        {
+            m_sleepingCount.fetch_sub(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        if (m_stopRequested.load(std::memory_order_acquire))
+        {
+            m_sleepingCount.fetch_sub(1, std::memory_order_relaxed);
+            break;
+        }
+
+        m_wakeEpoch.wait(epoch, std::memory_order_seq_cst);
+        m_sleepingCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    t_currentPool = nullptr;
+}
@@ -0,0 +1,260 @@
+#include <cpputils/asyncio/timer.h>
+#include <bit>
+
+using namespace cpputils;
+using namespace cpputils::asyncio;
+
+void timer_wheel::push(int32_t list, timer_node *node) noexcept
+{
+    node->m_list = list;
+    node->m_prev = nullptr;
+    node->m_next = m_lists[list];
+    if (node->m_next)
+        node->m_next->m_prev = node;
+    m_lists[list] = node;
+
+    if (list < due_list)
+        m_occupied[list / slots] |= uint64_t(1) << (list % slots);
+}
+
+// Empties the list and returns its nodes
+timer_node *timer_wheel::detach(int32_t list) noexcept
+{
+    timer_node *head = m_lists[list];
+    m_lists[list] = nullptr;
+    if (list < due_list)
+        m_occupied[list / slots] &= ~(uint64_t(1) << (list % slots));
+    return head;
+}
+
+// Puts the node at the level of the highest digit where its deadline differs from now
+void timer_wheel::place(timer_node *node) noexcept
+{
+    if (node->m_deadline <= m_now)
+    {
+        push(due_list, node);
+        return;
+    }
+
+    uint32_t level = (std::bit_width(node->m_deadline ^ m_now) - 1) / slot_bits;
+    if (level >= levels)
+    {
+        push(overflow_list, node);
+        return;
+    }
+
+    uint32_t slot = (node->m_deadline >> (level * slot_bits)) & (slots - 1);
+    push(static_cast<int32_t>(level * slots + slot), node);
+}
+
+void timer_wheel::insert(timer_node *node, uint64_t deadline) noexcept
+{
+    node->m_deadline = deadline;
+    place(node);
+    m_size++;
+}
+
+bool timer_wheel::cancel(timer_node *node) noexcept
+{
+    if (node->m_list < 0)
+        return false;
+
+    if (node->m_prev)
+        node->m_prev->m_next = node->m_next;
+    else
+        m_lists[node->m_list] = node->m_next;
+    if (node->m_next)
+        node->m_next->m_prev = node->m_prev;
+
+    if (node->m_list < due_list && m_lists[node->m_list] == nullptr)
+        m_occupied[node->m_list / slots] &= ~(uint64_t(1) << (node->m_list % slots));
+
+    node->m_list = -1;
+    m_size--;
+    return true;
+}
+
+std::optional<uint64_t> timer_wheel::next_tick() const noexcept
+{
+    if (m_lists[due_list])
+        return m_now;
+
+    std::optional<uint64_t> next;
+    for (uint32_t level = 0; level < levels; level++)
+    {
+        // Occupied slots of a level are always past the current digit
+        uint32_t shift = level * slot_bits;
+        uint32_t digit = (m_now >> shift) & (slots - 1);
+        uint64_t later = digit == slots - 1 ? 0 : m_occupied[level] & (~uint64_t(0) << (digit + 1));
+        if (later == 0)
+            continue;
+
+        uint64_t base = (m_now >> (shift + slot_bits)) << (shift + slot_bits);
+        uint64_t tick = base | (uint64_t(std::countr_zero(later)) << shift);
+        if (!next || tick < *next)
+            next = tick;
+    }
+
+    // The overflow list is revisited each time the top level wraps
+    if (m_lists[overflow_list])
+    {
+        constexpr uint32_t span = levels * slot_bits;
+        uint64_t tick = ((m_now >> span) + 1) << span;
+        if (!next || tick < *next)
+            next = tick;
+    }
+    return next;
+}
+
+timer_node *timer_wheel::advance(uint64_t now) noexcept
+{
+    timer_node *expired = nullptr;
+    timer_node *expiredTail = nullptr;
+    auto expire = [&](timer_node *list)
+    {
+        while (list)
+        {
+            timer_node *next = list->m_next;
+            list->m_list = -1;
+            list->m_next = nullptr;
+            if (expiredTail)
+                expiredTail->m_next = list;
+            else
+                expired = list;
+            expiredTail = list;
+            m_size--;
+            list = next;
+        }
+    };
+
+    // Re-places every node of a list relative to the new current tick
+    auto cascade = [&](timer_node *list)
+    {
+        while (list)
+        {
+            timer_node *next = list->m_next;
+            place(list);
+            list = next;
+        }
+    };
+
+    expire(detach(due_list));
+    while (m_now < now)
+    {
+        std::optional<uint64_t> next = next_tick();
+        if (!next || *next > now)
+        {
+            m_now = now;
+            break;
+        }
+
+        m_now = *next;
+        if ((m_now & ((uint64_t(1) << (levels * slot_bits)) - 1)) == 0)
+            cascade(detach(overflow_list));
+
+        for (uint32_t level = levels - 1; level > 0; level--)
+        {
+            uint32_t shift = level * slot_bits;
+            if ((m_now & ((uint64_t(1) << shift) - 1)) != 0)
+                continue;
+            uint32_t digit = (m_now >> shift) & (slots - 1);
+            cascade(detach(static_cast<int32_t>(level * slots + digit)));
+        }
+
+        expire(detach(static_cast<int32_t>(m_now & (slots - 1))));
+        expire(detach(due_list));
+    }
+    return expired;
+}
+
+timer_service::timer_service(duration resolution)
+    : m_resolution(resolution.count() > 0 ? resolution : duration(1)),
+      m_epoch(clock::now())
+{
+    m_thread = std::thread(&timer_service::run, this);
+}
+
+timer_service::~timer_service()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopRequested = true;
+    }
+    m_condition.notify_one();
+    m_thread.join();
+}
+
+timer_service &timer_service::global()
+{
+    static timer_service instance;
+    return instance;
+}
+
+uint64_t timer_service::to_tick(time_point time, bool roundUp) const noexcept
+{
+    if (time <= m_epoch)
+        return 0;
+
+    auto elapsed = (time - m_epoch).count();
+    auto resolution = m_resolution.count();
+    return static_cast<uint64_t>(roundUp ? (elapsed + resolution - 1) / resolution : elapsed / resolution);
+}
+
+void timer_service::arm(timer_node *node, time_point deadline)
+{
+    uint64_t tick = to_tick(deadline, true);
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_wheel.insert(node, tick);
+        if (tick < m_wakeTick)
+        {
+            m_wakeTick = tick;
+            wake = true;
+        }
+    }
+
+    if (wake)
+        m_condition.notify_one();
+}
+
+bool timer_service::cancel(timer_node *node)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_wheel.cancel(node);
+}
+
+size_t timer_service::size() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_wheel.size();
+}
+
+void timer_service::run()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_stopRequested)
+    {
+        timer_node *expired = m_wheel.advance(to_tick(clock::now(), false));
+        if (expired)
+        {
+            // The callbacks may arm or cancel timers
+            lock.unlock();
+            while (expired)
+            {
+                timer_node *next = expired->m_next;
+                expired->m_callback(expired);
+                expired = next;
+            }
+            lock.lock();
+            continue;
+        }
+
+        std::optional<uint64_t> next = m_wheel.next_tick();
+        m_wakeTick = next ? *next : UINT64_MAX;
+        if (next)
+            m_condition.wait_until(lock, m_epoch + m_resolution * static_cast<int64_t>(*next));
+        else
+            m_condition.wait(lock);
+    }
+}
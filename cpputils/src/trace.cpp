@@ -0,0 +1,247 @@
+#include <cpputils/core/trace.h>
+#include <cpputils/core/chrono.h>
+#include <cpputils/core/collections.h>
+#include <cpputils/core/memory.h>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+
+using namespace cpputils;
+using namespace cpputils::trace;
+
+namespace
+{
+	// Events of a single thread, written only by that thread
+	// The writer publishes each event with a release store of the size so exporters can read
+	// a consistent prefix without locking.
+	struct thread_buffer
+	{
+		uint32_t tid;
+		string name;
+		uint64_t generation;
+		uref<event[]> events;
+		size_t capacity;
+		std::atomic<size_t> size{0};
+		std::atomic<uint64_t> dropped{0};
+	};
+
+	// Trace session: owns the buffers of every thread that recorded since start()
+	struct session
+	{
+		std::mutex mutex;
+		array_list<ref<thread_buffer>> buffers;
+		size_t capacity = 1 << 16;
+		uint32_t next_tid = 1;
+		std::atomic<uint64_t> generation{0};
+		std::atomic<int64_t> start{0};
+	};
+
+	session &get_session()
+	{
+		static session instance;
+		return instance;
+	}
+
+	thread_local ref<thread_buffer> t_buffer;
+	thread_local string t_name;
+
+	// Gets a buffer for the calling thread in the current session
+	thread_buffer *current_buffer(session &s)
+	{
+		uint64_t generation = s.generation.load(std::memory_order_acquire);
+		if (t_buffer && t_buffer->generation == generation)
+			return t_buffer.get();
+
+		std::lock_guard<std::mutex> lock(s.mutex);
+		auto buffer = make_ref<thread_buffer>();
+		buffer->tid = s.next_tid++;
+		buffer->name = t_name;
+		buffer->generation = s.generation.load(std::memory_order_relaxed);
+		buffer->capacity = s.capacity;
+		buffer->events = std::make_unique<event[]>(s.capacity);
+		s.buffers.push_back(buffer);
+		t_buffer = buffer;
+		return buffer.get();
+	}
+
+	// Writes a JSON string literal
+	void write_json_string(std::ostream &out, icstring value)
+	{
+		out << '"';
+		for (; value && *value; value++)
+		{
+			char c = *value;
+			switch (c)
+			{
+			case '"':
+				out << "\\\"";
+				break;
+			case '\\':
+				out << "\\\\";
+				break;
+			case '\n':
+				out << "\\n";
+				break;
+			case '\t':
+				out << "\\t";
+				break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20)
+					out << cformat("\\u%04x", c);
+				else
+					out << c;
+			}
+		}
+		out << '"';
+	}
+
+	// Chrome trace-event phase of an event
+	char phase_of(event_type type)
+	{
+		switch (type)
+		{
+		case event_type::begin:
+			return 'B';
+		case event_type::end:
+			return 'E';
+		case event_type::instant:
+			return 'i';
+		case event_type::async_begin:
+			return 'b';
+		case event_type::async_end:
+			return 'e';
+		default:
+			return 'i';
+		}
+	}
+}
+
+// Starts a new session
+void cpputils::trace::start(size_t events_per_thread)
+{
+	session &s = get_session();
+	{
+		std::lock_guard<std::mutex> lock(s.mutex);
+		s.buffers.clear();
+		s.capacity = events_per_thread;
+		s.next_tid = 1;
+		s.start.store(chrono::steady_now().time_since_epoch().count(), std::memory_order_relaxed);
+
+		// Threads notice the new generation on their next event and take a fresh buffer
+		s.generation.fetch_add(1, std::memory_order_release);
+	}
+	detail::g_enabled.store(true, std::memory_order_release);
+}
+
+// Stops the session
+void cpputils::trace::stop()
+{
+	detail::g_enabled.store(false, std::memory_order_release);
+}
+
+// Names the thread
+void cpputils::trace::set_thread_name(const string &name)
+{
+	t_name = name;
+
+	session &s = get_session();
+	std::lock_guard<std::mutex> lock(s.mutex);
+	if (t_buffer)
+		t_buffer->name = name;
+}
+
+// Records the event
+void cpputils::trace::emit(const descriptor *desc, event_type type, uint64_t id, icstring name) noexcept
+{
+	session &s = get_session();
+	thread_buffer *buffer;
+	try
+	{
+		buffer = current_buffer(s);
+	}
+	catch (...)
+	{
+		return;
+	}
+
+	size_t index = buffer->size.load(std::memory_order_relaxed);
+	if (index >= buffer->capacity)
+	{
+		buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	chrono::steady_time_point start{chrono::steady_clock::duration(s.start.load(std::memory_order_relaxed))};
+	buffer->events[index] = {desc, name, chrono::diff_ns(start, chrono::steady_now()), id, type};
+	buffer->size.store(index + 1, std::memory_order_release);
+}
+
+// Counts the dropped events
+uint64_t cpputils::trace::dropped_events()
+{
+	session &s = get_session();
+	std::lock_guard<std::mutex> lock(s.mutex);
+
+	uint64_t dropped = 0;
+	for (auto &buffer : s.buffers)
+		dropped += buffer->dropped.load(std::memory_order_relaxed);
+	return dropped;
+}
+
+// Writes the Chrome trace-event JSON
+void cpputils::trace::write_chrome_json(std::ostream &out)
+{
+	session &s = get_session();
+	std::lock_guard<std::mutex> lock(s.mutex);
+
+	out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	bool first = true;
+	for (auto &buffer : s.buffers)
+	{
+		// Thread name metadata
+		if (!buffer->name.empty())
+		{
+			out << (first ? "\n" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << buffer->tid << ",\"args\":{\"name\":";
+			write_json_string(out, buffer->name.c_str());
+			out << "}}";
+			first = false;
+		}
+
+		size_t size = buffer->size.load(std::memory_order_acquire);
+		for (size_t i = 0; i < size; i++)
+		{
+			const event &e = buffer->events[i];
+			out << (first ? "\n" : ",\n") << "{\"name\":";
+			write_json_string(out, e.name ? e.name : e.desc->name);
+			out << ",\"cat\":";
+			write_json_string(out, e.desc->category);
+			out << ",\"ph\":\"" << phase_of(e.type) << "\",\"pid\":1,\"tid\":" << buffer->tid
+				<< ",\"ts\":" << cformat("%.3f", e.timestamp / 1000.0);
+
+			if (e.type == event_type::instant)
+				out << ",\"s\":\"t\"";
+			if (e.type == event_type::async_begin || e.type == event_type::async_end)
+				out << ",\"id\":\"" << cformat("0x%llx", (unsigned long long)e.id) << "\"";
+			else if (e.id != 0)
+				out << ",\"args\":{\"id\":\"" << cformat("0x%llx", (unsigned long long)e.id) << "\"}";
+			else if (e.type != event_type::end && e.desc->file)
+			{
+				out << ",\"args\":{\"file\":";
+				write_json_string(out, e.desc->file);
+				out << ",\"line\":" << e.desc->line << "}";
+			}
+			out << "}";
+			first = false;
+		}
+	}
+	out << "\n]}\n";
+}
+
+// Saves the trace to a file
+void cpputils::trace::save(const string &path)
+{
+	std::ofstream file(path);
+	if (!file)
+		throw std::runtime_error("Unable to open trace file " + path);
+	write_chrome_json(file);
+}
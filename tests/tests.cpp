@@ -1,159 +1,1255 @@
 #include <cpputils/cpputils.h>
 #include <cpputils/asyncio/coroutine.h>
+#include <cpputils/asyncio/virtual_time.h>
+#include <cpputils/asyncio/thread_pool.h>
+#include <cpputils/asyncio/io_context.h>
+#include <cpputils/asyncio/timer.h>
+#include <cpputils/asyncio/when_all.h>
+#include <cpputils/asyncio/when_any.h>
+#include <cpputils/asyncio/generator.h>
+#include <cpputils/asyncio/async_generator.h>
+#include <cpputils/asyncio/async_mutex.h>
+#include <cpputils/asyncio/async_semaphore.h>
+#include <cpputils/asyncio/async_latch.h>
+#include <cpputils/asyncio/async_barrier.h>
+#include <cpputils/asyncio/channel.h>
+#include <cpputils/asyncio/shared_task.h>
+#include <cpputils/asyncio/with_cancellation.h>
+#include <cpputils/asyncio/resume_on.h>
+#include <cpputils/asyncio/task_group.h>
+#include <cpputils/asyncio/coroutine_stats.h>
+#include <cpputils/asyncio/sharded_runtime.h>
+#include <cpputils/asyncio/file_reader.h>
+#include <cpputils/asyncio/priority_executor.h>
+#include <netinet/in.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <memory>
+#include <string>
 #include <chrono>
+#include <thread>
 
 using namespace std::chrono_literals;
 using namespace cpputils::asyncio;
+using cpputils::array_list;
 
-struct scheduler
+// Timers run on virtual time, so the sleeps below complete instantly and deterministically
+static virtual_executor executor;
+
+auto operator co_await(std::chrono::seconds delay)
+{
+	return executor.sleep_for(delay);
+}
+
+task<void> test_local_logger()
+{
+	LOG_DEBUG("GETTING LOCAL LOGGER IN 2 seconds");
+	co_await 2s;
+
+	// Getting new logger
+	auto logger = cpputils::Debug::get_logger("Cool Name");
+
+	LOG_DEBUG("TESTING LOCAL LOGGER IN 2 seconds");
+	co_await 2s;
+	//  Testing config setting
+	cpputils::Debug::get_global_logger()->set_config(cpputils::log_level::INFO);
+	//  Calling hello world from logger
+	LOGGER_LOG_INFO(logger, "Hello World From Logger: {}", logger->name());
+	// This should not print
+	LOGGER_LOG_DEBUG(logger, "Logging Injection {} \\{{}\\} {}", 5, 12.05, "Meee");
+}
+
+// Coroutine function
+task<void> coroutine_func()
 {
-	using task_func = std::function<bool()>;
+	// Testing hello world
+	LOG_DEBUG("Hello, World!");
+	co_await 1s;
+	LOG_DEBUG("Hello, World! After 1s");
+	// Testing math
+	LOG_DEBUG("add(1, 2) = {}", add(1, 2));
+	LOG_DEBUG("sub(1, 2) = {}", sub(1, 2));
+	LOG_DEBUG("mul(1, 2) = {}", mul(1, 2));
+	LOG_DEBUG("divi(1, 2) = {}", divi(1, 2));
 
-private:
-	std::queue<task_func> task_queue;
-	std::thread running_thread;
-	bool m_stop = false;
-	std::mutex m_mutex;
-	std::condition_variable cv;
+	LOG_DEBUG("SETTING CONFIG IN 2 seconds");
+	co_await 2s;
 
-public:
-	scheduler()
+	co_await test_local_logger();
+}
+
+// Histogram test
+void test_histogram()
+{
+	cpputils::histogram local, merged;
+	for (uint64_t i = 1; i <= 1000; i++)
 	{
-		running_thread = std::thread(&scheduler::event_loop, this);
+		TIME_SCOPE(local);
+		merged.record(i);
 	}
 
-	~scheduler()
+	// Merging and round tripping through the serialized form should keep the percentiles
+	merged.merge(cpputils::histogram::deserialize(local.serialize()));
+	LOG_DEBUG("Histogram: {}", merged);
+	if (merged.count() != 2000 || merged.value_at_percentile(100) < 1000)
+		throw std::runtime_error("Histogram percentiles are wrong");
+}
+
+// Trace test
+void test_trace()
+{
+	cpputils::trace::start();
+	cpputils::trace::set_thread_name("main");
 	{
-		{
-			std::lock_guard<std::mutex> lock(m_mutex);
-			m_stop = true;
-		}
-		cv.notify_one();
-		running_thread.join();
+		TRACE_ZONE("test_trace");
+		TRACE_INSTANT("inside zone");
 	}
+	cpputils::trace::stop();
 
-	void event_loop()
-	{
-		while (!m_stop)
-		{
-			task_func job;
-			{
-				std::unique_lock<std::mutex> lock(m_mutex);
-				cv.wait(lock, [&]
-						{ return !task_queue.empty() || m_stop; });
-				if (task_queue.empty() && m_stop)
-				{
-					return;
-				}
-				job = task_queue.front();
-				task_queue.pop();
-			}
-			try
-			{
-				if (!job())
-					queue(job);
-			}
-			catch (std::runtime_error err)
+	std::stringstream json;
+	cpputils::trace::write_chrome_json(json);
+	if (json.str().find("\"name\":\"test_trace\"") == std::string::npos)
+		throw std::runtime_error("Trace zone was not exported");
+}
+
+// Metrics test
+void test_metrics()
+{
+	auto &registry = cpputils::metrics::registry::global();
+	auto &requests = registry.get_counter("test_requests_total", "Requests handled by the test");
+	auto &latency = registry.get_histogram("test_latency_ns");
+
+	array_list<std::thread> threads;
+	for (int i = 0; i < 4; i++)
+		threads.emplace_back([&]
+							 {
+			for (uint64_t j = 0; j < 1000; j++)
 			{
-				std::cerr << err.what() << std::endl;
-			}
-		}
+				requests.inc();
+				latency.record(j);
+			} });
+	for (auto &thread : threads)
+		thread.join();
+
+	registry.get_gauge("test_threads").set(4);
+	if (requests.value() != 4000 || latency.snapshot().count() != 4000)
+		throw std::runtime_error("Sharded metrics lost updates");
+
+	// Scrape the exposition back
+	auto samples = cpputils::metrics::parse_text(registry.to_text());
+	if (samples["test_requests_total"] != 4000 || samples["test_threads"] != 4 || samples["test_latency_ns_count"] != 4000 ||
+		samples.count("test_latency_ns{quantile=\"0.99\"}") == 0)
+		throw std::runtime_error("Scraped metrics do not match the registry");
+
+	// Shards nobody recorded into stay unallocated
+	auto &idle = registry.get_histogram("test_idle_ns");
+	if (idle.snapshot().count() != 0)
+		throw std::runtime_error("Empty sharded histogram has counts");
+
+	cpputils::metrics::reporter reporter(registry, cpputils::Debug::get_global_logger(), 1h, cpputils::log_level::DEBUG);
+	reporter.report_now();
+}
+
+// Thread pool test: hops onto the pool and sums on the workers
+task<uint64_t> sum_on_pool(thread_pool &pool, uint64_t count)
+{
+	uint64_t sum = 0;
+	for (uint64_t i = 1; i <= count; i++)
+	{
+		co_await pool.schedule();
+		if (!pool.is_worker_thread())
+			throw std::runtime_error("Coroutine did not move onto the thread pool");
+		sum += i;
+	}
+	co_return sum;
+}
+
+void test_thread_pool()
+{
+	thread_pool pool(2);
+	if (sync_wait(sum_on_pool(pool, 100)) != 5050)
+		throw std::runtime_error("Thread pool lost work");
+
+	// Fan out over the pool
+	auto [first, second] = sync_wait(when_all(sum_on_pool(pool, 10), sum_on_pool(pool, 20)));
+	if (first != 55 || second != 210)
+		throw std::runtime_error("when_all returned the wrong results");
+
+	std::vector<task<uint64_t>> shards;
+	for (uint64_t i = 1; i <= 8; i++)
+		shards.push_back(sum_on_pool(pool, i));
+	std::vector<uint64_t> sums = sync_wait(when_all(std::move(shards)));
+	if (sums.size() != 8 || sums[7] != 36)
+		throw std::runtime_error("when_all over a range returned the wrong results");
+
+	auto fastest = sync_wait(when_any(sum_on_pool(pool, 4), sum_on_pool(pool, 4)));
+	if (fastest.index > 1 || fastest.value != 10)
+		throw std::runtime_error("when_any returned the wrong result");
+}
+
+// I/O test: a pipe and a loopback TCP connection driven by the reactor
+task<void> echo_over_loopback(io_context &io)
+{
+	int pipeFds[2];
+	if (pipe2(pipeFds, O_NONBLOCK | O_CLOEXEC) < 0)
+		throw std::runtime_error("pipe2 failed");
+	char buffer[16] = {};
+	co_await io.write(pipeFds[1], "pipe", 4);
+	if (co_await io.read(pipeFds[0], buffer, sizeof(buffer)) != 4 || std::memcmp(buffer, "pipe", 4) != 0)
+		throw std::runtime_error("Pipe read returned the wrong data");
+	close(pipeFds[0]);
+	close(pipeFds[1]);
+
+	int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	socklen_t length = sizeof(address);
+	if (bind(listener, reinterpret_cast<sockaddr *>(&address), length) < 0 || listen(listener, 4) < 0 ||
+		getsockname(listener, reinterpret_cast<sockaddr *>(&address), &length) < 0)
+		throw std::runtime_error("Unable to listen on loopback");
+
+	int client = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	co_await io.connect(client, reinterpret_cast<sockaddr *>(&address), length);
+	int server = co_await io.accept(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+	char head[] = "hello ", tail[] = "world";
+	iovec out[] = {{head, 6}, {tail, 5}};
+	co_await io.writev(client, out, 2);
+	size_t received = 0;
+	while (received < 11)
+		received += co_await io.recv(server, buffer + received, sizeof(buffer) - received);
+	if (std::memcmp(buffer, "hello world", 11) != 0)
+		throw std::runtime_error("Socket received the wrong data");
+
+	close(server);
+	close(client);
+	close(listener);
+}
+
+// Completes at submission, thousands of them overflow both rings of a small io_context
+task<size_t> read_zeros(io_context &io, int fd)
+{
+	char buffer[16];
+	co_return co_await io.read(fd, buffer, sizeof(buffer));
+}
+
+void test_io_context()
+{
+	for (bool force_epoll : {false, true})
+	{
+		io_context io(64, force_epoll);
+		io.run(echo_over_loopback(io));
 	}
 
-	void queue(task_func func)
+	int zero = ::open("/dev/zero", O_RDONLY | O_CLOEXEC);
+	if (zero < 0)
+		throw std::runtime_error("cannot open /dev/zero");
+	for (bool force_epoll : {false, true})
 	{
+		io_context io(8, force_epoll);
+		std::vector<task<size_t>> reads;
+		for (int i = 0; i < 5000; i++)
+			reads.push_back(read_zeros(io, zero));
+		auto sizes = io.run(when_all(std::move(reads)));
+		if (std::accumulate(sizes.begin(), sizes.end(), size_t(0)) != 5000 * 16)
+			throw std::runtime_error("io_context lost operations queued beyond its ring");
+	}
+	close(zero);
+}
+
+// Timer test: the wheel fires every node exactly at its tick, with_timeout races a real sleep
+task<int> sleep_then_return(int value, std::chrono::milliseconds delay)
+{
+	co_await sleep_for(delay);
+	co_return value;
+}
+
+void test_timers()
+{
+	timer_wheel wheel(1000);
+	array_list<timer_node> nodes(500);
+	for (size_t i = 0; i < nodes.size(); i++)
+		wheel.insert(&nodes[i], 1001 + i * 37);
+	wheel.cancel(&nodes[3]);
+	size_t fired = 0;
+	for (uint64_t tick = 1001; tick <= 1001 + 500 * 37; tick++)
+	{
+		for (timer_node *node = wheel.advance(tick); node; node = node->m_next, fired++)
 		{
-			std::lock_guard<std::mutex> lock(m_mutex);
-			task_queue.push(func);
+			if (node->m_deadline != tick)
+				throw std::runtime_error("Timer wheel fired a node at the wrong tick");
 		}
-		cv.notify_one();
+	}
+	if (fired != nodes.size() - 1 || wheel.size() != 0)
+		throw std::runtime_error("Timer wheel lost or kept nodes");
+
+	if (sync_wait(with_timeout(sleep_then_return(1, 1ms), 5s)) != 1)
+		throw std::runtime_error("with_timeout returned the wrong value");
+	try
+	{
+		sync_wait(with_timeout(sleep_then_return(1, 50ms), 1ms));
+		throw std::logic_error("with_timeout did not time out");
+	}
+	catch (const timeout_error &)
+	{
+	}
+}
+
+// Frame allocation test: frames from a user allocator go back to it, pooled frames are reused
+template <typename T>
+struct counting_allocator
+{
+	using value_type = T;
+
+	size_t *allocations;
+	size_t *deallocations;
+
+	counting_allocator(size_t *allocations, size_t *deallocations) noexcept : allocations(allocations), deallocations(deallocations) {}
+
+	template <typename U>
+	counting_allocator(const counting_allocator<U> &other) noexcept : allocations(other.allocations), deallocations(other.deallocations) {}
+
+	T *allocate(size_t count)
+	{
+		(*allocations)++;
+		return std::allocator<T>().allocate(count);
+	}
+
+	void deallocate(T *pointer, size_t count) noexcept
+	{
+		(*deallocations)++;
+		std::allocator<T>().deallocate(pointer, count);
 	}
 };
 
-static scheduler sc;
+// GCC 12 reports a templated member operator new as mismatched with any operator delete, even the placement ones
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+task<int> allocated_value(std::allocator_arg_t, [[maybe_unused]] counting_allocator<int> allocator, int value)
+{
+	co_return value;
+}
+
+struct allocating_service
+{
+	int base = 40;
+
+	task<int> add(std::allocator_arg_t, [[maybe_unused]] counting_allocator<int> allocator, int value)
+	{
+		co_return base + value;
+	}
+};
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+// Completes without suspending and returns the awaiting coroutine's frame
+struct frame_address
+{
+	void *address = nullptr;
+
+	bool await_ready() const noexcept { return false; }
+	bool await_suspend(std::coroutine_handle<> coroutine) noexcept
+	{
+		address = coroutine.address();
+		return false;
+	}
+	void *await_resume() const noexcept { return address; }
+};
+
+task<void *> own_frame()
+{
+	co_return co_await frame_address{};
+}
+
+task<bool> frames_reused()
+{
+	void *first = co_await own_frame();
+	void *second = co_await own_frame();
+	co_return first == second;
+}
 
-task<void> sleep(std::chrono::seconds delay)
+void test_frame_allocation()
 {
+	size_t allocations = 0, deallocations = 0;
+	counting_allocator<int> allocator(&allocations, &deallocations);
+	// The task temporary, and so the frame, is gone once the statement ends
+	int value = sync_wait(allocated_value(std::allocator_arg, allocator, 2));
+	if (value != 2 || allocations != 1 || deallocations != 1)
+		throw std::runtime_error("Coroutine frame did not come from and return to its allocator");
+
+	allocating_service service;
+	value = sync_wait(service.add(std::allocator_arg, allocator, 2));
+	if (value != 42 || allocations != 2 || deallocations != 2)
+		throw std::runtime_error("Member coroutine frame did not come from and return to its allocator");
+
+#if !defined(CPPUTILS_NO_COROUTINE_FRAME_POOL)
+	// The first frame is freed before the second is allocated, both are the same size
+	if (!sync_wait(frames_reused()))
+		throw std::runtime_error("Freed coroutine frame was not reused");
+#endif
+}
+
+// Generator test: a lazy pipeline over a synchronous and an asynchronous source
+generator<int> numbers(int count)
+{
+	for (int i = 0; i < count; i++)
+		co_yield i;
+}
+
+async_generator<int> numbers_on(thread_pool &pool, int count)
+{
+	for (int i = 0; i < count; i++)
+	{
+		co_await pool.schedule();
+		co_yield i;
+	}
+}
+
+task<int> sum_async_pipeline(thread_pool &pool)
+{
+	int sum = 0;
+	auto squares = numbers_on(pool, 100) | filter([](int i)
+												  { return i % 2 == 1; }) |
+				   transform([](int i)
+							 { return i * i; }) |
+				   take(3);
+	for (auto it = co_await squares.begin(); it != squares.end(); co_await ++it)
+		sum += *it;
+	co_return sum;
+}
+
+void test_generators()
+{
+	int sum = 0;
+	for (int square : numbers(100) | filter([](int i)
+											{ return i % 2 == 1; }) |
+						  transform([](int i)
+									{ return i * i; }) |
+						  take(3))
+		sum += square;
+	if (sum != 1 + 9 + 25)
+		throw std::runtime_error("generator pipeline produced the wrong items");
+
+	thread_pool pool(2);
+	if (sync_wait(sum_async_pipeline(pool)) != 1 + 9 + 25)
+		throw std::runtime_error("async_generator pipeline produced the wrong items");
+}
+
+// Synchronization test: workers on a pool sharing a counter, a permit and phases
+task<void> synchronized_worker(thread_pool &pool, async_mutex &mutex, async_semaphore &semaphore, async_barrier &barrier, async_latch &latch, int &counter)
+{
+	for (int i = 0; i < 100; i++)
+	{
+		co_await pool.schedule();
+		auto lock = co_await mutex.scoped_lock_async();
+		counter++;
+	}
+
+	co_await semaphore.acquire();
+	semaphore.release();
+
+	co_await barrier.arrive_and_wait();
+	if (counter != 400)
+		throw std::runtime_error("async_barrier let a worker through early");
+
+	latch.count_down();
+	co_await latch;
+}
+
+void test_synchronization()
+{
+	thread_pool pool(4);
+	async_mutex mutex;
+	async_semaphore semaphore(1);
+	async_barrier barrier(4);
+	async_latch latch(4);
+	int counter = 0;
+
+	std::vector<task<void>> workers;
+	for (int i = 0; i < 4; i++)
+		workers.push_back(synchronized_worker(pool, mutex, semaphore, barrier, latch, counter));
+	sync_wait(when_all(std::move(workers)));
+
+	if (counter != 400 || !latch.is_ready() || semaphore.available() != 1)
+		throw std::runtime_error("async synchronization primitives lost an update");
+
+	async_auto_reset_event event(true);
+	sync_wait([&]() -> task<void>
+			  { co_await event; }());
+	if (event.is_set())
+		throw std::runtime_error("async_auto_reset_event did not reset");
+}
+
+// Channel test: producers filling a small bounded channel faster than it drains
+task<void> produce_into(thread_pool &pool, channel<int> &numbers, int first, int count)
+{
+	co_await pool.schedule();
+	for (int i = first; i < first + count; i++)
+		co_await numbers.send(i);
+}
+
+task<void> close_after(channel<int> &numbers, std::vector<task<void>> producers)
+{
+	co_await when_all(std::move(producers));
+	numbers.close();
+}
+
+task<long> drain(thread_pool &pool, channel<int> &numbers)
+{
+	co_await pool.schedule();
+	long sum = 0;
+	std::vector<int> batch;
+	while (co_await numbers.receive_many(batch, 8))
+	{
+		for (int number : batch)
+			sum += number;
+		batch.clear();
+	}
+	co_return sum;
+}
+
+void test_channel()
+{
+	thread_pool pool(4);
+	channel<int> numbers(4);
+
+	std::vector<task<void>> producers;
+	for (int i = 0; i < 4; i++)
+		producers.push_back(produce_into(pool, numbers, i * 1000, 1000));
+
+	auto [closed, first, second] = sync_wait(when_all(close_after(numbers, std::move(producers)), drain(pool, numbers), drain(pool, numbers)));
+	if (first + second != 3999L * 4000 / 2)
+		throw std::runtime_error("channel lost or duplicated items");
+	if (numbers.try_send(0) || numbers.try_receive())
+		throw std::runtime_error("closed channel still accepts items");
+}
+
+// Blocking bridge test: several awaitables waited on from synchronous code
+void test_sync_wait_all()
+{
+	thread_pool pool(2);
+	auto [first, second, ready] = sync_wait_all(sum_on_pool(pool, 10), sum_on_pool(pool, 100), sleep_then_return(7, std::chrono::milliseconds(1)));
+	if (first != 55 || second != 5050 || ready != 7)
+		throw std::runtime_error("sync_wait_all returned the wrong results");
+
+	manual_reset_event event;
+	if (event.wait_for(std::chrono::milliseconds(1)))
+		throw std::runtime_error("manual_reset_event reported set before set()");
+	std::thread setter([&event]
+					   { event.set(); });
+	event.wait();
+	setter.join();
+
+	// A reset() while a thread sleeps in wait() must not lose the wake up of the next set()
+	manual_reset_event parked;
+	std::atomic<bool> woken = false;
+	std::thread waiter([&]
+					   { parked.wait(); woken = true; });
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	parked.reset();
+	parked.set();
+	for (int i = 0; i < 200 && !woken; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	if (!woken)
+	{
+		waiter.detach();
+		throw std::runtime_error("manual_reset_event waiter missed the set() after a reset()");
+	}
+	waiter.join();
+}
+
+// Shared task test: concurrent consumers of one expensive computation
+shared_task<uint64_t> load_once(thread_pool &pool, std::atomic<int> &runs)
+{
+	runs++;
+	co_return co_await sum_on_pool(pool, 100);
+}
+
+task<uint64_t> consume_shared(thread_pool &pool, shared_task<uint64_t> value)
+{
+	co_await pool.schedule();
+	co_return co_await value;
+}
+
+void test_shared_task()
+{
+	thread_pool pool(4);
+	std::atomic<int> runs = 0;
+	shared_task<uint64_t> value = load_once(pool, runs);
+
+	std::vector<task<uint64_t>> consumers;
+	for (int i = 0; i < 8; i++)
+		consumers.push_back(consume_shared(pool, value));
+	for (uint64_t result : sync_wait(when_all(std::move(consumers))))
+	{
+		if (result != 5050)
+			throw std::runtime_error("shared_task handed out the wrong result");
+	}
+	if (runs != 1 || !value.is_ready() || sync_wait(value) != 5050)
+		throw std::runtime_error("shared_task ran more than once");
+}
+
+task<size_t> read_pipe_forever(io_context &io, int fd)
+{
+	char buffer[16];
+	co_return co_await io.read(fd, buffer, sizeof(buffer));
+}
+
+task<int> nested_sleep(std::chrono::seconds delay)
+{
+	co_await sleep_for(delay);
+	co_return 1;
+}
+
+task<int> sleep_observing(bool &cancelled)
+{
+	try
+	{
+		co_await sleep_for(60s);
+	}
+	catch (const operation_cancelled &)
+	{
+		cancelled = true;
+		throw;
+	}
+	co_return 0;
+}
+
+// Rethrows, but only after noting that the wait itself saw the cancellation
+template <typename FUNC>
+task<void> wait_for_cancellation(FUNC wait, bool &observed)
+{
+	try
+	{
+		co_await wait();
+	}
+	catch (const operation_cancelled &)
+	{
+		observed = true;
+		throw;
+	}
+}
+
+// True if the wait ended with operation_cancelled rather than being abandoned by with_cancellation
+template <typename FUNC>
+bool cancelled_while_waiting(FUNC wait)
+{
+	cancellation_source source;
+	std::thread canceller([&]
+						  {
+							  std::this_thread::sleep_for(10ms);
+							  source.request_cancellation(); });
+	bool observed = false;
+	try
+	{
+		sync_wait(with_cancellation(wait_for_cancellation(std::move(wait), observed), source.token()));
+	}
+	catch (const operation_cancelled &)
+	{
+	}
+	// The waiter is resumed by request_cancellation(), so it has finished once the canceller has
+	canceller.join();
+	return observed;
+}
+
+void test_cancellation()
+{
+	cancellation_source source;
+	int callbacks = 0;
+	cancellation_registration registration(source.token(), [&]
+										   { callbacks++; });
+	std::thread canceller([&]
+						  {
+							  std::this_thread::sleep_for(10ms);
+							  source.request_cancellation(); });
+
+	// The sleep two tasks down observes the token bound by with_cancellation
+	auto start = std::chrono::steady_clock::now();
+	try
+	{
+		sync_wait(with_cancellation([]() -> task<int>
+									{ co_return co_await nested_sleep(60s) + 1; }(),
+									source.token()));
+		throw std::runtime_error("with_cancellation did not throw");
+	}
+	catch (const operation_cancelled &)
+	{
+	}
+	canceller.join();
+	if (callbacks != 1 || std::chrono::steady_clock::now() - start > 10s)
+		throw std::runtime_error("cancellation did not interrupt the sleep");
+
+	// A pending read is withdrawn from the reactor, with either backend
+	for (bool forceEpoll : {false, true})
+	{
+		io_context io(64, forceEpoll);
+		int fds[2];
+		if (pipe2(fds, O_NONBLOCK) != 0)
+			throw std::runtime_error("pipe2 failed");
+
+		cancellation_source readSource;
+		std::thread readCanceller([&]
+								  {
+									  std::this_thread::sleep_for(10ms);
+									  readSource.request_cancellation(); });
+		bool cancelled = false;
+		try
+		{
+			cancellation_token token = readSource.token();
+			task<size_t> reader = read_pipe_forever(io, fds[0]);
+			reader.set_cancellation_token(token);
+			io.run(std::move(reader));
+		}
+		catch (const operation_cancelled &)
+		{
+			cancelled = true;
+		}
+		readCanceller.join();
+		close(fds[0]);
+		close(fds[1]);
+		if (!cancelled)
+			throw std::runtime_error("cancelled read completed");
+	}
+
+	// Synchronisation primitives unlink cancelled waiters and stay usable afterwards
 	async_manual_reset_event event;
+	if (!cancelled_while_waiting([&]() -> task<void>
+								 { co_await event; }))
+		throw std::runtime_error("event wait ignored cancellation");
+	event.set();
+
+	async_semaphore semaphore(0);
+	if (!cancelled_while_waiting([&]() -> task<void>
+								 { co_await semaphore.acquire(); }))
+		throw std::runtime_error("semaphore acquire ignored cancellation");
+	semaphore.release();
+	if (!semaphore.try_acquire())
+		throw std::runtime_error("cancelled acquire kept a permit");
+
+	async_mutex mutex;
+	if (!mutex.try_lock())
+		throw std::runtime_error("try_lock failed on a free mutex");
+	if (!cancelled_while_waiting([&]() -> task<void>
+								 { co_await mutex.lock_async(); }))
+		throw std::runtime_error("mutex lock ignored cancellation");
+	mutex.unlock();
+	if (!mutex.try_lock())
+		throw std::runtime_error("cancelled lock kept the mutex");
+	mutex.unlock();
+
+	channel<int> empty(4);
+	if (!cancelled_while_waiting([&]() -> task<void>
+								 { co_await empty.receive(); }))
+		throw std::runtime_error("channel receive ignored cancellation");
+	empty.try_send(7);
+	if (empty.try_receive() != 7)
+		throw std::runtime_error("cancelled receive took an item");
+
+	channel<int> full(1);
+	full.try_send(1);
+	if (!cancelled_while_waiting([&]() -> task<void>
+								 { co_await full.send(2); }))
+		throw std::runtime_error("channel send ignored cancellation");
+	if (full.try_receive() != 1 || full.try_receive())
+		throw std::runtime_error("cancelled send delivered its item");
+
+	// Combinators pass the token on to the tasks they start
+	if (!cancelled_while_waiting([]() -> task<void>
+								 { co_await when_all(nested_sleep(60s), nested_sleep(60s)); }))
+		throw std::runtime_error("when_all children ignored cancellation");
+	if (!cancelled_while_waiting([]() -> task<void>
+								 { co_await when_any(nested_sleep(60s), nested_sleep(60s)); }))
+		throw std::runtime_error("when_any children ignored cancellation");
+
+	// A timeout cancels the task before the awaiter resumes
+	bool interrupted = false;
+	try
+	{
+		sync_wait(with_timeout(sleep_observing(interrupted), 10ms));
+		throw std::runtime_error("with_timeout did not time out");
+	}
+	catch (const timeout_error &)
+	{
+	}
+	if (!interrupted)
+		throw std::runtime_error("with_timeout did not cancel the task");
+}
+
+task<int> wake_on_pool(thread_pool &pool, async_manual_reset_event &event, bool resumeOn)
+{
+	if (resumeOn)
+		co_await resume_on(pool, event);
+	else
+		co_await event;
+	co_return pool.is_worker_thread() ? 1 : 0;
+}
+
+// Started after the waiters by when_all, so they are all suspended by then
+task<int> set_event(thread_pool &pool, async_manual_reset_event &event, bool post)
+{
+	if (post)
+		event.set(pool);
+	else
+		event.set();
+	co_return 0;
+}
+
+void test_event_fan_out()
+{
+	thread_pool pool(4);
+	for (bool post : {true, false})
+	{
+		// Posted waiters resume on the pool by themselves, inline ones only through resume_on
+		async_manual_reset_event event;
+		std::vector<task<int>> waiters;
+		for (int i = 0; i < 1000; i++)
+			waiters.push_back(wake_on_pool(pool, event, !post));
+		waiters.push_back(set_event(pool, event, post));
+
+		int onPool = 0;
+		for (int value : sync_wait(when_all(std::move(waiters))))
+			onPool += value;
+		if (onPool != 1000)
+			throw std::runtime_error("waiters did not resume on the pool");
+	}
+}
+
+task<int> read_config_value()
+{
+	co_return 20;
+}
+
+void test_continuations()
+{
+	thread_pool pool(2);
+
+	// Callables are stored in the frames, a continuation returning a task is flattened
+	auto pipeline = read_config_value() | transform([](int value)
+													{ return value + 1; }) |
+					transform([&](int value) -> task<std::string>
+							  { co_return std::to_string(value * 2) + (pool.is_worker_thread() ? " on pool" : ""); }) |
+					on(pool);
+	if (sync_wait(std::move(pipeline)) != "42 on pool")
+		throw std::runtime_error("task pipeline produced the wrong value");
+
+	auto owned = std::make_unique<int>(3);
+	auto created = task<int>::create([](std::unique_ptr<int> value, int factor)
+									 { return *value * factor; },
+									 std::move(owned), 5);
+	if (sync_wait(std::move(created).then([](int value)
+										  { return value + 1; })) != 16)
+		throw std::runtime_error("create moved the wrong arguments");
+
+	// The explicit forms callers used with the std::function signatures still compile
+	auto legacy = task<int>::create<int, int>([](int left, int right)
+											  { return left * right; },
+											  6, 7);
+	if (sync_wait(legacy.then<double>([](int value)
+									  { return value / 4; })) != 10.0)
+		throw std::runtime_error("then<U> did not convert the result");
+}
+
+void test_parallel()
+{
+	cpputils::parallel_pool pool(4);
+	array_list<int64_t> values(300000);
+	uint64_t seed = 1;
+	for (auto &value : values)
+	{
+		seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+		value = static_cast<int64_t>(seed >> 20) - (int64_t(1) << 43);
+	}
+	auto expected = values;
+	std::sort(expected.begin(), expected.end());
+
+	auto merged = values;
+	cpputils::parallel_sort(pool, merged.begin(), merged.end());
+	auto radix = values;
+	cpputils::parallel_radix_sort(pool, radix.begin(), radix.end());
+	if (merged != expected || radix != expected)
+		throw std::runtime_error("parallel sorts disagree with std::sort");
+
+	// Radix sort by key is stable
+	array_list<std::pair<uint8_t, size_t>> records(100000);
+	for (size_t i = 0; i < records.size(); i++)
+		records[i] = {static_cast<uint8_t>(values[i] & 7), i};
+	cpputils::parallel_radix_sort(pool, records.begin(), records.end(), [](const auto &record)
+						{ return record.first; });
+	for (size_t i = 1; i < records.size(); i++)
+	{
+		if (records[i - 1] > records[i])
+			throw std::runtime_error("parallel_radix_sort is not stable");
+	}
+
+	array_list<int64_t> doubled(values.size());
+	cpputils::parallel_transform(pool, values.begin(), values.end(), doubled.begin(), [](int64_t value)
+					   { return value * 2; });
+	int64_t sum = cpputils::parallel_reduce(pool, doubled.begin(), doubled.end(), int64_t(0), std::plus<>{});
+	if (sum != 2 * std::accumulate(values.begin(), values.end(), int64_t(0)))
+		throw std::runtime_error("parallel_reduce produced the wrong sum");
+
+	std::atomic<size_t> visited = 0;
+	cpputils::parallel_for(pool, 0, 100000, [&](size_t)
+				 { visited.fetch_add(1, std::memory_order_relaxed); });
+	if (visited != 100000)
+		throw std::runtime_error("parallel_for skipped indices");
+}
+
+task<void> bounded_child(thread_pool &pool, std::atomic<int> &inFlight, std::atomic<int> &peak)
+{
+	int now = inFlight.fetch_add(1) + 1;
+	int seen = peak.load();
+	while (now > seen && !peak.compare_exchange_weak(seen, now))
+	{
+	}
+	co_await pool.schedule();
+	inFlight.fetch_sub(1);
+}
+
+task<void> failing_child(thread_pool &pool)
+{
+	co_await pool.schedule();
+	throw std::runtime_error("child failed");
+}
+
+task<void> spawn_children(thread_pool &pool, std::atomic<int> &inFlight, std::atomic<int> &peak)
+{
+	task_group group(4);
+	for (int i = 0; i < 1000; i++)
+		co_await group.spawn(bounded_child(pool, inFlight, peak));
+	co_await group.join();
+}
+
+task<void> spawn_failing(thread_pool &pool)
+{
+	// The failure cancels the sleeping siblings through the group's token
+	task_group group;
+	for (int i = 0; i < 8; i++)
+		co_await group.spawn(sleep_then_return(i, std::chrono::milliseconds(60000)));
+	co_await group.spawn(failing_child(pool));
+	co_await group.join();
+}
+
+// Only the spawner carries the token, the group passes its cancellation on to the children
+task<void> spawn_sleepers()
+{
+	task_group group;
+	for (int i = 0; i < 8; i++)
+		co_await group.spawn(sleep_then_return(i, std::chrono::milliseconds(60000)));
+	co_await group.join();
+}
+
+void test_task_group()
+{
+	thread_pool pool(4);
+	std::atomic<int> inFlight = 0;
+	std::atomic<int> peak = 0;
+	sync_wait(spawn_children(pool, inFlight, peak));
+	if (inFlight != 0 || peak > 4)
+		throw std::runtime_error("task_group exceeded its concurrency limit");
+
 	auto start = std::chrono::steady_clock::now();
+	try
+	{
+		sync_wait(spawn_failing(pool));
+		throw std::runtime_error("task_group swallowed the child's exception");
+	}
+	catch (const std::runtime_error &error)
+	{
+		if (std::string(error.what()) != "child failed" || std::chrono::steady_clock::now() - start > 10s)
+			throw std::runtime_error("task_group did not cancel the siblings");
+	}
 
-	sc.queue([&, start, d = delay]
-			 {
-			if (decltype(start)::clock::now() - start > d) {
-				event.set();
-				return true;
-			} else {
-				return false;
-			} });
+	cancellation_source source;
+	std::thread canceller([&]
+						  {
+							  std::this_thread::sleep_for(10ms);
+							  source.request_cancellation(); });
+	start = std::chrono::steady_clock::now();
+	bool cancelled = false;
+	try
+	{
+		cancellation_token token = source.token();
+		task<void> parent = spawn_sleepers();
+		parent.set_cancellation_token(token);
+		sync_wait(std::move(parent));
+	}
+	catch (const operation_cancelled &)
+	{
+		cancelled = true;
+	}
+	canceller.join();
+	if (!cancelled || std::chrono::steady_clock::now() - start > 10s)
+		throw std::runtime_error("cancelling the spawner did not cancel the children");
+}
 
+task<void> stats_child(async_manual_reset_event &event)
+{
 	co_await event;
 }
 
-// Not thread safe yet
-// logging configuration wasnt applied completely
-// Lets modify to a more event based apporach
-auto operator co_await(std::chrono::seconds delay)
+task<void> stats_children(async_manual_reset_event &event)
 {
-	struct sleep_awaitable
+	auto setter = [](async_manual_reset_event &event) -> task<void>
 	{
-		sleep_awaitable(std::chrono::seconds d) : delay(d) {}
+		event.set();
+		co_return;
+	};
+	co_await when_all(stats_child(event), stats_child(event), stats_child(event), setter(event));
+}
 
-		bool await_ready() const noexcept { return false; }
+void test_coroutine_stats()
+{
+	coroutine_stats::reset();
+	async_manual_reset_event event;
+	sync_wait(stats_children(event));
+
+	auto entries = coroutine_stats::top(100, coroutine_stats::order::resumes);
+#if defined(CPPUTILS_COROUTINE_STATS)
+	auto child = std::find_if(entries.begin(), entries.end(), [](const coroutine_stats::entry &entry)
+							  { return entry.function.find("stats_child") != std::string::npos; });
+	if (child == entries.end() || child->completions != 3 || child->resumes != 6)
+		throw std::runtime_error("Coroutine stats did not count the children's resumes");
+	if (child->waits != 3 || child->waiting_ns > child->suspended_ns)
+		throw std::runtime_error("Coroutine stats did not charge the event waits to the children");
+	if (std::any_of(entries.begin(), entries.end(), [](const coroutine_stats::entry &entry)
+					{ return entry.file.find("reset_events.h") != std::string::npos; }))
+		throw std::runtime_error("Coroutine stats recorded a wait under the awaiter");
+	if (coroutine_stats::report(5).find("stats_child") == std::string::npos)
+		throw std::runtime_error("Coroutine stats report misses the children");
+#else
+	if (!entries.empty())
+		throw std::runtime_error("Coroutine stats recorded without CPPUTILS_COROUTINE_STATS");
+#endif
+}
 
-		void await_suspend(std::coroutine_handle<> h) const
+// Every shard counts its visits without atomics, a wrong hop shows up as a lost count
+task<void> shard_visitor(sharded_runtime &runtime, std::vector<uint64_t> &visits, int id)
+{
+	for (uint32_t i = 0; i < 200; i++)
+	{
+		uint32_t shard = (id + i) % runtime.shard_count();
+		co_await on_shard(runtime, shard);
+		if (runtime.current_shard() != shard)
+			throw std::runtime_error("on_shard resumed on the wrong shard");
+		visits[shard * 8]++;
+		if (i % 50 == 0)
 		{
-			sleep(delay).run_sync();
-			h.resume();
+			co_await runtime.sleep_for(1ms);
+			co_await runtime.yield();
+			if (runtime.current_shard() != shard)
+				throw std::runtime_error("Shard timer resumed on another shard");
 		}
+	}
+}
 
-		void await_resume() const noexcept {}
+task<void> visit_shards(sharded_runtime &runtime, std::vector<uint64_t> &visits)
+{
+	co_await on_shard(runtime, 0);
+	std::vector<task<void>> visitors;
+	for (int i = 0; i < 300; i++)
+		visitors.push_back(shard_visitor(runtime, visits, i));
+	co_await when_all(std::move(visitors));
+}
 
-		std::chrono::seconds delay;
-	};
+// Still running on shard 0 when shutdown() is called, then hops to a shard that had gone idle
+task<uint32_t> hop_after_shutdown(sharded_runtime &runtime, std::atomic<bool> &started)
+{
+	co_await on_shard(runtime, 0);
+	started = true;
+	std::this_thread::sleep_for(50ms);
+	co_await on_shard(runtime, 1);
+	co_return runtime.current_shard();
+}
 
-	return sleep_awaitable{delay};
+void test_sharded_runtime()
+{
+	sharded_runtime runtime(4, false);
+	// One cache line per shard
+	std::vector<uint64_t> visits(4 * 8);
+	sync_wait(visit_shards(runtime, visits));
+	if (std::accumulate(visits.begin(), visits.end(), uint64_t(0)) != 300 * 200)
+		throw std::runtime_error("Shard visits were lost");
+
+	sharded_runtime stopping(2, false);
+	std::atomic<bool> started = false;
+	uint32_t finishedOn = sharded_runtime::no_shard;
+	std::thread driver([&]
+					   { finishedOn = sync_wait(hop_after_shutdown(stopping, started)); });
+	while (!started)
+		std::this_thread::yield();
+	stopping.shutdown();
+	driver.join();
+	if (finishedOn != 1)
+		throw std::runtime_error("A hop after shutdown() was lost");
 }
 
-task<void> test_local_logger()
+// File reader test: small buffers so that lines and frames straddle them
+task<size_t> read_lines(async_file_reader &reader)
 {
-	LOG_DEBUG("GETTING LOCAL LOGGER IN 2 seconds");
-	co_await 2s;
+	size_t count = 0;
+	auto lines = reader.lines();
+	for (auto it = co_await lines.begin(); it != lines.end(); co_await ++it)
+	{
+		if (*it != "line " + std::to_string(count))
+			throw std::runtime_error("async_file_reader yielded a wrong line");
+		count++;
+	}
+	co_return count;
+}
 
-	// Getting new logger
-	auto logger = cpputils::Debug::get_logger("Cool Name");
+task<size_t> read_frames(async_file_reader &reader)
+{
+	size_t count = 0;
+	auto frames = reader.length_prefixed(2);
+	for (auto it = co_await frames.begin(); it != frames.end(); co_await ++it)
+	{
+		if (*it != std::string(count % 300, char('a' + count % 26)))
+			throw std::runtime_error("async_file_reader yielded a wrong frame");
+		count++;
+	}
+	co_return count;
+}
 
-	LOG_DEBUG("TESTING LOCAL LOGGER IN 2 seconds");
-	co_await 2s;
-	//  Testing config setting
-	cpputils::Debug::get_global_logger()->set_config(cpputils::log_level::INFO);
-	//  Calling hello world from logger
-	LOGGER_LOG_INFO(logger, "Hello World From Logger: {}", logger->name());
-	// This should not print
-	LOGGER_LOG_DEBUG(logger, "Logging Injection {} \\{{}\\} {}", 5, 12.05, "Meee");
+// Creates an empty file no other test run can collide with
+std::string make_temp_file()
+{
+	char path[] = "/tmp/cpputils_test_XXXXXX";
+	int fd = ::mkstemp(path);
+	if (fd < 0)
+		throw std::runtime_error("mkstemp failed");
+	::close(fd);
+	return path;
 }
 
-// Coroutine function
-task<void> coroutine_func()
+void test_file_reader()
 {
-	// Testing hello world
-	LOG_DEBUG("Hello, World!");
-	co_await 1s;
-	LOG_DEBUG("Hello, World! After 1s");
-	// Testing math
-	LOG_DEBUG("add(1, 2) = {}", add(1, 2));
-	LOG_DEBUG("sub(1, 2) = {}", sub(1, 2));
-	LOG_DEBUG("mul(1, 2) = {}", mul(1, 2));
-	LOG_DEBUG("divi(1, 2) = {}", divi(1, 2));
+	std::string linesPath = make_temp_file();
+	std::string framesPath = make_temp_file();
+	{
+		std::ofstream lines(linesPath);
+		for (int i = 0; i < 20000; i++)
+			lines << "line " << i << "\n";
+		std::ofstream frames(framesPath, std::ios::binary);
+		for (int i = 0; i < 2000; i++)
+		{
+			uint16_t length = i % 300;
+			frames.write(reinterpret_cast<const char *>(&length), sizeof(length));
+			frames << std::string(length, char('a' + i % 26));
+		}
+	}
 
-	LOG_DEBUG("SETTING CONFIG IN 2 seconds");
-	co_await 2s;
+	for (bool force_epoll : {false, true})
+	{
+		io_context io(64, force_epoll);
+		async_file_reader lines(io, linesPath, {4096, 3, true});
+		async_file_reader frames(io, framesPath, {4096, 2});
+		// Some filesystems refuse O_DIRECT, the reader then falls back to the page cache
+		LOG_DEBUG("async_file_reader O_DIRECT: {}", lines.direct() ? "yes" : "refused, page cache");
+		if (frames.direct())
+			throw std::runtime_error("async_file_reader opened a buffered file with O_DIRECT");
+		if (io.run(read_lines(lines)) != 20000 || io.run(read_frames(frames)) != 2000)
+			throw std::runtime_error("async_file_reader lost records");
+	}
+	::unlink(linesPath.c_str());
+	::unlink(framesPath.c_str());
+}
 
-	co_await test_local_logger();
+// Priority test: a single worker held by a gate while the queue fills up, then by a busy loop
+task<void> hold_worker(priority_executor &executor, std::atomic<bool> &open)
+{
+	co_await executor.schedule(task_priority::high);
+	while (!open.load())
+		std::this_thread::yield();
+}
+
+task<void> record_run(priority_executor &executor, std::string &order, char name, task_priority priority)
+{
+	co_await executor.schedule(priority);
+	order += name;
+}
+
+task<void> record_run_before(priority_executor &executor, std::string &order, char name, std::chrono::milliseconds deadline)
+{
+	co_await executor.schedule_before(priority_executor::clock::now() + deadline);
+	order += name;
+}
+
+task<void> open_gate(std::atomic<bool> &open)
+{
+	open = true;
+	co_return;
+}
+
+task<void> busy_background(priority_executor &executor, std::atomic<bool> &highRan)
+{
+	co_await executor.schedule(task_priority::background);
+	auto start = std::chrono::steady_clock::now();
+	while (!highRan.load())
+	{
+		if (std::chrono::steady_clock::now() - start > 10s)
+			throw std::runtime_error("yield_if_needed never gave way to the high priority coroutine");
+		co_await yield_if_needed();
+	}
+}
+
+task<void> mark_high(priority_executor &executor, std::atomic<bool> &highRan)
+{
+	co_await executor.schedule(task_priority::high);
+	highRan = true;
+}
+
+void test_priority_executor()
+{
+	priority_executor executor(1);
+	std::string order;
+	std::atomic<bool> open = false;
+	sync_wait(when_all(hold_worker(executor, open),
+					   record_run(executor, order, 'b', task_priority::background),
+					   record_run(executor, order, 'l', task_priority::low),
+					   record_run_before(executor, order, 'D', 50ms),
+					   record_run_before(executor, order, 'd', 10ms),
+					   record_run(executor, order, 'h', task_priority::high),
+					   open_gate(open)));
+	if (order != "hdlDb")
+		throw std::runtime_error("priority_executor ran coroutines out of deadline order: " + order);
+
+	std::atomic<bool> highRan = false;
+	sync_wait(when_all(busy_background(executor, highRan), mark_high(executor, highRan)));
 }
 
 int main(int argc, char **argv)
 {
-	auto task = coroutine_func();
-	task.run_sync();
+	test_histogram();
+	test_trace();
+	test_metrics();
+	test_thread_pool();
+	test_io_context();
+	test_timers();
+	test_frame_allocation();
+	test_generators();
+	test_synchronization();
+	test_channel();
+	test_sync_wait_all();
+	test_shared_task();
+	test_cancellation();
+	test_event_fan_out();
+	test_continuations();
+	test_parallel();
+	test_task_group();
+	test_coroutine_stats();
+	test_sharded_runtime();
+	test_file_reader();
+	test_priority_executor();
+	executor.run(coroutine_func());
+	if (executor.now().time_since_epoch() != 7s)
+		throw std::runtime_error("Virtual time did not advance through the sleeps");
 	return 0;
 }
\ No newline at end of file